@@ -0,0 +1,105 @@
+/**
+* @file ChunkThreadPool.cpp
+* Implements a small pool of worker threads that process the chunks of a data set
+* in parallel.
+*/
+
+#include "ChunkThreadPool.h"
+
+ChunkThreadPool::ChunkThreadPool() :
+  task(0), numberOfChunks(0), nextChunk(0), unfinishedChunks(0), generation(0), stopping(false)
+{
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&taskAvailable, 0);
+  pthread_cond_init(&taskFinished, 0);
+}
+
+ChunkThreadPool::~ChunkThreadPool()
+{
+  stop();
+  pthread_cond_destroy(&taskFinished);
+  pthread_cond_destroy(&taskAvailable);
+  pthread_mutex_destroy(&mutex);
+}
+
+void ChunkThreadPool::start(int numberOfThreads)
+{
+  stop();
+  for(int i = 1; i < numberOfThreads; ++i)
+  {
+    pthread_t thread;
+    if(pthread_create(&thread, 0, &workerMain, this) != 0)
+      break; // continue with the threads that could be created
+    workers.push_back(thread);
+  }
+}
+
+void ChunkThreadPool::stop()
+{
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  pthread_cond_broadcast(&taskAvailable);
+  pthread_mutex_unlock(&mutex);
+
+  for(std::vector<pthread_t>::iterator i = workers.begin(); i != workers.end(); ++i)
+    pthread_join(*i, 0);
+  workers.clear();
+  stopping = false;
+}
+
+void ChunkThreadPool::run(Task& task, int numberOfChunks)
+{
+  if(workers.empty())
+  {
+    for(int i = 0; i < numberOfChunks; ++i)
+      task.execute(i);
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  this->task = &task;
+  this->numberOfChunks = numberOfChunks;
+  nextChunk = 0;
+  unfinishedChunks = numberOfChunks;
+  ++generation;
+  pthread_cond_broadcast(&taskAvailable);
+
+  // the calling thread helps, then waits for the chunks still processed by the workers
+  processChunks();
+  while(unfinishedChunks > 0)
+    pthread_cond_wait(&taskFinished, &mutex);
+  this->task = 0;
+  pthread_mutex_unlock(&mutex);
+}
+
+void ChunkThreadPool::processChunks()
+{
+  while(task && nextChunk < numberOfChunks)
+  {
+    Task* currentTask = task;
+    const int chunk = nextChunk++;
+    pthread_mutex_unlock(&mutex);
+    currentTask->execute(chunk);
+    pthread_mutex_lock(&mutex);
+    if(--unfinishedChunks == 0)
+      pthread_cond_signal(&taskFinished);
+  }
+}
+
+void* ChunkThreadPool::workerMain(void* p)
+{
+  ChunkThreadPool& pool = *(ChunkThreadPool*) p;
+  pthread_mutex_lock(&pool.mutex);
+  unsigned seenGeneration = pool.generation;
+  for(;;)
+  {
+    while(!pool.stopping && pool.generation == seenGeneration)
+      pthread_cond_wait(&pool.taskAvailable, &pool.mutex);
+    if(pool.stopping)
+      break;
+    seenGeneration = pool.generation;
+    pool.processChunks();
+  }
+  pthread_mutex_unlock(&pool.mutex);
+  return 0;
+}
@@ -0,0 +1,87 @@
+/**
+* @file ChunkThreadPool.h
+* Declares a small pool of worker threads that process the chunks of a data set
+* in parallel.
+*/
+
+#pragma once
+
+#include <pthread.h>
+#include <vector>
+
+/**
+* @class ChunkThreadPool
+* A fixed number of threads that wait for a task. A task is split into chunks that
+* are processed in any order and on any of the threads, including the one that
+* calls run(). run() returns after all chunks are processed. Chunks of the same
+* task must only write to disjoint data.
+*/
+class ChunkThreadPool
+{
+public:
+  /**
+  * @class Task
+  * The interface of the work that is distributed among the threads.
+  */
+  class Task
+  {
+  public:
+    virtual ~Task() {}
+
+    /**
+    * Processes a single chunk. Is called concurrently for different chunks.
+    * @param chunk The index of the chunk.
+    */
+    virtual void execute(int chunk) = 0;
+  };
+
+  /** Constructor. No threads are started. */
+  ChunkThreadPool();
+
+  /** Destructor. Stops all threads. */
+  ~ChunkThreadPool();
+
+  /**
+  * (Re)starts the pool.
+  * @param numberOfThreads The number of threads processing chunks, including the one
+  *                        that calls run(). 1 or less processes all chunks in run().
+  */
+  void start(int numberOfThreads);
+
+  /** Stops all worker threads and waits until they have terminated. */
+  void stop();
+
+  /** The number of threads processing chunks, including the one that calls run(). */
+  int getNumberOfThreads() const {return (int) workers.size() + 1;}
+
+  /**
+  * Processes all chunks of a task and waits until they are finished.
+  * @param task The task.
+  * @param numberOfChunks The number of chunks of the task.
+  */
+  void run(Task& task, int numberOfChunks);
+
+private:
+  std::vector<pthread_t> workers; /**< The worker threads. */
+  pthread_mutex_t mutex; /**< Protects all of the following members. */
+  pthread_cond_t taskAvailable; /**< Signaled when a new task was started or the pool is stopped. */
+  pthread_cond_t taskFinished; /**< Signaled when the last chunk of a task was finished. */
+  Task* task; /**< The current task. 0 if there is none. */
+  int numberOfChunks; /**< The number of chunks of the current task. */
+  int nextChunk; /**< The next chunk of the current task that is not processed yet. */
+  int unfinishedChunks; /**< The number of chunks of the current task that are not finished yet. */
+  unsigned generation; /**< Incremented for each task, so a worker does not wait for a task it has already seen. */
+  bool stopping; /**< Should the workers terminate? */
+
+  /**
+  * Processes chunks of the current task until there are none left.
+  * The mutex must be locked when this method is called. It is locked when it returns.
+  */
+  void processChunks();
+
+  /** The main loop of a worker thread. */
+  static void* workerMain(void* pool);
+
+  ChunkThreadPool(const ChunkThreadPool&);
+  ChunkThreadPool& operator=(const ChunkThreadPool&);
+};
@@ -22,6 +22,8 @@
 #include "Tools/Streams/InStreams.h"
 #include "Tools/Streams/OutStreams.h"
 #include "Tools/Team.h"
+#include "Tools/Debugging/ScopeMeter.h"
+#include "Tools/Debugging/PerfCounters.h"
 #include "SensorModels/CenterCircleSensorModel.h"
 #include "SensorModels/GoalPostsSensorModel.h"
 #include "SensorModels/LineSensorModel.h"
@@ -30,10 +32,32 @@
 #include "SensorModels/NaturalLandmarkSensorModel.h" //My addition
 #include <algorithm>
 
+/** Weightings are clamped to this value before their logarithm is taken. */
+static const float minWeighting = 1e-30f;
+
+/** The parameters of the KLD-sampling. */
+static const float kldError = 0.05f; /**< The maximum error between the sample based and the true distribution. */
+static const float kldQuantile = 2.33f; /**< The upper 0.99 quantile of the standard normal distribution. */
+static const float kldBinSize = 250.0f; /**< The edge length of a histogram bin in mm. */
+static const int kldAngularBins = 18; /**< The number of histogram bins of the rotation (20 degrees each). */
+static const int kldMinSamples = 50; /**< The number of samples is never reduced below this. */
+
+/**
+* Updates an exponential moving average of values, both given as logarithms, i.e.
+* log((1 - alpha) * exp(logAverage) + alpha * exp(logValue)), without leaving the log domain.
+*/
+static float updateLogAverage(float logAverage, float logValue, float alpha)
+{
+	const float maximum = max(logAverage, logValue);
+	return maximum + log((1.0f - alpha) * exp(logAverage - maximum) + alpha * exp(logValue - maximum));
+}
 
 SelfLocator::SelfLocator() :
 parameter(new SelfLocatorParameter),
-samples(0), slowWeighting(0.0f), fastWeighting(0.0f), updatedBySensors(false),
+samples(0), totalWeighting(0.0f), totalSquaredWeighting(0.0f), effectiveSampleSize(0.0f),
+logDomainWeighting(false), logWeightingOffset(0.0f),
+logSlowWeighting(-std::numeric_limits<float>::infinity()), logFastWeighting(-std::numeric_limits<float>::infinity()),
+updatedBySensors(false),
 poseCalculator(0), perceptValidityChecker(0), lastPoseComputationTimeStamp(0),
 sampleTemplateGenerator(theGoalPercept, theLinePercept, theFrameInfo, theFieldDimensions, theOdometryData,
 		parameter->standardDeviationGoalpostSampleBearingDistance,
@@ -42,8 +66,11 @@ sampleTemplateGenerator(theGoalPercept, theLinePercept, theFrameInfo, theFieldDi
 		parameter->clipTemplateGenerationRangeX,
 		parameter->clipTemplateGenerationRangeY,
 		parameter->templateMaxKeepTime),
+		naturalLandmarkSensorModel(0), kldSampling(false), kldStamp(0),
 		gameInfoPenaltyLastFrame(PENALTY_NONE),
-		gameInfoGameStateLastFrame(STATE_INITIAL)
+		gameInfoGameStateLastFrame(STATE_INITIAL),
+		clusterMomentsTimeStamp(0),
+		sensorModelThreads(1), sensorModelEvaluation(*this), numberOfChunks(0), chunkSize(0)
 {
 	observations.reserve(100);
 	selectedObservations.reserve(100);
@@ -57,6 +84,10 @@ void SelfLocator::setNumberOfSamples(const int num)
 		delete samples;
 	samples = new SampleSet<Sample>(num);
 	sensorModelWeightings.resize(num);
+	logWeightings.resize(num);
+	cumulativeWeightings.resize(num);
+	resampledIndices.resize(num);
+	clusterIndexMap.resize(2 * num);
 
 	if (poseCalculator)
 		delete poseCalculator;
@@ -78,9 +109,11 @@ SelfLocator::~SelfLocator()
 void SelfLocator::init()
 {
 	fieldModel.init(theFieldDimensions, parameter->maxCrossingLength);
+	likelihoodField.init(theFieldDimensions);
 	for (unsigned int i = 0; i < sensorModels.size(); ++i)
 		delete sensorModels[i];
 	sensorModels.clear();
+	reentrantSensorModels.clear();
 	if (perceptValidityChecker)
 		delete perceptValidityChecker;
 
@@ -95,24 +128,31 @@ void SelfLocator::init()
 			theGoalPercept, theFrameInfo, theFieldDimensions, theCameraMatrix, *perceptValidityChecker));
 	sensorModels.push_back(new CenterCircleSensorModel(*parameter,
 			theLinePercept, theFrameInfo, theFieldDimensions, theCameraMatrix, *perceptValidityChecker));
+	// the models of the B-Human code keep state between calls and draw, so only the ones
+	// that just read the likelihood field or their own tables are evaluated by several threads
+	reentrantSensorModels.resize(sensorModels.size(), false);
 	sensorModels.push_back(new LineSensorModel(*parameter,
 			lines, theFrameInfo, theFieldDimensions, theCameraMatrix, *perceptValidityChecker,
-			fieldModel));
+			likelihoodField));
+	reentrantSensorModels.push_back(true);
 	sensorModels.push_back(new CornersSensorModel(*parameter,
 			theLinePercept, theFrameInfo, theFieldDimensions, theCameraMatrix, *perceptValidityChecker,
-			fieldModel));
+			likelihoodField));
+	reentrantSensorModels.push_back(true);
 	//MC: Add the natural landmark sensor model: NOTE check that SelfLocator.h has the
 	//Brisk percept added to its requires!!
 //	sensorModels.push_back(new NaturalLandmarkSensorModel(*parameter,
 //			theNaturalLandmarkPercept,theFrameInfo,
 //			theFieldDimensions, theCameraMatrix, *perceptValidityChecker ));
-		sensorModels.push_back(new NaturalLandmarkSensorModel(*parameter,
+		naturalLandmarkSensorModel = new NaturalLandmarkSensorModel(*parameter,
 				theNaturalLandmarkPerceptBrisk,theFrameInfo,
-				theFieldDimensions, theCameraMatrix, *perceptValidityChecker ));
-
+				theFieldDimensions, theCameraMatrix, *perceptValidityChecker );
+		sensorModels.push_back(naturalLandmarkSensorModel);
+		reentrantSensorModels.push_back(true);
 
 
 	setNumberOfSamples(parameter->numberOfSamples);
+	motionModel.seed(0); // a fixed seed, so runs with the same input produce the same samples
 	sampleTemplateGenerator.init();
 	vector<Pose2D> poses;
 	vector<Pose2D> standardDeviations;
@@ -138,7 +178,7 @@ void SelfLocator::initSamplesAtGivenPositions(const vector<Pose2D>& poses,
 {
 	for (int i = 0; i < samples->size(); ++i)
 	{
-		Sample& sample(samples->at(i));
+		SampleReference sample(samples->at(i));
 		if (poses.size())
 		{
 			// Select one of the poses from the list:
@@ -168,10 +208,18 @@ void SelfLocator::initSamplesAtGivenPositions(const vector<Pose2D>& poses,
 
 void SelfLocator::update(PotentialRobotPose& robotPose)
 {
+	ScopeMeter::Scope meterScope("SelfLocator");
+	PerfCounters::Scope perfScope("SelfLocator");
 	MODIFY("module:SelfLocator:parameter", *parameter);
+	MODIFY("module:SelfLocator:logDomainWeighting", logDomainWeighting);
+	MODIFY("module:SelfLocator:kldSampling", kldSampling);
+	MODIFY("module:SelfLocator:sensorModelThreads", sensorModelThreads);
+	sensorModelThreads = max(1, sensorModelThreads);
+	if (sensorModelThreads != threadPool.getNumberOfThreads())
+		threadPool.start(sensorModelThreads);
 
 	// recreate sampleset if number of samples was changed
-	if (parameter->numberOfSamples != samples->size())
+	if (parameter->numberOfSamples != samples->capacity())
 		init();
 
 	// Maybe pose has already been computed by call to other update function (for clusters)
@@ -201,10 +249,18 @@ void SelfLocator::update(PotentialRobotPose& robotPose)
 	}
 	else //normal case
 	{
-		motionUpdate(updatedBySensors);
-		updatedBySensors = applySensorModels(false);
+		{
+			PerfCounters::Scope perfScope("SelfLocator:motionUpdate");
+			motionUpdate(updatedBySensors);
+		}
+		{
+			// only counts the calling thread, not the sensor model threads
+			PerfCounters::Scope perfScope("SelfLocator:applySensorModels");
+			updatedBySensors = applySensorModels(false);
+		}
 		if (updatedBySensors)
 		{
+			PerfCounters::Scope perfScope("SelfLocator:resampling");
 			adaptWeightings();
 			resampling();
 		}
@@ -231,6 +287,7 @@ void SelfLocator::update(PotentialRobotPose& robotPose)
 	DECLARE_DEBUG_DRAWING("module:SelfLocator:selectedPoints", "drawingOnField");
 
 	fieldModel.draw();
+	likelihoodField.draw();
 }
 
 void SelfLocator::update(RobotPose& robotPose)
@@ -248,6 +305,8 @@ bool cmpClusterPairs(pair<int, int> a, pair<int, int> b)
 
 void SelfLocator::update(RobotPoseHypotheses& robotPoseHypotheses)
 {
+	ScopeMeter::Scope meterScope("SelfLocator");
+	PerfCounters::Scope perfScope("SelfLocator");
 	robotPoseHypotheses.hypotheses.clear();
 	//update only available for two types of pose calculation:
 	if (poseCalculatorType != POSE_CALCULATOR_PARTICLE_HISTORY && poseCalculatorType != POSE_CALCULATOR_K_MEANS_CLUSTERING)
@@ -267,6 +326,7 @@ void SelfLocator::update(RobotPoseHypotheses& robotPoseHypotheses)
 		vector< pair<int, int> > clusters = poseHistoryCalc->getClusters();
 		sort(clusters.begin(), clusters.end(), cmpClusterPairs);
 		const unsigned int MAX_HYPOTHESES = min<unsigned int>(robotPoseHypotheses.MAX_HYPOTHESES, clusters.size());
+		updateClusterMoments();
 		for (unsigned int i = 0; i < MAX_HYPOTHESES; ++i)
 		{
 			// No mini clusters, please:
@@ -275,33 +335,8 @@ void SelfLocator::update(RobotPoseHypotheses& robotPoseHypotheses)
 			// Compute average position:
 			RobotPoseHypothesis newHypothesis;
 			poseHistoryCalc->calcPoseOfCluster(newHypothesis, clusters[i].first);
-			Vector2<int> newTrans(static_cast<int>(newHypothesis.translation.x), static_cast<int>(newHypothesis.translation.y));
-			// Compute variance of position:
-			int varianceX(0);
-			int varianceY(0);
-			for (int j = 0; j < samples->size(); ++j)
-			{
-				Sample& s(samples->at(j));
-				if (s.cluster == clusters[i].first)
-				{
-					varianceX += (s.translation.x - newTrans.x) * (s.translation.x - newTrans.x);
-					varianceY += (s.translation.y - newTrans.y) * (s.translation.y - newTrans.y);
-				}
-			}
-			varianceX /= (clusters[i].second - 1);
-			varianceY /= (clusters[i].second - 1);
-			newHypothesis.positionCovariance[0][0] = static_cast<float>(varianceX);
-			newHypothesis.positionCovariance[1][1] = static_cast<float>(varianceY);
-			// Compute covariance:
-			int cov_xy(0);
-			for (int j = 0; j < samples->size(); ++j)
-			{
-				Sample& s(samples->at(j));
-				if (s.cluster == clusters[i].first)
-					cov_xy += (s.translation.x - newTrans.x) * (s.translation.y - newTrans.y);
-			}
-			cov_xy /= (clusters[i].second - 1);
-			newHypothesis.positionCovariance[0][1] = newHypothesis.positionCovariance[1][0] = static_cast<float>(cov_xy);
+			// Compute covariance of position:
+			setPositionCovariance(clusters[i].first, newHypothesis.translation, newHypothesis);
 			// Finally add to list:
 			robotPoseHypotheses.hypotheses.push_back(newHypothesis);
 		}
@@ -312,6 +347,7 @@ void SelfLocator::update(RobotPoseHypotheses& robotPoseHypotheses)
 		//get hypotheses:
 		PoseCalculatorKMeansClustering< Sample, SampleSet<Sample>, 5, 1000 >* poseKMeansCalc
 		= (PoseCalculatorKMeansClustering< Sample, SampleSet<Sample>, 5, 1000 >*)poseCalculator;
+		updateClusterMoments();
 		for (unsigned int i = 0; i < 5; ++i)
 		{
 			RobotPoseHypothesis newHypothesis;
@@ -319,23 +355,76 @@ void SelfLocator::update(RobotPoseHypotheses& robotPoseHypotheses)
 			if (newHypothesis.validity > 0)
 			{
 				poseKMeansCalc->getClusterPose(newHypothesis, i);
-				newHypothesis.positionCovariance[0][0] = 0.1f;   //TODO: calculate covariances
-				newHypothesis.positionCovariance[0][1] = 0.1f;
-				newHypothesis.positionCovariance[1][0] = 0.1f;
-				newHypothesis.positionCovariance[1][1] = 0.1f;
+				if (!setPositionCovariance(i, newHypothesis.translation, newHypothesis))
+				{
+					newHypothesis.positionCovariance[0][0] = 0.1f;
+					newHypothesis.positionCovariance[0][1] = 0.1f;
+					newHypothesis.positionCovariance[1][0] = 0.1f;
+					newHypothesis.positionCovariance[1][1] = 0.1f;
+				}
 				robotPoseHypotheses.hypotheses.push_back(newHypothesis);
 			}
 		}
 	}
 }
 
+void SelfLocator::updateClusterMoments()
+{
+	if (clusterMomentsTimeStamp == theFrameInfo.time && !clusterMoments.empty())
+		return;
+	clusterMomentsTimeStamp = theFrameInfo.time;
+
+	clusterMoments.clear();
+	for (int i = 0; i < samples->size(); ++i)
+	{
+		const int cluster = samples->cluster[i];
+		if (cluster < 0)
+			continue;
+		if (cluster >= (int) clusterMoments.size())
+			clusterMoments.resize(cluster + 1);
+		ClusterMoments& moments = clusterMoments[cluster];
+		const double x = samples->x[i];
+		const double y = samples->y[i];
+		++moments.count;
+		moments.sumX += x;
+		moments.sumY += y;
+		moments.sumXX += x * x;
+		moments.sumYY += y * y;
+		moments.sumXY += x * y;
+	}
+}
+
+bool SelfLocator::setPositionCovariance(int cluster, const Vector2<>& center, RobotPoseHypothesis& hypothesis) const
+{
+	if (cluster < 0 || cluster >= (int) clusterMoments.size() || clusterMoments[cluster].count < 2)
+		return false;
+
+	// sum((x - cx) * (y - cy)) = sum(x * y) - cy * sum(x) - cx * sum(y) + n * cx * cy
+	const ClusterMoments& moments = clusterMoments[cluster];
+	const double n = moments.count;
+	const double cx = center.x;
+	const double cy = center.y;
+	const double varianceX = (moments.sumXX - 2.0 * cx * moments.sumX + n * cx * cx) / (n - 1.0);
+	const double varianceY = (moments.sumYY - 2.0 * cy * moments.sumY + n * cy * cy) / (n - 1.0);
+	const double covarianceXY = (moments.sumXY - cy * moments.sumX - cx * moments.sumY + n * cx * cy) / (n - 1.0);
+	hypothesis.positionCovariance[0][0] = static_cast<float>(varianceX);
+	hypothesis.positionCovariance[1][1] = static_cast<float>(varianceY);
+	hypothesis.positionCovariance[0][1] = hypothesis.positionCovariance[1][0] = static_cast<float>(covarianceXY);
+	return true;
+}
+
 void SelfLocator::preExecution(RobotPose& robotPose)
 {
 	sampleTemplateGenerator.bufferNewPerceptions();
 
 	// Reset all weightings to 1.0f
+	float* weighting = samples->weighting;
 	for (int i = 0; i < samples->size(); ++i)
-		samples->at(i).weighting = 1.0f;
+		weighting[i] = 1.0f;
+	totalWeighting = totalSquaredWeighting = (float) samples->size();
+	logWeightingOffset = 0;
+	if (logDomainWeighting)
+		std::fill(logWeightings.begin(), logWeightings.end(), 0.0f);
 
 	DEBUG_RESPONSE("module:SelfLocator:createFieldModel", fieldModel.create(););
 
@@ -431,7 +520,7 @@ void SelfLocator::preExecution(RobotPose& robotPose)
 			{
 				for (int i = 0; i < samples->size(); ++i)
 				{
-					Sample& sample(samples->at(i));
+					SampleReference sample(samples->at(i));
 					if (theGameInfo.state == STATE_SET && theRobotInfo.number == 1 &&
 							(fabs(sample.translation.x-static_cast<float>(theFieldDimensions.xPosOwnGoalpost)) > 250 || fabs(sample.translation.y) > 100))
 					{
@@ -485,27 +574,11 @@ void SelfLocator::motionUpdate(bool noise)
 	const int transYError = (int) max(transNoise,
 			(float) max(abs(transY * parameter->majorDirTransWeight),
 					abs(transX * parameter->minorDirTransWeight)));
-	for (int i = 0; i < samples->size(); i++)
-	{
-		Sample& s(samples->at(i));
-
-		// the translational error vector
-		const Vector2<int> transOffset((((transX - transXError) << 10) + (transXError << 1) * ((rand() & 0x3ff) + 1) + 512) >> 10,
-				(((transY - transYError) << 10) + (transYError << 1) * ((rand() & 0x3ff) + 1) + 512) >> 10);
-
-		// update the sample
-		s.translation = Vector2<int>(((s.translation.x << 10) + transOffset.x * s.rotation.x - transOffset.y * s.rotation.y + 512) >> 10,
-				((s.translation.y << 10) + transOffset.x * s.rotation.y + transOffset.y * s.rotation.x + 512) >> 10);
-		s.angle += odometryOffset.rotation + (randomFloat() * 2 - 1) * rotError;
-		s.angle = normalize(s.angle);
-		s.rotation = Vector2<int>(int(cos((float)s.angle) * 1024), int(sin((float)s.angle) * 1024));
-
-		// clip to field boundary
-		Vector2<> translationAsDouble((float) s.translation.x, (float) s.translation.y);
-		theFieldDimensions.clipToCarpet(translationAsDouble);
-		s.translation.x = static_cast<int>(translationAsDouble.x);
-		s.translation.y = static_cast<int>(translationAsDouble.y);
-	}
+	// move all samples, clipped to the carpet
+	motionModel.update(*samples, Pose2D(odometryOffset.rotation, (float) transX, (float) transY),
+			Vector2<>((float) transXError, (float) transYError), rotError,
+			Vector2<>((float) theFieldDimensions.xPosOwnFieldBorder, (float) theFieldDimensions.yPosRightFieldBorder),
+			Vector2<>((float) theFieldDimensions.xPosOpponentFieldBorder, (float) theFieldDimensions.yPosLeftFieldBorder));
 }
 
 bool SelfLocator::applySensorModels(bool includeLandmarks)
@@ -564,40 +637,79 @@ bool SelfLocator::applySensorModels(bool includeLandmarks)
 		else
 			selectedObservations.push_back(observations[rand() % observations.size()]);
 
+	// the direction table of the natural landmark model is only read while the models are evaluated
+	naturalLandmarkSensorModel->setLandmarkPosition(theNaturalLandmarkPerceptBrisk.landmarkPosition);
+
+	// with more than one thread, the reentrant sensor models are evaluated on chunks of the samples first
+	const bool parallel = threadPool.getNumberOfThreads() > 1;
+	if (parallel)
+	{
+		modelSelectedIndices.resize(sensorModels.size());
+		for (unsigned int m = 0; m < sensorModels.size(); ++m)
+		{
+			modelSelectedIndices[m].clear();
+			if (reentrantSensorModels[m])
+				for (vector<SensorModel::Observation>::const_iterator i = selectedObservations.begin(); i != selectedObservations.end(); ++i)
+					if (i->type == sensorModels[m]->type)
+						modelSelectedIndices[m].push_back(i->index);
+		}
+		computeWeightingsInParallel();
+	}
+
 	// apply sensor models
 	bool sensorModelApplied(false);
 	vector<SensorModel*>::iterator sensorModel = sensorModels.begin();
 	for (; sensorModel != sensorModels.end(); ++sensorModel)
 	{
 		SensorModel::SensorModelResult result;
-		selectedIndices.clear();
+		if (parallel && reentrantSensorModels[sensorModel - sensorModels.begin()])
+			result = gatherChunkWeightings(int(sensorModel - sensorModels.begin()));
+		else
+		{
+			selectedIndices.clear();
 
-		for (vector<SensorModel::Observation>::const_iterator i = selectedObservations.begin(); i != selectedObservations.end(); ++i)
-			if (i->type == (*sensorModel)->type)
-				selectedIndices.push_back(i->index);
+			for (vector<SensorModel::Observation>::const_iterator i = selectedObservations.begin(); i != selectedObservations.end(); ++i)
+				if (i->type == (*sensorModel)->type)
+					selectedIndices.push_back(i->index);
 
-		if (selectedIndices.empty() && (*sensorModel)->type != SensorModel::Observation::SHARED_BALL )
-			result = SensorModel::NO_SENSOR_UPDATE;
-		else
-			result = (*sensorModel)->computeWeightings(*samples, selectedIndices, sensorModelWeightings);
-		if (result == SensorModel::FULL_SENSOR_UPDATE)
+			if (selectedIndices.empty() && (*sensorModel)->type != SensorModel::Observation::SHARED_BALL )
+				result = SensorModel::NO_SENSOR_UPDATE;
+			else
+				result = (*sensorModel)->computeWeightings(*samples, selectedIndices, sensorModelWeightings);
+		}
+		// the sums of the weightings are accumulated while they are written, the ones of the last model remain
+		float* weighting = samples->weighting;
+		const float* modelWeighting = &sensorModelWeightings[0];
+		float sum(0.0f);
+		float squaredSum(0.0f);
+		if (logDomainWeighting && result == SensorModel::FULL_SENSOR_UPDATE)
+		{
+			for (int i = 0; i < samples->size(); ++i)
+				logWeightings[i] += log(max(modelWeighting[i], minWeighting));
+			sensorModelApplied = true;
+		}
+		else if (result == SensorModel::FULL_SENSOR_UPDATE)
 		{
 			for (int i = 0; i < samples->size(); ++i)
 			{
-				samples->at(i).weighting *= sensorModelWeightings[static_cast<unsigned int>(i)];
-				sensorModelApplied = true;
+				weighting[i] *= modelWeighting[i];
+				sum += weighting[i];
+				squaredSum += weighting[i] * weighting[i];
 			}
+			totalWeighting = sum;
+			totalSquaredWeighting = squaredSum;
+			sensorModelApplied = true;
 		}
 		else if (result == SensorModel::PARTIAL_SENSOR_UPDATE)
 		{
 			// Compute average of all valid weightings, use this average for all invalid ones
-			float sum(0.0f);
+			float validSum(0.0f);
 			int numOfValidSamples(0);
-			for (unsigned int i = 0; i < sensorModelWeightings.size(); ++i)
+			for (int i = 0; i < samples->size(); ++i)
 			{
 				if (sensorModelWeightings[i] != -1)
 				{
-					sum += sensorModelWeightings[i];
+					validSum += sensorModelWeightings[i];
 					++numOfValidSamples;
 				}
 			}
@@ -605,44 +717,132 @@ bool SelfLocator::applySensorModels(bool includeLandmarks)
 					{
 				continue;
 					}
-			const float averageWeighting(sum / numOfValidSamples);
-			for (unsigned int i = 0; i < sensorModelWeightings.size(); ++i)
+			const float averageWeighting(validSum / numOfValidSamples);
+			if (logDomainWeighting)
 			{
-				if (sensorModelWeightings[i] != -1)
-					samples->at(i).weighting *= sensorModelWeightings[i];
-				else
-					samples->at(i).weighting *= averageWeighting;
+				const float logAverageWeighting = log(max(averageWeighting, minWeighting));
+				for (int i = 0; i < samples->size(); ++i)
+					logWeightings[i] += modelWeighting[i] != -1 ? log(max(modelWeighting[i], minWeighting)) : logAverageWeighting;
+				sensorModelApplied = true;
+				continue;
+			}
+			for (int i = 0; i < samples->size(); ++i)
+			{
+				weighting[i] *= modelWeighting[i] != -1 ? modelWeighting[i] : averageWeighting;
+				sum += weighting[i];
+				squaredSum += weighting[i] * weighting[i];
 			}
+			totalWeighting = sum;
+			totalSquaredWeighting = squaredSum;
 			sensorModelApplied = true;
 		}
 	}
+	if (logDomainWeighting && sensorModelApplied)
+		exponentiateLogWeightings();
 	return sensorModelApplied;
 }
 
+void SelfLocator::computeWeightingsInParallel()
+{
+	// the chunks start at multiples of 8, so the arrays of the views stay aligned
+	const int numberOfThreads = threadPool.getNumberOfThreads();
+	chunkSize = max(8, ((samples->size() + numberOfThreads - 1) / numberOfThreads + 7) & ~7);
+	numberOfChunks = (samples->size() + chunkSize - 1) / chunkSize;
+
+	chunkWeightings.resize(sensorModels.size() * numberOfChunks);
+	chunkResults.resize(sensorModels.size() * numberOfChunks);
+	for (unsigned int i = 0; i < chunkWeightings.size(); ++i)
+		chunkWeightings[i].resize(chunkSize);
+
+	threadPool.run(sensorModelEvaluation, numberOfChunks);
+}
+
+void SelfLocator::computeChunkWeightings(int chunk)
+{
+	const int begin = chunk * chunkSize;
+	SampleSet<Sample> chunkSamples(*samples, begin, min(chunkSize, samples->size() - begin));
+	for (unsigned int m = 0; m < sensorModels.size(); ++m)
+	{
+		const int index = m * numberOfChunks + chunk;
+		if (!reentrantSensorModels[m])
+			continue;
+		else if (modelSelectedIndices[m].empty() && sensorModels[m]->type != SensorModel::Observation::SHARED_BALL)
+			chunkResults[index] = SensorModel::NO_SENSOR_UPDATE;
+		else
+			chunkResults[index] = sensorModels[m]->computeWeightings(chunkSamples, modelSelectedIndices[m], chunkWeightings[index]);
+	}
+}
+
+SensorModel::SensorModelResult SelfLocator::gatherChunkWeightings(int model)
+{
+	// the serial evaluation returns a single result for all samples, so chunks that
+	// disagree, e.g. some without an update, are evaluated again on the whole set
+	const SensorModel::SensorModelResult result = chunkResults[model * numberOfChunks];
+	for (int chunk = 1; chunk < numberOfChunks; ++chunk)
+		if (chunkResults[model * numberOfChunks + chunk] != result)
+			return sensorModels[model]->computeWeightings(*samples, modelSelectedIndices[model], sensorModelWeightings);
+
+	if (result != SensorModel::NO_SENSOR_UPDATE)
+		for (int chunk = 0; chunk < numberOfChunks; ++chunk)
+		{
+			const int index = model * numberOfChunks + chunk;
+			const int begin = chunk * chunkSize;
+			const int end = min(begin + chunkSize, samples->size());
+			copy(chunkWeightings[index].begin(), chunkWeightings[index].begin() + (end - begin), sensorModelWeightings.begin() + begin);
+		}
+	return result;
+}
+
+void SelfLocator::exponentiateLogWeightings()
+{
+	const int numberOfSamples(samples->size());
+	float maxLogWeighting = logWeightings[0];
+	for (int i = 1; i < numberOfSamples; ++i)
+		maxLogWeighting = max(maxLogWeighting, logWeightings[i]);
+
+	// the best sample gets the weighting 1, so the sums cannot underflow
+	float* weighting = samples->weighting;
+	float sum(0.0f);
+	float squaredSum(0.0f);
+	for (int i = 0; i < numberOfSamples; ++i)
+	{
+		weighting[i] = exp(logWeightings[i] - maxLogWeighting);
+		sum += weighting[i];
+		squaredSum += weighting[i] * weighting[i];
+	}
+	totalWeighting = sum;
+	totalSquaredWeighting = squaredSum;
+	logWeightingOffset = maxLogWeighting;
+}
+
 void SelfLocator::resampling()
 {
 	// swap sample arrays
-	Sample* oldSet = samples->swap();
-	const int numberOfSamples(samples->size());
+	SelfLocatorSampleArrays& oldSet = samples->swap();
+	const int numberOfOldSamples(samples->size());
 	const float weightingsSum(totalWeighting);
-	const float resamplingPercentage(sampleTemplateGenerator.templatesAvailable() ? max(0.0f, 1.0f - fastWeighting / slowWeighting) : 0.0f);
-	const float numberOfResampledSamples = parameter->disableSensorResetting ? numberOfSamples : numberOfSamples * (1.0f - resamplingPercentage);
-	const float threshold = parameter->resamplingThreshold * weightingsSum / numberOfSamples;
-	const float weightingBetweenTwoDrawnSamples((weightingsSum + threshold * numberOfSamples) / numberOfResampledSamples);
-	float nextPos(randomFloat() * weightingBetweenTwoDrawnSamples);
+	const float resamplingPercentage(sampleTemplateGenerator.templatesAvailable() ? max(0.0f, 1.0f - exp(logFastWeighting - logSlowWeighting)) : 0.0f);
+	const float threshold = parameter->resamplingThreshold * weightingsSum / numberOfOldSamples;
+	const float randomOffset(randomFloat());
+
+	// prefix sums of the weightings
 	float currentSum(0);
+	for (int i = 0; i < numberOfOldSamples; ++i)
+	{
+		currentSum += oldSet.weighting[i] + threshold;
+		cumulativeWeightings[i] = currentSum;
+	}
 
-	// resample:
-	int j(0);
-	for (int i = 0; i < numberOfSamples; ++i)
+	// KLD-sampling: the number of samples follows the number of histogram bins the drawn samples occupy.
+	// The buffers have the maximum size, so changing the number of samples does not allocate memory.
+	int j = drawSystematically(numberOfOldSamples, numberOfOldSamples, resamplingPercentage, randomOffset);
+	const int numberOfSamples = kldSampling ? kldSampleCount(countOccupiedBins(oldSet, j)) : samples->capacity();
+	if (numberOfSamples != numberOfOldSamples)
 	{
-		currentSum += oldSet[i].weighting + threshold;
-		while (currentSum > nextPos && j < numberOfSamples)
-		{
-			samples->at(j++) = oldSet[i];
-			nextPos += weightingBetweenTwoDrawnSamples;
-		}
+		samples->resize(numberOfSamples);
+		j = drawSystematically(numberOfOldSamples, numberOfSamples, resamplingPercentage, randomOffset);
 	}
+	samples->gather(oldSet, &resampledIndices[0], j);
 
 	// fill up remaining samples with new poses:
 	if (sampleTemplateGenerator.templatesAvailable())
@@ -650,13 +850,13 @@ void SelfLocator::resampling()
 			generateTemplate(samples->at(j));
 	else if (j) // in rare cases, a sample is missing, so add one (or more...)
 		for (; j < numberOfSamples; ++j)
-			samples->at(j) = samples->at(rand() % j);
+			samples->copy(j, *samples, rand() % j);
 	else // resampling was not possible (for unknown reasons), so create a new sample set (fail safe)
 #ifdef NDEBUG
 	{
 		for (int i = 0; i < numberOfSamples; ++i)
 		{
-			Sample& sample = samples->at(i);
+			SampleReference sample(samples->at(i));
 			Pose2D pose(theFieldDimensions.randomPoseOnField());
 			sample.translation = Vector2<int>(int(pose.translation.x), int(pose.translation.y));
 			sample.rotation = Vector2<int>(int(cos(pose.rotation) * 1024), int(sin(pose.rotation) * 1024));
@@ -666,37 +866,137 @@ void SelfLocator::resampling()
 #else
 	ASSERT(false);
 #endif
+
+	// the new samples got cluster indices for the old number of samples
+	if (numberOfSamples < numberOfOldSamples && poseCalculatorType == POSE_CALCULATOR_PARTICLE_HISTORY)
+		remapClusterIndices();
+}
+
+int SelfLocator::drawSystematically(int numberOfOldSamples, int numberOfSamples, float resamplingPercentage, float randomOffset)
+{
+	const float numberOfResampledSamples = parameter->disableSensorResetting ? numberOfSamples : numberOfSamples * (1.0f - resamplingPercentage);
+	const float weightingBetweenTwoDrawnSamples(cumulativeWeightings[numberOfOldSamples - 1] / numberOfResampledSamples);
+	float nextPos(randomOffset * weightingBetweenTwoDrawnSamples);
+
+	// the drawn positions are increasing, so they are merged with the prefix sums.
+	// Sample j is a copy of the first sample whose prefix sum exceeds its position.
+	int j(0);
+	for (int i = 0; j < numberOfSamples; ++j)
+	{
+		while (i < numberOfOldSamples && cumulativeWeightings[i] <= nextPos)
+			++i;
+		if (i == numberOfOldSamples)
+			break;
+		resampledIndices[j] = i;
+		nextPos += weightingBetweenTwoDrawnSamples;
+	}
+	return j;
+}
+
+int SelfLocator::countOccupiedBins(const SelfLocatorSampleArrays& set, int count)
+{
+	const float minX = (float) theFieldDimensions.xPosOwnFieldBorder;
+	const float minY = (float) theFieldDimensions.yPosRightFieldBorder;
+	const int binsX = int((theFieldDimensions.xPosOpponentFieldBorder - minX) / kldBinSize) + 1;
+	const int binsY = int((theFieldDimensions.yPosLeftFieldBorder - minY) / kldBinSize) + 1;
+	if ((int) kldBins.size() != binsX * binsY * kldAngularBins)
+		kldBins.assign(binsX * binsY * kldAngularBins, 0);
+
+	// a bin is occupied if it carries the stamp of this call, so the bins never have to be cleared
+	if (++kldStamp == 0)
+	{
+		std::fill(kldBins.begin(), kldBins.end(), 0);
+		kldStamp = 1;
+	}
+	int occupiedBins(0);
+	for (int j = 0; j < count; ++j)
+	{
+		const int i = resampledIndices[j];
+		const int binX = max(0, min(binsX - 1, int((set.x[i] - minX) / kldBinSize)));
+		const int binY = max(0, min(binsY - 1, int((set.y[i] - minY) / kldBinSize)));
+		const int binAngle = max(0, min(kldAngularBins - 1, int((set.angle[i] + pi) * (kldAngularBins / pi2))));
+		unsigned& bin = kldBins[(binAngle * binsY + binY) * binsX + binX];
+		if (bin != kldStamp)
+		{
+			bin = kldStamp;
+			++occupiedBins;
+		}
+	}
+	return occupiedBins;
+}
+
+int SelfLocator::kldSampleCount(int occupiedBins) const
+{
+	int numberOfSamples = kldMinSamples;
+	if (occupiedBins > 1)
+	{
+		// Fox, "Adapting the sample size in particle filters through KLD-sampling"
+		const float k = (float) (occupiedBins - 1);
+		const float a = 2.0f / (9.0f * k);
+		const float b = 1.0f - a + sqrt(a) * kldQuantile;
+		numberOfSamples = max(numberOfSamples, int(ceil(k / (2.0f * kldError) * b * b * b)));
+	}
+	return min(numberOfSamples, samples->capacity());
+}
+
+void SelfLocator::remapClusterIndices()
+{
+	// below numberOfIndices, an entry marks an index as used; above, it maps an invalid index to a valid one
+	const int numberOfIndices = 2 * samples->size();
+	std::fill(clusterIndexMap.begin(), clusterIndexMap.end(), -1);
+	int* cluster = samples->cluster;
+	for (int i = 0; i < samples->size(); ++i)
+		if (cluster[i] >= 0 && cluster[i] < numberOfIndices)
+			clusterIndexMap[cluster[i]] = cluster[i];
+
+	// there are at most as many clusters as samples, so there are always unused indices
+	int nextIndex = 0;
+	int otherIndex = -1; // the index of the samples with indices that were never valid
+	for (int i = 0; i < samples->size(); ++i)
+	{
+		if (cluster[i] >= 0 && cluster[i] < numberOfIndices)
+			continue;
+		int& index = cluster[i] >= numberOfIndices && cluster[i] < (int) clusterIndexMap.size() ? clusterIndexMap[cluster[i]] : otherIndex;
+		if (index < 0)
+		{
+			while (clusterIndexMap[nextIndex] >= 0)
+				++nextIndex;
+			index = clusterIndexMap[nextIndex] = nextIndex;
+		}
+		cluster[i] = index;
+	}
 }
 
 void SelfLocator::adaptWeightings()
 {
-	totalWeighting = 0;
+	// totalWeighting and totalSquaredWeighting were accumulated by applySensorModels()
 	int numberOfSamples(samples->size());
-	for (int i = 0; i < numberOfSamples; ++i)
-		totalWeighting += samples->at(i).weighting;
 	if (totalWeighting == 0)
 	{
 		OUTPUT(idText, text, "Meeeeeeek. Total weighting of all samples in SelfLocator is 0.");
 		return;
 	}
-	const float averageWeighting = totalWeighting / numberOfSamples;
-	if (slowWeighting)
+	// the slow and fast averages follow the unscaled weightings, i.e. the logWeightingOffset is added
+	const float logAverageWeighting = log(totalWeighting / numberOfSamples) + logWeightingOffset;
+	effectiveSampleSize = totalWeighting * totalWeighting / totalSquaredWeighting;
+	if (logSlowWeighting != -std::numeric_limits<float>::infinity())
 	{
-		slowWeighting = slowWeighting + parameter->alphaSlow * (averageWeighting - slowWeighting);
-		fastWeighting = fastWeighting + parameter->alphaFast * (averageWeighting - fastWeighting);
+		logSlowWeighting = updateLogAverage(logSlowWeighting, logAverageWeighting, parameter->alphaSlow);
+		logFastWeighting = updateLogAverage(logFastWeighting, logAverageWeighting, parameter->alphaFast);
 	}
 	else
 	{
-		slowWeighting = averageWeighting;
+		logSlowWeighting = logAverageWeighting;
 		if (parameter->knownStartPose)
-			fastWeighting = averageWeighting;   // Must be done to avoid complete re-init in first cycle
+			logFastWeighting = logAverageWeighting;   // Must be done to avoid complete re-init in first cycle
 	}
-	PLOT("module:SelfLocator:averageWeighting", averageWeighting * 1e3);
-	PLOT("module:SelfLocator:slowWeighting", slowWeighting * 1e3);
-	PLOT("module:SelfLocator:fastWeighting", fastWeighting * 1e3);
+	PLOT("module:SelfLocator:logAverageWeighting", logAverageWeighting);
+	PLOT("module:SelfLocator:logSlowWeighting", logSlowWeighting);
+	PLOT("module:SelfLocator:logFastWeighting", logFastWeighting);
+	PLOT("module:SelfLocator:effectiveSampleSize", effectiveSampleSize);
 }
 
-void SelfLocator::generateTemplate(Sample& sample)
+void SelfLocator::generateTemplate(SampleReference sample)
 {
 	if (sampleTemplateGenerator.templatesAvailable())
 	{
@@ -717,7 +1017,7 @@ void SelfLocator::drawSamples()
 	const float maxWeighting = 2 * totalWeighting / numberOfSamples;
 	for (int i = 0; i < numberOfSamples; ++i)
 	{
-		const Sample& s(samples->at(i));
+		const Sample s(samples->at(i));
 		const Pose2D pose(s.angle, (float) s.translation.x, (float) s.translation.y);
 		unsigned char weighting = (unsigned char)(s.weighting / maxWeighting * 255);
 		Vector2<> bodyPoints[4] = {Vector2<>(55, 90),
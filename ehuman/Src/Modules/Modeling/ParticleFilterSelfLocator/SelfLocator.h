@@ -14,6 +14,8 @@
 
 #include "Tools/Module/Module.h"
 #include "Tools/SampleSet.h"
+#include "VectorizedMotionModel.h"
+#include "ChunkThreadPool.h"
 #include "Representations/Configuration/FieldDimensions.h"
 #include "Representations/Infrastructure/FrameInfo.h"
 #include "Representations/Infrastructure/GameInfo.h"
@@ -39,6 +41,7 @@
 #include "SensorModels/PerceptValidityChecker.h"
 #include "SensorModels/SensorModel.h"
 #include "SensorModels/FieldModel.h"
+#include "SensorModels/LikelihoodField.h"
 #include <vector>
 
 //#include "Representations/Modeling/CombinedWorldModel.h"
@@ -47,6 +50,7 @@
 template <typename Sample, typename SampleContainer>
 class PoseCalculator;
 class SelfLocatorParameter;
+class NaturalLandmarkSensorModel;
 
 MODULE(SelfLocator)
   REQUIRES(FieldDimensions)
@@ -85,6 +89,11 @@ private:
   */
   typedef SelfLocatorSample Sample;
 
+  /**
+  * A reference to a sample in the sample set, which stores the samples as a structure of arrays
+  */
+  typedef SampleSet<Sample>::Reference SampleReference;
+
   ENUM(PoseCalculatorType,
     POSE_CALCULATOR_2D_BINNING,
     POSE_CALCULATOR_PARTICLE_HISTORY,
@@ -96,10 +105,15 @@ private:
 
   SelfLocatorParameter* parameter; /**< All tweaking values. */
   FieldModel fieldModel; /**< The model of proximity to features on the field. */
+  LikelihoodField likelihoodField; /**< The precomputed distances to the field lines and corners used by the line and corners sensor models. */
   SampleSet<Sample>* samples; /**< Container for all samples. */
   float totalWeighting; /**< The current weighting sum of all samples. */
-  float slowWeighting; /**< This value follows the average weighting slowly. */
-  float fastWeighting; /**< This value follows the average weighting more quickly. */
+  float totalSquaredWeighting; /**< The current sum of the squared weightings of all samples. */
+  float effectiveSampleSize; /**< The effective number of samples, i.e. totalWeighting^2 / totalSquaredWeighting. */
+  bool logDomainWeighting; /**< Accumulate the sensor model weightings as log-likelihoods? */
+  float logWeightingOffset; /**< The log-likelihood that was subtracted before the weightings were exponentiated. */
+  float logSlowWeighting; /**< The logarithm of a value that follows the average weighting slowly. -infinity before the first update. */
+  float logFastWeighting; /**< The logarithm of a value that follows the average weighting more quickly. */
   Pose2D lastOdometry; /**< The last odometry state for calculating the offset since the last call. */
   bool updatedBySensors; /**< Was there an actual update during the previous observation update? */
   PoseCalculator< Sample, SampleSet<Sample> >* poseCalculator; /**< External class for computing a pose from a set of samples */
@@ -108,13 +122,64 @@ private:
   RobotPose lastComputedPose;            /**< The pose computed at lastPoseComputationTimeStamp*/
   SampleTemplateGenerator sampleTemplateGenerator; /**< Submodule for generating new samples */
   std::vector<SensorModel*> sensorModels; /**< List of all sensor models applied to the sample set*/
+  std::vector<bool> reentrantSensorModels; /**< Can the sensor model with the same index be evaluated by several threads at once? Such a model neither changes its state nor draws in computeWeightings. */
+  NaturalLandmarkSensorModel* naturalLandmarkSensorModel; /**< The natural landmark sensor model in sensorModels, which is told the position of the landmark before each sensor update. */
   std::vector<float> sensorModelWeightings; /**< Weightings for sample set after execution of sensor model*/
+  std::vector<float> logWeightings; /**< The accumulated log-likelihoods of the samples if logDomainWeighting is set. */
+  std::vector<float> cumulativeWeightings; /**< The prefix sums of the weightings used for resampling. */
+  std::vector<int> resampledIndices; /**< The indices of the old samples that are drawn during resampling. */
+  bool kldSampling; /**< Adapt the number of samples with KLD-sampling? */
+  std::vector<unsigned> kldBins; /**< The histogram over (x, y, rotation) used by KLD-sampling. A bin is occupied if it contains kldStamp. */
+  unsigned kldStamp; /**< The stamp of the current KLD-sampling step. */
+  std::vector<int> clusterIndexMap; /**< Maps cluster indices that became invalid when the number of samples was reduced to valid ones. */
   int gameInfoPenaltyLastFrame; /**< Was the robot penalised in the last frame? */
   int gameInfoGameStateLastFrame; /**< The game state in the last frame */
   std::vector<const LinePercept::Line*> lines; /**< Pointers to the lines of the line percept. */
   std::vector<SensorModel::Observation> observations, /**< The indices of the observations that might be selected for sensor update. */
       selectedObservations; /**< The indices of the observations that are selected for sensor update. */
   std::vector<int> selectedIndices; /**< The indices of the observations that are selected to be updated by a single sensor model. */
+  VectorizedMotionModel motionModel; /**< Applies the odometry and its noise to all samples. */
+
+  /**
+  * The moments of the positions of the samples of a cluster.
+  */
+  class ClusterMoments
+  {
+  public:
+    int count; /**< The number of samples. */
+    double sumX; /**< The sum of the x coordinates. */
+    double sumY; /**< The sum of the y coordinates. */
+    double sumXX; /**< The sum of the squared x coordinates. */
+    double sumYY; /**< The sum of the squared y coordinates. */
+    double sumXY; /**< The sum of the products of the x and y coordinates. */
+
+    ClusterMoments() : count(0), sumX(0), sumY(0), sumXX(0), sumYY(0), sumXY(0) {}
+  };
+  std::vector<ClusterMoments> clusterMoments; /**< The moments of all clusters, indexed by the cluster index of the samples. */
+  unsigned clusterMomentsTimeStamp; /**< The point of time the clusterMoments were computed. */
+
+  /**
+  * @class SensorModelEvaluation
+  * The evaluation of the reentrant sensor models for a chunk of the samples.
+  */
+  class SensorModelEvaluation : public ChunkThreadPool::Task
+  {
+  public:
+    SensorModelEvaluation(SelfLocator& selfLocator) : selfLocator(selfLocator) {}
+    void execute(int chunk) {selfLocator.computeChunkWeightings(chunk);}
+
+  private:
+    SelfLocator& selfLocator;
+  };
+
+  int sensorModelThreads; /**< The number of threads that evaluate the sensor models. 1 evaluates them in the thread of the module. */
+  ChunkThreadPool threadPool; /**< The threads that evaluate the sensor models on chunks of the samples. */
+  SensorModelEvaluation sensorModelEvaluation; /**< The task executed by the threadPool. */
+  int numberOfChunks; /**< The number of chunks the samples are split into for the sensor model evaluation. */
+  int chunkSize; /**< The number of samples per chunk. A multiple of 8. */
+  std::vector<std::vector<int> > modelSelectedIndices; /**< The selected observations per sensor model. */
+  std::vector<std::vector<float> > chunkWeightings; /**< The weightings per sensor model and chunk, indexed by model * numberOfChunks + chunk. */
+  std::vector<SensorModel::SensorModelResult> chunkResults; /**< The results per sensor model and chunk, indexed like chunkWeightings. */
 
   /**
   * The method provides the robot pose.
@@ -134,6 +199,24 @@ private:
   */
   void update(RobotPoseHypotheses& robotPoseHypotheses);
 
+  /**
+  * Computes the moments of all clusters in a single pass over the samples.
+  * The clusters are assigned by the pose calculator, which does not know about the
+  * moments, so they cannot be accumulated while the clusters are assigned. This extra
+  * pass is only made if hypotheses are requested and at most once per frame. It
+  * replaces the two passes over the samples per hypothesis that computed the covariances before.
+  */
+  void updateClusterMoments();
+
+  /**
+  * Computes the covariance of the positions of the samples of a cluster from its moments.
+  * @param cluster The index of the cluster.
+  * @param center The position the deviations are measured from, usually the pose of the cluster.
+  * @param hypothesis The hypothesis the position covariance of which is set.
+  * @return false, if the cluster contains less than two samples and the covariance is not set.
+  */
+  bool setPositionCovariance(int cluster, const Vector2<>& center, RobotPoseHypothesis& hypothesis) const;
+
   /**
   * The method prepares execution and initializes some values.
   * @param robotPose The robot pose representation that is updated by this module.
@@ -147,11 +230,42 @@ private:
   void motionUpdate(bool noise);
 
   /**
-  * Applies all sensor models to adjust the weightings of the samples
+  * Applies all sensor models to adjust the weightings of the samples.
+  * The sums required by adaptWeightings() are accumulated while the weightings are written.
   * @return true, if any new weightings have been computed. false, otherwise.
   */
   bool applySensorModels(bool naturalLandmarks);
 
+  /**
+  * Converts the accumulated log-likelihoods to weightings. The maximum is subtracted
+  * before the exponentiation, so the weightings do not underflow even if many
+  * observations are applied.
+  */
+  void exponentiateLogWeightings();
+
+  /**
+  * Evaluates the reentrant sensor models on chunks of the samples in parallel. The
+  * observations selected for each model must already be in modelSelectedIndices.
+  * All other models are evaluated later in the thread of the module.
+  */
+  void computeWeightingsInParallel();
+
+  /**
+  * Evaluates the reentrant sensor models on a single chunk of the samples. Each model writes
+  * to its own buffer of the chunk, so chunks can be processed concurrently.
+  * @param chunk The index of the chunk.
+  */
+  void computeChunkWeightings(int chunk);
+
+  /**
+  * Copies the weightings of all chunks of a reentrant sensor model to sensorModelWeightings.
+  * If the chunks returned different results, the model is evaluated again on all samples,
+  * so the result is always the one of the serial evaluation.
+  * @param model The index of the sensor model.
+  * @return The result of the sensor model.
+  */
+  SensorModel::SensorModelResult gatherChunkWeightings(int model);
+
   /**
   * The method performs the resampling step of particle filter localization.
   * It might add new samples generated from templates.
@@ -159,7 +273,43 @@ private:
   void resampling();
 
   /**
-  * Adapts the weightings for resampling percentage
+  * Draws samples from the prefix sums of the weightings with systematic resampling.
+  * The indices of the drawn samples are written to resampledIndices.
+  * @param numberOfOldSamples The number of samples the prefix sums were computed of.
+  * @param numberOfSamples The number of samples of the new set.
+  * @param resamplingPercentage The fraction of the new set that is left for templates.
+  * @param randomOffset The position of the first draw relative to the distance between two draws.
+  * @return The number of samples drawn.
+  */
+  int drawSystematically(int numberOfOldSamples, int numberOfSamples, float resamplingPercentage, float randomOffset);
+
+  /**
+  * Counts the histogram bins over (x, y, rotation) that are occupied by the drawn samples.
+  * @param set The samples the indices in resampledIndices refer to.
+  * @param count The number of drawn samples.
+  * @return The number of occupied bins.
+  */
+  int countOccupiedBins(const SelfLocatorSampleArrays& set, int count);
+
+  /**
+  * Computes the number of samples required by KLD-sampling.
+  * @param occupiedBins The number of occupied histogram bins.
+  * @return The number of samples, limited by the capacity of the sample set.
+  */
+  int kldSampleCount(int occupiedBins) const;
+
+  /**
+  * The particle history uses twice as many cluster indices as there are samples. After
+  * the number of samples was reduced, the samples of clusters whose indices are out of
+  * this range are assigned to unused indices within it. The samples of a cluster stay
+  * in the same cluster, and clusters with indices within the range keep their indices.
+  */
+  void remapClusterIndices();
+
+  /**
+  * Adapts the weightings for resampling percentage and computes the effective sample size.
+  * The averages are kept as logarithms, because the unscaled weightings underflow if
+  * many observations are combined in the log domain.
   */
   void adaptWeightings();
 
@@ -167,7 +317,7 @@ private:
   * Computes a template pose.
   * @param sample The resulting template sample.
   */
-  void generateTemplate(Sample& sample);
+  void generateTemplate(SampleReference sample);
 
   /**
   * Draws the particles.
@@ -0,0 +1,103 @@
+/**
+ * @file CornersSensorModel.h
+ *
+ * Sensor model for updating samples by perceived line intersections
+ *
+ * The B-Human version searched the closest corner of the field model for each
+ * intersection and sample. Here, the distance is looked up in the precomputed likelihood field.
+ */
+
+#pragma once
+
+#include "SensorModel.h"
+#include "Tools/SampleSet.h"
+#include "LikelihoodField.h"
+#include "Representations/Perception/LinePercept.h"
+
+/**
+ * @class CornersSensorModel
+ */
+
+class CornersSensorModel: public SensorModel
+{
+
+private:
+	/** The line percept. Observation i is the intersection i */
+	const LinePercept& theLinePercept;
+	/** The distances to the nearest corners of each class */
+	const LikelihoodField& likelihoodField;
+
+	/**
+	 * The orientation of an intersection in robot coordinates, i.e. the bisector of the legs
+	 * of an L and the stem of a T (dir2). The corner classes are numbered counterclockwise
+	 * in steps of 90 degrees. Class 0 is an L whose legs point along the x and y axes and a
+	 * T whose stem points along the x axis.
+	 */
+	static float getOrientation(const LinePercept::Intersection& intersection)
+	{
+		if(intersection.type == LinePercept::Intersection::L)
+			return (intersection.dir1 + intersection.dir2).angle() - pi_4;
+		return intersection.dir2.angle();
+	}
+
+public:
+	/** Constructor. */
+	CornersSensorModel(const SelfLocatorParameter& selfLocatorParameter,
+			const LinePercept& linePercept, const FrameInfo& frameInfo,
+			const FieldDimensions& fieldDimensions, const CameraMatrix& cameraMatrix,
+			const PerceptValidityChecker& perceptValidityChecker, const LikelihoodField& likelihoodField) :
+				SensorModel(selfLocatorParameter, frameInfo, fieldDimensions, cameraMatrix,
+						perceptValidityChecker, Observation::CORNER),
+						theLinePercept(linePercept), likelihoodField(likelihoodField)
+	{}
+
+	/**This function computes the weighting of each sample as the product of the likelihoods
+	of all selected intersections. An intersection is transformed to field coordinates with
+	the pose of the sample. Its corner class follows from its type and its orientation on the
+	field, i.e. the orientation of the intersection rotated by the rotation of the sample. The
+	distance to the closest corner of this class is looked up in the likelihood field instead
+	of searching the field model. The likelihood is the one of the angle under which this
+	distance is seen from the camera, with the standard deviation of the corners. Intersections
+	that are not valid from the position of a sample are not used for it. The model neither
+	changes its state nor draws, so it can be evaluated on chunks of the samples concurrently. */
+	SensorModelResult computeWeightings(const SampleSet<SelfLocatorSample>& samples,
+			const vector<int>& selectedIndices, vector<float>& weightings)
+	{
+		if (selectedIndices.empty())
+			return NO_SENSOR_UPDATE;
+
+		const float camZ = theCameraMatrix.translation.z;
+		const float factor = -0.5f / (parameter.standardDeviationCorners * parameter.standardDeviationCorners);
+
+		for(int i = 0; i < samples.size(); ++i)
+			weightings[i] = 1.f;
+
+		for(vector<int>::const_iterator s = selectedIndices.begin(); s != selectedIndices.end(); ++s)
+		{
+			const LinePercept::Intersection& intersection = theLinePercept.intersections[*s];
+			const Vector2<> point((float) intersection.pos.x, (float) intersection.pos.y);
+			const float distanceToCamera = sqrt(point * point + camZ * camZ);
+			const bool isX = intersection.type == LinePercept::Intersection::X;
+			const int firstClass = isX ? FieldDimensions::xCorner
+					: intersection.type == LinePercept::Intersection::T ? FieldDimensions::tCorner0 : FieldDimensions::lCorner0;
+			const float orientation = isX ? 0.f : getOrientation(intersection);
+			//The rotations of the samples are stored as cosine and sine * 1024
+			const float px = point.x / 1024.f;
+			const float py = point.y / 1024.f;
+			for(int i = 0; i < samples.size(); ++i)
+			{
+				const Vector2<> position((float) samples.x[i], (float) samples.y[i]);
+				const Vector2<> fieldPoint(position.x + samples.cosAngle[i] * px - samples.sinAngle[i] * py,
+						position.y + samples.sinAngle[i] * px + samples.cosAngle[i] * py);
+				if(!perceptValidityChecker.isPointValid(position, fieldPoint))
+					continue;
+				const int cornerClass = isX ? firstClass
+						: firstClass + (int(floor(normalize(orientation + samples.angle[i]) / pi_2 + 0.5f)) + 4) % 4;
+				const float angle = atan2(likelihoodField.distanceToCorner(fieldPoint, FieldDimensions::CornerClass(cornerClass)), distanceToCamera);
+				weightings[i] *= exp(angle * angle * factor);
+			}
+		}
+		return FULL_SENSOR_UPDATE;
+	}
+
+};
@@ -0,0 +1,98 @@
+/**
+* @file LikelihoodField.cpp
+* Implements a precomputed grid of the distances to the nearest field line and to
+* the nearest corner of each corner class.
+*/
+
+#include "LikelihoodField.h"
+#include "Tools/Debugging/DebugDrawings.h"
+#include <algorithm>
+
+LikelihoodField::LikelihoodField(float cellSize) :
+  cellSize(cellSize), width(0), height(0)
+{}
+
+/**
+* The distance between a point and a line segment.
+*/
+static float distanceToSegment(const Vector2<>& p, const Vector2<>& start, const Vector2<>& end)
+{
+  const Vector2<> dir = end - start;
+  const float length2 = dir * dir;
+  float t = length2 > 0 ? ((p - start) * dir) / length2 : 0;
+  t = std::max(0.f, std::min(1.f, t));
+  return (p - (start + dir * t)).abs();
+}
+
+void LikelihoodField::init(const FieldDimensions& fieldDimensions)
+{
+  const float minX = (float) fieldDimensions.xPosOwnFieldBorder;
+  const float minY = (float) fieldDimensions.yPosRightFieldBorder;
+  width = int(((float) fieldDimensions.xPosOpponentFieldBorder - minX) / cellSize) + 2;
+  height = int(((float) fieldDimensions.yPosLeftFieldBorder - minY) / cellSize) + 2;
+  origin = Vector2<>(minX, minY);
+  cells.resize(width * height * numOfMaps);
+
+  // the end points of the lines, computed once
+  const std::vector<FieldDimensions::LinesTable::Line>& lines = fieldDimensions.fieldLines.lines;
+  std::vector<Vector2<> > starts(lines.size()), ends(lines.size());
+  for(unsigned i = 0; i < lines.size(); ++i)
+  {
+    starts[i] = lines[i].corner.translation;
+    ends[i] = lines[i].corner * Vector2<>(lines[i].length, 0);
+  }
+
+  const int mapSize = width * height;
+  for(int y = 0; y < height; ++y)
+    for(int x = 0; x < width; ++x)
+    {
+      unsigned short* cell = &cells[y * width + x];
+      const Vector2<> p(origin.x + x * cellSize, origin.y + y * cellSize);
+
+      float minDistance = 65535.f;
+      for(unsigned i = 0; i < lines.size(); ++i)
+        minDistance = std::min(minDistance, distanceToSegment(p, starts[i], ends[i]));
+      cell[lineMap * mapSize] = (unsigned short) (minDistance + 0.5f);
+
+      for(int c = 0; c < FieldDimensions::numOfCornerClasss; ++c)
+      {
+        minDistance = 65535.f;
+        const FieldDimensions::CornersTable& corners = fieldDimensions.corners[c];
+        for(FieldDimensions::CornersTable::const_iterator i = corners.begin(); i != corners.end(); ++i)
+          minDistance = std::min(minDistance, (p - Vector2<>((float) i->x, (float) i->y)).abs());
+        cell[(1 + c) * mapSize] = (unsigned short) (minDistance + 0.5f);
+      }
+    }
+}
+
+float LikelihoodField::distance(const Vector2<>& p, int map) const
+{
+  // the cell coordinates, clipped so that the four neighbours are inside the grid
+  const float fx = std::max(0.f, std::min((float) (width - 1) - 1e-3f, (p.x - origin.x) / cellSize));
+  const float fy = std::max(0.f, std::min((float) (height - 1) - 1e-3f, (p.y - origin.y) / cellSize));
+  const int x = int(fx);
+  const int y = int(fy);
+  const float dx = fx - x;
+  const float dy = fy - y;
+
+  const unsigned short* c00 = &cells[(map * height + y) * width + x];
+  const unsigned short* c01 = c00 + width;
+  const float top = c00[0] + (c00[1] - c00[0]) * dx;
+  const float bottom = c01[0] + (c01[1] - c01[0]) * dx;
+  return top + (bottom - top) * dy;
+}
+
+void LikelihoodField::draw() const
+{
+  DECLARE_DEBUG_DRAWING("module:SelfLocator:likelihoodField", "drawingOnField");
+  COMPLEX_DRAWING("module:SelfLocator:likelihoodField",
+  {
+    for(int y = 0; y < height; y += 2)
+      for(int x = 0; x < width; x += 2)
+      {
+        const unsigned char intensity = (unsigned char) std::max(0, 255 - cells[(lineMap * height + y) * width + x] / 2);
+        DOT("module:SelfLocator:likelihoodField", origin.x + x * cellSize, origin.y + y * cellSize,
+            ColorRGBA(intensity, intensity, intensity), ColorRGBA(intensity, intensity, intensity));
+      }
+  });
+}
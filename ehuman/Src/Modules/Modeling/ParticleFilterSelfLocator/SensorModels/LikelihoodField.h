@@ -0,0 +1,74 @@
+/**
+* @file LikelihoodField.h
+* Declares a precomputed grid of the distances to the nearest field line and to
+* the nearest corner of each corner class.
+*/
+
+#pragma once
+
+#include "Representations/Configuration/FieldDimensions.h"
+#include <vector>
+
+/**
+* @class LikelihoodField
+* A quantized distance map over the carpet. It is built once from the field
+* dimensions, so the distance of a point to the nearest field line or corner is a
+* bilinear interpolation between four neighbouring cells instead of a search over
+* all lines or corners. The distances are stored in mm as unsigned shorts. Each
+* map is stored separately row by row, so the four cells of a lookup lie in two
+* neighbouring rows of the same map.
+*/
+class LikelihoodField
+{
+public:
+  /** The maps. The first is the line map, followed by one map per corner class. */
+  enum {lineMap = 0, numOfMaps = 1 + FieldDimensions::numOfCornerClasss};
+
+  /**
+  * Constructor.
+  * @param cellSize The edge length of a grid cell in mm.
+  */
+  LikelihoodField(float cellSize = 50.f);
+
+  /**
+  * Computes all maps.
+  * @param fieldDimensions The field dimensions.
+  */
+  void init(const FieldDimensions& fieldDimensions);
+
+  /**
+  * The distance to the nearest field line.
+  * @param p A point on the field in mm.
+  * @return The distance in mm.
+  */
+  float distanceToLine(const Vector2<>& p) const {return distance(p, lineMap);}
+
+  /**
+  * The distance to the nearest corner of a class.
+  * @param p A point on the field in mm.
+  * @param cornerClass The class of the corner.
+  * @return The distance in mm.
+  */
+  float distanceToCorner(const Vector2<>& p, FieldDimensions::CornerClass cornerClass) const
+  {
+    return distance(p, 1 + cornerClass);
+  }
+
+  /** Draws the line map. */
+  void draw() const;
+
+private:
+  float cellSize; /**< The edge length of a grid cell in mm. */
+  Vector2<> origin; /**< The position of the center of the first cell. */
+  int width; /**< The number of cells in x direction. */
+  int height; /**< The number of cells in y direction. */
+  std::vector<unsigned short> cells; /**< The distances in mm, one map after the other, row by row. */
+
+  /**
+  * Bilinear interpolation of one of the maps.
+  * @param p The point on the field in mm. Points outside the grid are clipped to its border.
+  * @param map The index of the map.
+  * @return The interpolated distance in mm.
+  */
+  float distance(const Vector2<>& p, int map) const;
+};
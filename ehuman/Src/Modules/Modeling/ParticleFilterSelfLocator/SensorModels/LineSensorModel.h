@@ -0,0 +1,84 @@
+/**
+ * @file LineSensorModel.h
+ *
+ * Sensor model for updating samples by perceived points on field lines
+ *
+ * The B-Human version searched the closest field line of the field model for each
+ * point and sample. Here, the distance is looked up in the precomputed likelihood field.
+ */
+
+#pragma once
+
+#include "SensorModel.h"
+#include "Tools/SampleSet.h"
+#include "LikelihoodField.h"
+#include "Representations/Perception/LinePercept.h"
+
+/**
+ * @class LineSensorModel
+ */
+
+class LineSensorModel: public SensorModel
+{
+
+private:
+	/** The lines of the line percept. Observation i is the first (even i) or last (odd i) point of line i / 2 */
+	const vector<const LinePercept::Line*>& lines;
+	/** The distances to the nearest field line */
+	const LikelihoodField& likelihoodField;
+
+public:
+	/** Constructor. */
+	LineSensorModel(const SelfLocatorParameter& selfLocatorParameter,
+			const vector<const LinePercept::Line*>& lines, const FrameInfo& frameInfo,
+			const FieldDimensions& fieldDimensions, const CameraMatrix& cameraMatrix,
+			const PerceptValidityChecker& perceptValidityChecker, const LikelihoodField& likelihoodField) :
+				SensorModel(selfLocatorParameter, frameInfo, fieldDimensions, cameraMatrix,
+						perceptValidityChecker, Observation::POINT),
+						lines(lines), likelihoodField(likelihoodField)
+	{}
+
+	/**This function computes the weighting of each sample as the product of the likelihoods
+	of all selected points. A point is transformed to field coordinates with the pose of the
+	sample and its distance to the closest field line is looked up in the likelihood field
+	instead of searching the field model. The likelihood is the one of the angle under which
+	this distance is seen from the camera, with the standard deviation of the field lines.
+	Points that are not valid from the position of a sample are not used for it. The model
+	neither changes its state nor draws, so it can be evaluated on chunks of the samples
+	concurrently. */
+	SensorModelResult computeWeightings(const SampleSet<SelfLocatorSample>& samples,
+			const vector<int>& selectedIndices, vector<float>& weightings)
+	{
+		if (selectedIndices.empty())
+			return NO_SENSOR_UPDATE;
+
+		const float camZ = theCameraMatrix.translation.z;
+		const float factor = -0.5f / (parameter.standardDeviationFieldLines * parameter.standardDeviationFieldLines);
+
+		for(int i = 0; i < samples.size(); ++i)
+			weightings[i] = 1.f;
+
+		for(vector<int>::const_iterator s = selectedIndices.begin(); s != selectedIndices.end(); ++s)
+		{
+			const LinePercept::Line& line = *lines[*s / 2];
+			const Vector2<> point((*s & 1) ? Vector2<>((float) line.last.x, (float) line.last.y)
+					: Vector2<>((float) line.first.x, (float) line.first.y));
+			const float distanceToCamera = sqrt(point * point + camZ * camZ);
+			//The rotations of the samples are stored as cosine and sine * 1024
+			const float px = point.x / 1024.f;
+			const float py = point.y / 1024.f;
+			for(int i = 0; i < samples.size(); ++i)
+			{
+				const Vector2<> position((float) samples.x[i], (float) samples.y[i]);
+				const Vector2<> fieldPoint(position.x + samples.cosAngle[i] * px - samples.sinAngle[i] * py,
+						position.y + samples.sinAngle[i] * px + samples.cosAngle[i] * py);
+				if(!perceptValidityChecker.isPointValid(position, fieldPoint))
+					continue;
+				const float angle = atan2(likelihoodField.distanceToLine(fieldPoint), distanceToCamera);
+				weightings[i] *= exp(angle * angle * factor);
+			}
+		}
+		return FULL_SENSOR_UPDATE;
+	}
+
+};
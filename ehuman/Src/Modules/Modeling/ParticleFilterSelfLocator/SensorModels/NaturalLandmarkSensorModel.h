@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include "Tools/SampleSet.h"
+
 /**
  * @class NaturalLandmarkSensorModel
  */
@@ -21,14 +23,58 @@ private:
 	 */
 	//const NaturalLandmarkPercept &theNaturalLandmarkPercept;
 	const NaturalLandmarkPerceptBrisk& theNaturalLandmarkPerceptBrisk;
-	/** The threshold used to determine if the 2 images are a match	 */
-	int threshold;
 
-	ENUM(HeadDirection,
-			FACING_LEFT,
-			FACING_RIGHT,
-			FACING_FRONT
-	);
+	/** The number of bins of a full turn. A power of 2, so angular differences wrap with a mask */
+	enum {numOfDirectionBins = 256};
+	/** The edge length of a cell of the direction table in mm */
+	static const int cellSize = 100;
+
+	/** The field position of the landmark the direction table was computed for */
+	Vector2<> landmarkPosition;
+	/** The lower left corner of the direction table */
+	Vector2<int> origin;
+	/** The number of cells of the direction table in x and y direction */
+	int width, height;
+	/** The direction from each cell to the landmark in bins, row by row */
+	std::vector<unsigned char> landmarkDirections;
+	/** The likelihood of each difference between the expected and the perceived bearing in bins */
+	float bearingLikelihoods[numOfDirectionBins];
+
+	/** Converts an angle in [-2pi, 2pi] to a direction bin */
+	static int toBin(float angle)
+	{
+		return int(angle * (numOfDirectionBins / pi2) + 3 * numOfDirectionBins + 0.5f) & (numOfDirectionBins - 1);
+	}
+
+	/** Precomputes the direction to the landmark for every cell of the carpet */
+	void initDirections()
+	{
+		origin = Vector2<int>(theFieldDimensions.xPosOwnFieldBorder, theFieldDimensions.yPosRightFieldBorder);
+		width = (theFieldDimensions.xPosOpponentFieldBorder - origin.x) / cellSize + 1;
+		height = (theFieldDimensions.yPosLeftFieldBorder - origin.y) / cellSize + 1;
+		landmarkDirections.resize(width * height);
+		for(int y = 0; y < height; ++y)
+			for(int x = 0; x < width; ++x)
+			{
+				const Vector2<> center(origin.x + (x + 0.5f) * cellSize, origin.y + (y + 0.5f) * cellSize);
+				landmarkDirections[y * width + x] = (unsigned char)toBin((landmarkPosition - center).angle());
+			}
+	}
+
+	/** Computes the likelihoods of all bearing differences */
+	void initBearingLikelihoods()
+	{
+		//The standard deviation of the perceived bearing in radians
+		const float bearingDeviation = 0.15f;
+		//The weighting of a sample that does not fit the perceived bearing at all
+		const float minLikelihood = 0.001f;
+		const float factor = -0.5f / (bearingDeviation * bearingDeviation);
+		for(int i = 0; i < numOfDirectionBins; ++i)
+		{
+			const float difference = normalize(i * (pi2 / numOfDirectionBins));
+			bearingLikelihoods[i] = std::max(minLikelihood, (float)exp(difference * difference * factor));
+		}
+	}
 
 public:
 	/** Constructor. */
@@ -48,65 +94,53 @@ public:
 				SensorModel(selfLocatorParameter, frameInfo, fieldDimensions, cameraMatrix,
 						perceptValidityChecker, Observation::NATURAL_LANDMARKS),
 						theNaturalLandmarkPerceptBrisk(naturalLandmarkPerceptBrisk)
-	{}
+	{
+		initBearingLikelihoods();
+	}
+
+	/**
+	 * Sets the field position of the landmark shown by the reference image, as reported by
+	 * the percept. The direction table is only recomputed if the position changed. This must
+	 * be called before computeWeightings, which only reads the table.
+	 * @param position The field position of the landmark in mm.
+	 */
+	void setLandmarkPosition(const Vector2<>& position)
+	{
+		if(landmarkDirections.empty() || position != landmarkPosition)
+		{
+			landmarkPosition = position;
+			initDirections();
+		}
+	}
 
 	/**This function will compute the weighting for particles depending on whether
-	there was a match with one of the images representing the opponents goal.
-	It takes all three head directions into account assuming the robot is placed anywhere
-	on the field. However, the assumption is that if the robot is placed away
-	from the half-way line, then it is placed facing the opponents goal. A routine
-	could be added to make the robot turn around if it cannot find any matches.
-	This would be initiated if the robot has tried to find matches twice and cannot
-	seem to establish a match. */
+	the bearing of the matched reference image fits the direction from the particle to
+	the landmark it shows. The direction from the cell of a particle to the landmark is taken from a precomputed table and the likelihood of the difference
+	to the perceived bearing from a second one, so the weighting of a particle is two table
+	lookups without any branches. */
 	SensorModelResult computeWeightings(const SampleSet<SelfLocatorSample>& samples,
 			const vector<int>& selectedIndices, vector<float>& weightings)
 	{
-		//Initialise the weights
-		float strongWeight = 0.999;
-		float epsilonWeight = 0.001;
-
-		//Note that this function needs to know the orientation of the robot's head
-		HeadDirection headDirection;
-
 		//Determines whether or not a match has been found
 		//bool matchFound = theNaturalLandmarkPercept.matchFound;
 		bool matchFound = theNaturalLandmarkPerceptBrisk.matchFound;
 
 		if (matchFound)
 		{
-			SensorModelResult result = FULL_SENSOR_UPDATE;
+			//The direction of the landmark relative to the particle is the table direction
+			//minus the rotation of the particle, so the perceived bearing is subtracted as well
+			const int bearingBin = toBin(theNaturalLandmarkPerceptBrisk.bearing);
+			const unsigned char* directions = &landmarkDirections[0];
+			const int maxX = width - 1;
+			const int maxY = height - 1;
 			for(int i = 0; i < samples.size(); ++i)
 			{
-				const SelfLocatorSample& s(samples.at(i));
-				//			const Vector2<int> origin(int(s.translation.x), int(s.translation.y)),
-				//					camRotation((rotCos * s.rotation.x - rotSin * s.rotation.y) >> 10,
-				//							(rotCos * s.rotation.y + rotSin * s.rotation.x) >> 10);
-
-				weightings[i] = 1.0f;
-
-				//The weightings are updated here
-				if(headDirection==FACING_LEFT){
-					if(s.translation.y<0)
-						weightings[i] *= epsilonWeight;
-					else
-						weightings[i] *= strongWeight;
-				}
-				else if(headDirection==FACING_RIGHT){
-					if(s.translation.y>0)
-						weightings[i] *= epsilonWeight;
-					else
-						weightings[i] *= strongWeight;
-				}
-				else if(headDirection==FACING_FRONT){
-					if(s.translation.x>0)
-						weightings[i] *= epsilonWeight;
-					else
-						weightings[i] *= strongWeight;
-				}
+				const int x = std::max(0, std::min(maxX, (samples.x[i] - origin.x) / cellSize));
+				const int y = std::max(0, std::min(maxY, (samples.y[i] - origin.y) / cellSize));
+				const int difference = directions[y * width + x] - toBin(samples.angle[i]) - bearingBin;
+				weightings[i] = bearingLikelihoods[difference & (numOfDirectionBins - 1)];
 			}
-
-
-			return result;
+			return FULL_SENSOR_UPDATE;
 		}
 		else
 			return NO_SENSOR_UPDATE;
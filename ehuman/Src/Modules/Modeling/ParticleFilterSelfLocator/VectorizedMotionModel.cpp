@@ -0,0 +1,148 @@
+/**
+* @file VectorizedMotionModel.cpp
+* Implements a class that applies the odometry offset plus noise to all samples
+* of the SelfLocator using SSE.
+*/
+
+#include "VectorizedMotionModel.h"
+
+/** Rotates the 32 bit lanes of v left by k bits. */
+#define ROTL(v, k) _mm_or_si128(_mm_slli_epi32(v, k), _mm_srli_epi32(v, 32 - (k)))
+
+/**
+* splitmix32, used to derive well distributed generator states from a single seed.
+*/
+static unsigned splitMix(unsigned& x)
+{
+  unsigned z = (x += 0x9e3779b9u);
+  z = (z ^ (z >> 16)) * 0x85ebca6bu;
+  z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+  return z ^ (z >> 16);
+}
+
+VectorizedMotionModel::VectorizedMotionModel(unsigned seed)
+{
+  this->seed(seed);
+}
+
+void VectorizedMotionModel::seed(unsigned seed)
+{
+  unsigned words[2][4][4];
+  for(int group = 0; group < 2; ++group)
+    for(int lane = 0; lane < 4; ++lane)
+    {
+      // every lane gets its own stream, so the lanes are not correlated
+      unsigned x = seed + (group * 4 + lane) * 0x632be5abu;
+      for(int w = 0; w < 4; ++w)
+        words[group][w][lane] = splitMix(x);
+    }
+  for(int group = 0; group < 2; ++group)
+    for(int w = 0; w < 4; ++w)
+      state[group][w] = _mm_loadu_si128((const __m128i*) words[group][w]);
+}
+
+inline __m128 VectorizedMotionModel::nextRandom(__m128i* s)
+{
+  // xoshiro128+
+  const __m128i result = _mm_add_epi32(s[0], s[3]);
+  const __m128i t = _mm_slli_epi32(s[1], 9);
+  s[2] = _mm_xor_si128(s[2], s[0]);
+  s[3] = _mm_xor_si128(s[3], s[1]);
+  s[1] = _mm_xor_si128(s[1], s[2]);
+  s[0] = _mm_xor_si128(s[0], s[3]);
+  s[2] = _mm_xor_si128(s[2], t);
+  s[3] = ROTL(s[3], 11);
+
+  // the upper 23 bits become the mantissa of a float in [1, 2)
+  const __m128i mantissa = _mm_or_si128(_mm_srli_epi32(result, 9), _mm_set1_epi32(0x3f800000));
+  return _mm_sub_ps(_mm_castsi128_ps(mantissa), _mm_set1_ps(1.f));
+}
+
+inline void VectorizedMotionModel::sinCos(__m128 angle, __m128& sin, __m128& cos)
+{
+  // reduce to [-pi/4, pi/4] and the quadrant j
+  const __m128i j = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(0.63661977236f)));
+  const __m128 jf = _mm_cvtepi32_ps(j);
+  __m128 r = _mm_sub_ps(angle, _mm_mul_ps(jf, _mm_set1_ps(1.5703125f)));
+  r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(4.837512969970703125e-4f)));
+  r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(7.54978995489188216e-8f)));
+  const __m128 r2 = _mm_mul_ps(r, r);
+
+  // minimax polynomials on [-pi/4, pi/4]
+  __m128 s = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)), _mm_set1_ps(8.3321608736e-3f));
+  s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(-1.6666654611e-1f));
+  s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, r2), r), r);
+  __m128 c = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)), _mm_set1_ps(-1.388731625493765e-3f));
+  c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(4.166664568298827e-2f));
+  c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, r2), r2), _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))));
+
+  // odd quadrants exchange sine and cosine, the sign bits follow from the quadrant
+  const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+  const __m128 signSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), 30));
+  const __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+  sin = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), signSin);
+  cos = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), signCos);
+}
+
+inline void VectorizedMotionModel::updateFour(SampleSet<SelfLocatorSample>& samples, int i, __m128i* s,
+    __m128 transX, __m128 transY, __m128 transXError, __m128 transYError,
+    __m128 rotation, __m128 rotationError,
+    __m128 minX, __m128 minY, __m128 maxX, __m128 maxY)
+{
+  const __m128 two = _mm_set1_ps(2.f);
+  const __m128 one = _mm_set1_ps(1.f);
+
+  // the translational error vector, uniformly distributed in [trans - error, trans + error)
+  const __m128 offsetX = _mm_add_ps(_mm_sub_ps(transX, transXError), _mm_mul_ps(_mm_mul_ps(transXError, two), nextRandom(s)));
+  const __m128 offsetY = _mm_add_ps(_mm_sub_ps(transY, transYError), _mm_mul_ps(_mm_mul_ps(transYError, two), nextRandom(s)));
+
+  // rotate the offset into field coordinates with the current rotation of the samples
+  const __m128 cosAngle = _mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*) (samples.cosAngle + i))), _mm_set1_ps(1.f / 1024.f));
+  const __m128 sinAngle = _mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*) (samples.sinAngle + i))), _mm_set1_ps(1.f / 1024.f));
+  __m128 x = _mm_cvtepi32_ps(_mm_load_si128((const __m128i*) (samples.x + i)));
+  __m128 y = _mm_cvtepi32_ps(_mm_load_si128((const __m128i*) (samples.y + i)));
+  x = _mm_add_ps(x, _mm_sub_ps(_mm_mul_ps(offsetX, cosAngle), _mm_mul_ps(offsetY, sinAngle)));
+  y = _mm_add_ps(y, _mm_add_ps(_mm_mul_ps(offsetX, sinAngle), _mm_mul_ps(offsetY, cosAngle)));
+
+  // clip to the carpet
+  x = _mm_min_ps(_mm_max_ps(x, minX), maxX);
+  y = _mm_min_ps(_mm_max_ps(y, minY), maxY);
+  _mm_store_si128((__m128i*) (samples.x + i), _mm_cvtps_epi32(x));
+  _mm_store_si128((__m128i*) (samples.y + i), _mm_cvtps_epi32(y));
+
+  // the new rotation, normalized to [-pi, pi]
+  __m128 angle = _mm_load_ps(samples.angle + i);
+  angle = _mm_add_ps(angle, _mm_add_ps(rotation, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(nextRandom(s), two), one), rotationError)));
+  const __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(0.15915494309f))));
+  angle = _mm_sub_ps(angle, _mm_mul_ps(turns, _mm_set1_ps(6.28318530718f)));
+  _mm_store_ps(samples.angle + i, angle);
+
+  __m128 sin, cos;
+  sinCos(angle, sin, cos);
+  _mm_store_si128((__m128i*) (samples.cosAngle + i), _mm_cvttps_epi32(_mm_mul_ps(cos, _mm_set1_ps(1024.f))));
+  _mm_store_si128((__m128i*) (samples.sinAngle + i), _mm_cvttps_epi32(_mm_mul_ps(sin, _mm_set1_ps(1024.f))));
+}
+
+void VectorizedMotionModel::update(SampleSet<SelfLocatorSample>& samples, const Pose2D& odometryOffset,
+                                   const Vector2<>& translationError, float rotationError,
+                                   const Vector2<>& carpetMin, const Vector2<>& carpetMax)
+{
+  const __m128 transX = _mm_set1_ps(odometryOffset.translation.x);
+  const __m128 transY = _mm_set1_ps(odometryOffset.translation.y);
+  const __m128 transXError = _mm_set1_ps(translationError.x);
+  const __m128 transYError = _mm_set1_ps(translationError.y);
+  const __m128 rotation = _mm_set1_ps(odometryOffset.rotation);
+  const __m128 rotError = _mm_set1_ps(rotationError);
+  const __m128 minX = _mm_set1_ps(carpetMin.x);
+  const __m128 minY = _mm_set1_ps(carpetMin.y);
+  const __m128 maxX = _mm_set1_ps(carpetMax.x);
+  const __m128 maxY = _mm_set1_ps(carpetMax.y);
+
+  // the arrays are padded to a multiple of 8 samples
+  const int paddedSize = samples.paddedSize();
+  for(int i = 0; i < paddedSize; i += 8)
+  {
+    updateFour(samples, i, state[0], transX, transY, transXError, transYError, rotation, rotError, minX, minY, maxX, maxY);
+    updateFour(samples, i + 4, state[1], transX, transY, transXError, transYError, rotation, rotError, minX, minY, maxX, maxY);
+  }
+}
@@ -0,0 +1,72 @@
+/**
+* @file VectorizedMotionModel.h
+* Declares a class that applies the odometry offset plus noise to all samples
+* of the SelfLocator using SSE. Eight samples are processed per iteration.
+*/
+
+#pragma once
+
+#include "Tools/Math/Pose2D.h"
+#include "Tools/SampleSet.h"
+#include <emmintrin.h>
+
+/**
+* @class VectorizedMotionModel
+* The motion update of SelfLocator::motionUpdate without any per sample branches
+* or library calls:
+* - The random numbers are drawn from eight xoshiro128+ generators, one per lane,
+*   so the noise is reproducible for a given seed.
+* - sin and cos are approximated by polynomials (error below 1e-6).
+* - Clipping to the carpet is done with min/max.
+*/
+class VectorizedMotionModel
+{
+public:
+  /**
+  * Constructor.
+  * @param seed The seed of the random number generators.
+  */
+  VectorizedMotionModel(unsigned seed = 0);
+
+  /**
+  * (Re)seeds the random number generators. The same seed results in the same sequence of noise.
+  * @param seed The seed.
+  */
+  void seed(unsigned seed);
+
+  /**
+  * Moves all samples (including the padding) by the odometry offset plus noise.
+  * @param samples The sample set.
+  * @param odometryOffset The odometry offset since the last frame in robot coordinates.
+  * @param translationError The maximum translational error in x and y direction.
+  * @param rotationError The maximum rotational error.
+  * @param carpetMin The lower left corner of the carpet.
+  * @param carpetMax The upper right corner of the carpet.
+  */
+  void update(SampleSet<SelfLocatorSample>& samples, const Pose2D& odometryOffset,
+              const Vector2<>& translationError, float rotationError,
+              const Vector2<>& carpetMin, const Vector2<>& carpetMax);
+
+private:
+  /** The states of the generators. Lanes 0-3 use state[0], lanes 4-7 use state[1]. */
+  __m128i state[2][4];
+
+  /**
+  * Draws four uniformly distributed random numbers in [0, 1).
+  * @param s The state of the generators of four lanes.
+  */
+  static inline __m128 nextRandom(__m128i* s);
+
+  /**
+  * Computes sine and cosine of four angles in [-pi, pi].
+  */
+  static inline void sinCos(__m128 angle, __m128& sin, __m128& cos);
+
+  /**
+  * Updates four samples starting at index i.
+  */
+  inline void updateFour(SampleSet<SelfLocatorSample>& samples, int i, __m128i* s,
+                         __m128 transX, __m128 transY, __m128 transXError, __m128 transYError,
+                         __m128 rotation, __m128 rotationError,
+                         __m128 minX, __m128 minY, __m128 maxX, __m128 maxY);
+};
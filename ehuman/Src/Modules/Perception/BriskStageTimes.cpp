@@ -0,0 +1,74 @@
+/**
+* @file BriskStageTimes.cpp
+* Implements a class that measures how long the stages of the NaturalLandmarkPerceptorBrisk
+* take and publishes the durations as plots.
+*/
+
+#include "BriskStageTimes.h"
+#include "Tools/Debugging/DebugDrawings.h"
+#include "Tools/Debugging/BenchmarkSupport.h"
+#include <algorithm>
+
+/** Plots the duration of a stage in the current frame and the statistics of its history. */
+#define PLOT_STAGE(stage) \
+  { \
+    float min, mean, p99; \
+    getStatistics(stage, min, mean, p99); \
+    PLOT("module:NaturalLandmarkPerceptorBrisk:" #stage, current[stage]); \
+    PLOT("module:NaturalLandmarkPerceptorBrisk:" #stage "Min", min); \
+    PLOT("module:NaturalLandmarkPerceptorBrisk:" #stage "Mean", mean); \
+    PLOT("module:NaturalLandmarkPerceptorBrisk:" #stage "P99", p99); \
+  }
+
+BriskStageTimes::Scope::Scope(BriskStageTimes& times, Stage stage) :
+  times(times), stage(stage), start(times.enabled ? BenchmarkSupport::now() : 0)
+{}
+
+BriskStageTimes::Scope::~Scope()
+{
+  if(times.enabled)
+    times.current[stage] += float(BenchmarkSupport::now() - start);
+}
+
+BriskStageTimes::BriskStageTimes() : enabled(false)
+{
+  std::fill(current, current + numOfStages, 0.f);
+}
+
+void BriskStageTimes::beginFrame(bool enabled)
+{
+  this->enabled = enabled;
+  std::fill(current, current + numOfStages, 0.f);
+}
+
+void BriskStageTimes::endFrame()
+{
+  if(!enabled)
+    return;
+  for(int i = 0; i < numOfStages; ++i)
+    history[i].add(current[i]);
+
+  PLOT_STAGE(conversion);
+  PLOT_STAGE(pyramid);
+  PLOT_STAGE(agast);
+  PLOT_STAGE(refinement);
+  PLOT_STAGE(description);
+  PLOT_STAGE(matching);
+  PLOT_STAGE(verification);
+}
+
+void BriskStageTimes::getStatistics(Stage stage, float& min, float& mean, float& p99) const
+{
+  const int n = history[stage].getNumberOfEntries();
+  float sorted[historySize];
+  float sum = 0;
+  for(int i = 0; i < n; ++i)
+  {
+    sorted[i] = history[stage][i];
+    sum += sorted[i];
+  }
+  std::sort(sorted, sorted + n);
+  min = n ? sorted[0] : 0;
+  mean = n ? sum / n : 0;
+  p99 = n ? sorted[(n * 99 + 99) / 100 - 1] : 0; // nearest rank
+}
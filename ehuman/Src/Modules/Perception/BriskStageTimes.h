@@ -0,0 +1,77 @@
+/**
+* @file BriskStageTimes.h
+* Declares a class that measures how long the stages of the NaturalLandmarkPerceptorBrisk
+* take and publishes the durations as plots.
+*/
+
+#pragma once
+
+#include "Tools/RingBuffer.h"
+
+/**
+* @class BriskStageTimes
+* The durations of the stages are measured with the monotonic clock and summed up per
+* frame, since a stage can run more than once per frame (e.g. the description for the
+* tracking and for the full matching). For each stage, the duration of the current
+* frame and the minimum, mean and 99th percentile over the last frames are plotted
+* as module:NaturalLandmarkPerceptorBrisk:<stage>[Min|Mean|P99] in ms.
+* Nothing is measured while the timing is disabled.
+*/
+class BriskStageTimes
+{
+public:
+  /** The stages of the perceptor. */
+  enum Stage
+  {
+    conversion, /**< Copying the image into the grayscale matrix. */
+    pyramid, /**< Constructing the scale space. */
+    agast, /**< Detecting the AGAST corners in all layers. */
+    refinement, /**< Non-maximum suppression and subpixel/scale refinement. */
+    description, /**< Computing the descriptors. */
+    matching, /**< Matching against the tracks or the reference image. */
+    verification, /**< The geometric verification of the matches. */
+    numOfStages
+  };
+
+  /**
+  * Measures the duration of a stage from the construction to the destruction of the object.
+  */
+  class Scope
+  {
+  public:
+    Scope(BriskStageTimes& times, Stage stage);
+    ~Scope();
+
+  private:
+    BriskStageTimes& times;
+    Stage stage;
+    double start; /**< The start time in ms. 0 if the timing is disabled. */
+  };
+
+  BriskStageTimes();
+
+  /**
+  * Starts a new frame.
+  * @param enabled Measure the durations of the stages in this frame?
+  */
+  void beginFrame(bool enabled);
+
+  /** Adds the durations of the current frame to the history and plots the statistics. */
+  void endFrame();
+
+private:
+  enum {historySize = 100};
+
+  bool enabled; /**< Are the durations measured in the current frame? */
+  float current[numOfStages]; /**< The durations of the stages in the current frame in ms. */
+  RingBuffer<float, historySize> history[numOfStages]; /**< The durations of the stages in the last frames in ms. */
+
+  /**
+  * Computes the statistics of the history of a stage.
+  * @param stage The stage.
+  * @param min The shortest duration.
+  * @param mean The average duration.
+  * @param p99 The 99th percentile of the durations.
+  */
+  void getStatistics(Stage stage, float& min, float& mean, float& p99) const;
+};
@@ -7,7 +7,9 @@
 //#include "Tools/ImageProcessing/OSFeatureExtraction.h"
 #include "Tools/ImageProcessing/include/brisk.h"
 #include "Tools/ImageProcessing/include/FeatureExtraction.h"
-#include "Tools/ImageProcessing/include/DataAnalysis.h"
+#include "Tools/ImageProcessing/include/ConstrainedMatcher.h"
+#include "Tools/ImageProcessing/include/RansacVerifier.h"
+#include "Tools/ImageProcessing/include/ReferenceBank.h"
 #include "NaturalLandmarkPerceptorBrisk.h"
 #include "Tools/Debugging/DebugDrawings.h"
 #include "Tools/Streams/InStreams.h"
@@ -15,13 +17,15 @@
 #include "Tools/Range.h"
 #include "Tools/Team.h"
 #include "Tools/Debugging/ReleaseOptions.h"
+#include "Tools/Debugging/ScopeMeter.h"
 #include <algorithm>
 #include <iostream>
 
 #define DEBUG_MODE 0
 
 /** The constructor */
-NaturalLandmarkPerceptorBrisk::NaturalLandmarkPerceptorBrisk()
+NaturalLandmarkPerceptorBrisk::NaturalLandmarkPerceptorBrisk() :
+	lastCameraYaw(0), lastCameraPitch(0)
 {
 
 }
@@ -29,13 +33,34 @@ NaturalLandmarkPerceptorBrisk::NaturalLandmarkPerceptorBrisk()
 /** The function used to extract features and update the landmarks */
 void NaturalLandmarkPerceptorBrisk::update(NaturalLandmarkPerceptBrisk &naturalLandmarkPerceptBrisk)
 {
+	ScopeMeter::Scope meterScope("NaturalLandmarkPerceptorBrisk");
 
-	//The matching score threshold value
-	int matchScoreThreshold = 20;
+	//The minimum number of geometrically verified matches for a match with the reference image
+	int minInliers = 8;
+	//The maximum distance in the 256 selected bits of the reference bank for which the
+	//full descriptor distance is computed
+	int coarseHammingDistance = 52;
+	//The maximum reprojection error of a verified match in pixels
+	float ransacThreshold = 3.0f;
 
 	//Get the vector of matched keypoints
 	naturalLandmarkPerceptBrisk.matchedPoints.clear();
 
+	//The durations of the stages are only measured if requested
+	bool timeStages = false;
+	DEBUG_RESPONSE("module:NaturalLandmarkPerceptorBrisk:stageTimes", timeStages = true;);
+	stageTimes.beginFrame(timeStages);
+
+	//The landmarks are far away, so the image motion since the last frame is dominated by
+	//the change of the camera orientation (odometry rotation plus head yaw, and head pitch).
+	//predictedMotion is in camera image coordinates, i.e. x is the column and y is the row
+	const float cameraYaw = theOdometryData.rotation + theCameraMatrix.rotation.getZAngle();
+	const float cameraPitch = theCameraMatrix.rotation.getYAngle();
+	const Vector2<> predictedMotion(normalize(cameraYaw - lastCameraYaw) * theCameraInfo.focalLength,
+			-(cameraPitch - lastCameraPitch) * theCameraInfo.focalLength);
+	lastCameraYaw = cameraYaw;
+	lastCameraPitch = cameraPitch;
+
 	//*****************************************************************
 	//Set the arguments
 	//std::string feat_detector = "SURF";
@@ -44,15 +69,15 @@ void NaturalLandmarkPerceptorBrisk::update(NaturalLandmarkPerceptBrisk &naturalL
 	std::string feat_detector = "BRISK";
 	int threshold = 100;
 	int hammingDistance = 85;//BRISK BRISK
+	float knnRatio = 0.7f;//Best match must be clearly better than the second best. 0 disables the ratio test
+	bool crossCheck = true;//The reference keypoint must also prefer the keypoint of the current image
+	bool constrainedMatching = true;//false: radius match against all reference keypoints as before
 	double radius = 0.15;//BRISK SURF
 	std::string feat_descriptor = "BRISK";
 
 	//Create the Feature extraction object
 	FeatureExtraction feature;
 
-	//Create data analysis object
-	DataAnalysis dataAnalysis;
-
 	// Declare the extractor. Only needs to be performed once since it computes lookup
 	//tables for each of the various patterns on initialisation
 	//*****************************************************************
@@ -65,6 +90,9 @@ void NaturalLandmarkPerceptorBrisk::update(NaturalLandmarkPerceptBrisk &naturalL
 
 	//Names of the stored image file
 	std::string name1 = "1";
+	//The field position of the landmark shown by image name1 in mm (the center of the opponent goal)
+	const Vector2<> landmarkPosition(3000.f, 0.f);
+	naturalLandmarkPerceptBrisk.landmarkPosition = landmarkPosition;
 
 
 
@@ -117,26 +145,22 @@ void NaturalLandmarkPerceptorBrisk::update(NaturalLandmarkPerceptBrisk &naturalL
 	else
 		criticalPoint = (float)horizon.base.y;
 
-	// if no arguments are passed:
-	//Read in images
-	//*****************************************************************
-	fname1 =dir + "/"+ name1+".jpg";
-	cv::Mat img = cvLoadImage(fname1.c_str(), CV_LOAD_IMAGE_GRAYSCALE);
-	cv::Mat imgGray1 = img(cv::Rect(0, 0, theImage.cameraInfo.resolutionWidth/2, criticalPoint));
-
-	//Create a grayscale image
-	GrayScaleImage grayImage;
-	grayImage.copyChannel(theImage.image, 2);
 	//Create a Mat matrix to store the image data
 	cv::Mat imgGray2(criticalPoint, theImage.cameraInfo.resolutionWidth/2, CV_8UC1);
-
-	for (int rr=0;rr<criticalPoint-1; rr++)
 	{
-		for (int cc=0; cc<(theImage.cameraInfo.resolutionWidth/2)-1;cc++)
+		BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::conversion);
+		//Create a grayscale image
+		GrayScaleImage grayImage;
+		grayImage.copyChannel(theImage.image, 2);
+
+		for (int rr=0;rr<criticalPoint-1; rr++)
 		{
-			//cvmSet(imgGray2, rr,cc,(int)theImage.image[rr][cc].y);
-			//imgGray2.at(rr,cc) =  (int)theImage.image[rr][cc].y;
-			imgGray2.at<uchar>(cc,rr) = theImage.image[rr][cc].y;
+			for (int cc=0; cc<(theImage.cameraInfo.resolutionWidth/2)-1;cc++)
+			{
+				//cvmSet(imgGray2, rr,cc,(int)theImage.image[rr][cc].y);
+				//imgGray2.at(rr,cc) =  (int)theImage.image[rr][cc].y;
+				imgGray2.at<uchar>(cc,rr) = theImage.image[rr][cc].y;
+			}
 		}
 	}
 	//*****************************************************************
@@ -152,7 +176,7 @@ void NaturalLandmarkPerceptorBrisk::update(NaturalLandmarkPerceptBrisk &naturalL
 	//*****************************************************************
 
 	//MC: Generate a vector of keypoints.
-	std::vector<cv::KeyPoint> keypoints, keypoints2;
+	std::vector<cv::KeyPoint> keypoints2;
 
 	//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &detectors);
 	// create the detector:
@@ -161,221 +185,236 @@ void NaturalLandmarkPerceptorBrisk::update(NaturalLandmarkPerceptBrisk &naturalL
 	detector = feature.getDetector(7, feat_detector, detector, threshold, testThreshold,1);
 	//*****************************************************************
 
-	// run the detector:
+	//The reference image is only described once and kept in the compact bank format.
+	//A bank file next to the image is used if it was built from this image with the
+	//parameters used here. Otherwise, the image is described on the first frame. The
+	//bank file is generated offline with the referenceBankBuilder, it is never written here
+	//*****************************************************************
+	if(referenceBank.empty())
+	{
+		fname1 = dir + "/" + name1 + ".jpg";
+		cv::Mat img = cvLoadImage(fname1.c_str(), CV_LOAD_IMAGE_GRAYSCALE);
+		ReferenceBankParameters bankParameters;
+		bankParameters.imageHash = ReferenceBankParameters::hashImage(img);
+		const cv::BriskFeatureDetector* bankDetector = dynamic_cast<const cv::BriskFeatureDetector*>((cv::FeatureDetector*)detector);
+		if(bankDetector)
+		{
+			bankParameters.threshold = bankDetector->threshold;
+			bankParameters.octaves = bankDetector->octaves;
+		}
+		const cv::BriskDescriptorExtractor* bankExtractor = dynamic_cast<const cv::BriskDescriptorExtractor*>((cv::DescriptorExtractor*)descriptorExtractor);
+		if(bankExtractor)
+		{
+			bankParameters.rotationInvariant = bankExtractor->rotationInvariance;
+			bankParameters.scaleInvariant = bankExtractor->scaleInvariance;
+		}
+		const std::string bankName = dir + "/" + name1 + ".bank";
+		if(!referenceBank.load(bankName, bankParameters))
+		{
+			cout<<"The reference bank "<<bankName<<" is missing or stale, describing "<<fname1<<endl;
+			std::vector<cv::KeyPoint> bankKeypoints;
+			cv::Mat bankDescriptors;
+			detector->detect(img,bankKeypoints);
+			descriptorExtractor->compute(img,bankKeypoints,bankDescriptors);
+			referenceBank.build(bankKeypoints, bankDescriptors, bankParameters);
+		}
+		referenceBank.getKeypoints(referenceKeypoints);
+		referenceDescriptors = referenceBank.getDescriptors();
+	}
+	//*****************************************************************
+
+	// run the detector on the current image:
 	//*****************************************************************
-	detector->detect(imgGray1,keypoints);
-	detector->detect(imgGray2,keypoints2);
+	//The BRISK detector is run step by step, so the steps can be timed separately
+	const cv::BriskFeatureDetector* briskDetector = dynamic_cast<const cv::BriskFeatureDetector*>((cv::FeatureDetector*)detector);
+	if(briskDetector)
+	{
+		cv::BriskScaleSpace scaleSpace(briskDetector->octaves);
+		std::vector<std::vector<CvPoint> > agastPoints;
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::pyramid);
+			scaleSpace.constructPyramid(imgGray2);
+		}
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::agast);
+			scaleSpace.getAgastPoints(briskDetector->threshold, agastPoints);
+		}
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::refinement);
+			scaleSpace.getKeypoints(agastPoints, keypoints2);
+		}
+	}
+	else
+		detector->detect(imgGray2,keypoints2);
 	//*****************************************************************
 	//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &detectore);
 	//double detectionTime = diff(detectors,detectore).tv_nsec/1000000;
 
+	cv::Mat descriptors2;
+	std::vector<std::vector<cv::DMatch> > matches;
+	RansacVerifier verifier(RansacVerifier::AFFINE, ransacThreshold);
+	int numInliers = 0;
+
+	//The reference side of the matches. When tracking, these are the tracks of the last frame
+	const std::vector<cv::KeyPoint>* trainKeypoints = &referenceKeypoints;
+	const cv::Mat* trainDescriptors = &referenceDescriptors;
+
+	//Tracking: only describe the keypoints around the predicted positions of the
+	//matches of the last frame and only match them against these tracks
+	//*****************************************************************
+	bool tracked = false;
+	if(hamming && tracker.isTracking())
+	{
+		//imgGray2 is filled transposed, so the x coordinate of a keypoint is the camera row
+		tracker.predict(predictedMotion.y, predictedMotion.x);
+		std::vector<cv::KeyPoint> windowKeypoints(keypoints2);
+		tracker.selectKeypoints(windowKeypoints);
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::description);
+			descriptorExtractor->compute(imgGray2,windowKeypoints,descriptors2);
+		}
+		bool trackMatched;
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::matching);
+			trackMatched = tracker.match(descriptors2,windowKeypoints,hammingDistance,matches);
+		}
+		if(trackMatched)
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::verification);
+			numInliers = verifier.verify(windowKeypoints, tracker.referenceKeypoints, matches);
+			tracked = numInliers>=minInliers;
+		}
+		if(tracked)
+		{
+			keypoints2.swap(windowKeypoints);
+			trainKeypoints = &tracker.referenceKeypoints;
+			trainDescriptors = &tracker.referenceDescriptors;
+		}
+	}
 	//*****************************************************************
-	// get the descriptors
-	cv::Mat descriptors, descriptors2;
-	std::vector<cv::DMatch> indices;
 
-	//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &extractors);
-	// first image. Computes the descriptor for each of the keypoints.
-	//Outputs a 64 bit vector describing the keypoints.
-	descriptorExtractor->compute(imgGray2,keypoints2,descriptors2);
-	// and the second one
-	descriptorExtractor->compute(imgGray1,keypoints,descriptors);
+	//Full matching: the tracking quality was too low, so match the whole frame
+	//against the reference image
+	if(!tracked)
+	{
+		//*****************************************************************
+		// get the descriptors
+		//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &extractors);
+		// Computes the descriptor for each of the keypoints.
+		//Outputs a 64 bit vector describing the keypoints.
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::description);
+			descriptorExtractor->compute(imgGray2,keypoints2,descriptors2);
+		}
 
-	//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &extractore);
-	//double extractionTime = diff(extractors,extractore).tv_nsec/1000000;
+		//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &extractore);
+		//double extractionTime = diff(extractors,extractore).tv_nsec/1000000;
 
-	//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &matchings);
+		//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &matchings);
 
-	// matching
-	//*****************************************************************
-	std::vector<std::vector<cv::DMatch> > matches;
-	cv::Ptr<cv::DescriptorMatcher> descriptorMatcher;
-	if(hamming)
-		descriptorMatcher = new cv::BruteForceMatcher<cv::HammingSse>();
-	else
-		descriptorMatcher = new cv::BruteForceMatcher<cv::L2<float> >();
-	if(hamming)
-		descriptorMatcher->radiusMatch(descriptors2,descriptors,matches,hammingDistance);
-	else{
-		//Messing with the maxdistance value will drastically reduce the number of matches.
-		descriptorMatcher->radiusMatch(descriptors2,descriptors,matches,radius);
-		//descriptorMatcher->knnMatch(descriptors2,descriptors,matches,3);
-	}
-	//For the above method, we could use KnnMatch. All values less than 0.21 max distance are selected
+		// matching
+		//*****************************************************************
+		{
+			BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::matching);
+			if(hamming && constrainedMatching){
+				//The ratio test and the cross check (if enabled) are applied while matching, so only
+				//unambiguous matches reach the verification step. Reference keypoints outside
+				//the angle/offset window checked by FeatureExtraction::verifyMatch are never compared.
+				//The full distance is only computed for pairs that are close in the selected bits.
+				ConstrainedMatcher matcher(hammingDistance, knnRatio, crossCheck);
+				if(referenceBank.hasSelection())
+					matcher.setCoarseStage(&referenceBank, coarseHammingDistance);
+				matcher.match(descriptors2,keypoints2,referenceDescriptors,referenceKeypoints,GeometricPrior(imgGray2.cols),matches);
+			}
+			else if(hamming){
+				//All reference keypoints within the distance are candidates, the verification
+				//has to sort them out
+				cv::Ptr<cv::DescriptorMatcher> descriptorMatcher = new cv::BruteForceMatcher<cv::HammingSse>();
+				descriptorMatcher->radiusMatch(descriptors2,referenceDescriptors,matches,hammingDistance);
+			}
+			else{
+				cv::Ptr<cv::DescriptorMatcher> descriptorMatcher = new cv::BruteForceMatcher<cv::L2<float> >();
+				//Messing with the maxdistance value will drastically reduce the number of matches.
+				descriptorMatcher->radiusMatch(descriptors2,referenceDescriptors,matches,radius);
+				//descriptorMatcher->knnMatch(descriptors2,descriptors,matches,3);
+			}
+		}
+		//For the above method, we could use KnnMatch. All values less than 0.21 max distance are selected
 
-	//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &matchinge);
-	//double matchingTime = diff(matchings,matchinge).tv_nsec/1000;
-	//*****************************************************************
+		//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &matchinge);
+		//double matchingTime = diff(matchings,matchinge).tv_nsec/1000;
+		//*****************************************************************
 
+		//Verify that the matches are consistent with a single transformation between the
+		//two images
+		BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::verification);
+		numInliers = verifier.verify(keypoints2, referenceKeypoints, matches);
+	}
 
 	//clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &te);
 	//double overallTime = diff(ts,te).tv_nsec/1000000;
 
-	//Verify that the matches are indeed correct. If they are not, discard them
-	//from the matches
-	verifyMatches(&imgGray1, keypoints, keypoints2, matches, feature, dataAnalysis);
+	//Matches that do not fit the best transformation are discarded
+	{
+		BriskStageTimes::Scope scope(stageTimes, BriskStageTimes::verification);
+		verifier.removeOutliers(matches);
+	}
+
+	//The verified matches are tracked in the next frame
+	if(hamming)
+		tracker.update(keypoints2, *trainKeypoints, *trainDescriptors, matches);
 
 	//Create a matchedKeypoint
 	NaturalLandmarkPerceptBrisk::MatchedKeypointBrisk mk;
 
-	//Create a matching score variable
-	float matchingScore = 0;
-
 	//Update the keypoints variable. Note keypoints refers to the current image
-	for (size_t ii = 1;ii<=matches.size();ii++)
+	for (size_t ii = 0;ii<matches.size();ii++)
 	{
+		//All candidates of this keypoint may have been rejected by the verification
+		if(matches[ii].empty())
+			continue;
 		//Corresponds to the current image.
 		int i1 = matches[ii][0].trainIdx;
 		//Store the match that we desire in the matched keypoint
-		mk.keypoint = keypoints[i1];
+		mk.keypoint = (*trainKeypoints)[i1];
 		//Add this to the matched keypoint vector
 		naturalLandmarkPerceptBrisk.matchedPoints.push_back(mk);
-
-		//Calculate the matching score to determine if there is a match
-		matchingScore = matchingScore + 1/matches[ii][0].distance;
 	}
-	//Add the matching score to the natural landmark percept. This will be used to determine
-	//if the images sufficiently match
-	naturalLandmarkPerceptBrisk.matchingScore = matchingScore;
+	//The number of geometrically verified matches is the matching score. This will be used
+	//to determine if the images sufficiently match
+	naturalLandmarkPerceptBrisk.matchingScore = (float)numInliers;
 
 	//Check whether or not a match has occurred
-	if(matchingScore>matchScoreThreshold)
+	if(numInliers>=minInliers)
 		naturalLandmarkPerceptBrisk.matchFound = true;
 	else
 		naturalLandmarkPerceptBrisk.matchFound = false;
 
-}
-
-void NaturalLandmarkPerceptorBrisk::verifyMatches(cv::Mat *imgGray1, vector<cv::KeyPoint> &keypoints, vector<cv::KeyPoint> &keypoints2,	std::vector<std::vector<cv::DMatch> > &matches, FeatureExtraction &feature, DataAnalysis &dataAnalysis){
-
-	// Variables for matching statistics
-	float imageMatchingScore = 0;
-	float imageMatchingScoreBest = 0;
-	int totalNumMatches = 0;
-	int totalNumValidMatches = 0;
-	int totalNumInvalidMatches = 0;
-	int totalNumBestMatches = 0;
-
-	//To store the incorrect matches
-#if(DEBUG_MODE)
-	std::vector<cv::Point2f> leftPoints;
-	std::vector<cv::Point2f> rightPoints;
-#endif
-
-#if (DEBUG_MODE)
-	cout<<"The total number of keypoints in image 1 is: "<<keypoints.size()<<endl;
-	cout<<"The total number of keypoints in image 2 is: "<<keypoints2.size()<<endl;
-#endif
-
-	for( size_t i = 0; i < matches.size(); i++ )
+	//The bearing of the landmark is the direction of the center of the matched keypoints
+	//of the current image, rotated from camera to robot coordinates. imgGray2 is filled
+	//transposed, i.e. the x coordinate of a keypoint is the row in the camera image and
+	//its y coordinate is the column. The columns are not scaled.
+	if(naturalLandmarkPerceptBrisk.matchFound)
 	{
-
-		if (matches[i].size()>0){
-#if (DEBUG_MODE)
-			cout<<"The number of matches is : "<<matches[i].size()<<endl;
-			cout<<"****************************************"<<endl;
-#endif
-		}
-
-		int allMatches = matches[i].size();
-		int counter = 0;
-		int matchSize = matches[i].size();
-		bool isTrueMatchFound = false;
-
-		//for(size_t j = 0; j < matches[i].size(); j++)
-		while(counter<matchSize)
-		{
-
-
-			//Corresponds to the first image
-			int i1 = matches[i][counter].trainIdx;
-			//Corresponds to the second image
-			int i2 = matches[i][counter].queryIdx;
-			//Determine the distance between matches
-			float distanceMatch = matches[i][counter].distance;
-
-			//Give a constant reward for being under a certain threshold
-			float matchingScore = 0;
-			if (distanceMatch==0)
-				matchingScore=100;
-			else
-				matchingScore = 1/distanceMatch;
-
-#if (DEBUG_MODE)
-			cout<<"Keypoint indices i1, i2: "<<i1<<", "<<i2<<endl;
-			cout<<"****************************"<<endl;
-			cout<<"Keypoint Left  row,col : "<<(*(keypoints2.begin()+i2)).pt.y<<", "<<(*(keypoints2.begin()+i2)).pt.x<<endl;
-			cout<<"Keypoint Right row,col : "<<(*(keypoints.begin() + i1)).pt.y<<", "<<(*(keypoints.begin() + i1)).pt.x<<endl;
-			cout<<"****************************"<<endl;
-#endif
-
-#if (DEBUG_MODE)
-			//dataAnalysis.displayOutput(keypoints2, keypoints, matchingScore, i1, i2);
-#endif
-
-			//Verify whether the match is correct or not
-			//****************************************************
-			bool correctMatch = feature.verifyMatch(*imgGray1, keypoints2[i2], keypoints[i1]);
-#if (DEBUG_MODE)
-			cout<<"CorrectMatch: "<<correctMatch<<endl;
-#endif
-			//****************************************************
-			//If the match is incorrect, remove the invalid match
-			if (correctMatch==false)
+		Vector2<> center;
+		int numberOfMatches = 0;
+		for(size_t ii = 0; ii < matches.size(); ++ii)
+			if(!matches[ii].empty())
 			{
-#if (DEBUG_MODE)
-				cout<<"Entered Here"<<endl;
-				cout<<"Keypoint Left to be erased row,col : "<<(*(keypoints2.begin()+i2)).pt.y<<", "<<(*(keypoints2.begin()+i2)).pt.x<<endl;
-				cout<<"Keypoint Right to be erased row,col : "<<(*(keypoints.begin() + i1)).pt.y<<", "<<(*(keypoints.begin() + i1)).pt.x<<endl;
-#endif
-
-#if(DEBUG_MODE)
-				cout<<"The number of matches before removal is : "<<matches[i].size()<<endl;
-				cout<<"-----------------------------------------"<<endl;
-#endif
-				//Erase the corresponding match
-				matches[i].erase(matches[i].begin()+counter);
-
-				matchSize = matches[i].size();
-#if (DEBUG_MODE)
-				cout<<"The number of matches after removal is : "<<matchSize<<endl;
-				cout<<"counter is : "<<counter<<endl;
-				cout<<"----------------------------------------"<<endl;
-#endif
-
-				totalNumInvalidMatches = totalNumInvalidMatches + 1;
-#if (DEBUG_MODE)
-				leftPoints.push_back(keypoints2[i2].pt);
-				rightPoints.push_back(keypoints[i1].pt);
-#endif
+				const cv::KeyPoint& keypoint = keypoints2[matches[ii][0].queryIdx];
+				center += Vector2<>(keypoint.pt.y, keypoint.pt.x);
+				++numberOfMatches;
 			}
-			else
-			{
-				isTrueMatchFound = true;
-				counter++;
-			}
-			//cv::waitKey(500);
-
-			if(matches[i].size()==0)
-				break;
-
-
-
-			//This only considers the best correct match.
-			if(isTrueMatchFound && counter ==1){
-				totalNumBestMatches = totalNumBestMatches + 1;
-				imageMatchingScoreBest = imageMatchingScoreBest + matchingScore;
-				isTrueMatchFound = false;
-			}
-
-			imageMatchingScore = imageMatchingScore + matchingScore;
-
+		if(numberOfMatches)
+		{
+			center /= (float)numberOfMatches;
+			const Vector3<> direction = theCameraMatrix.rotation * Vector3<>(theCameraInfo.focalLength,
+					theCameraInfo.opticalCenter.x - center.x, theCameraInfo.opticalCenter.y - center.y);
+			naturalLandmarkPerceptBrisk.bearing = atan2(direction.y, direction.x);
 		}
-		totalNumValidMatches = totalNumValidMatches + matches[i].size();
-		totalNumMatches = totalNumMatches + allMatches;
 	}
 
+	stageTimes.endFrame();
 }
 
-
 MAKE_MODULE(NaturalLandmarkPerceptorBrisk, Perception)
@@ -16,6 +16,10 @@
 #include "Representations/Infrastructure/CameraInfo.h"
 #include "Representations/Infrastructure/FrameInfo.h"
 #include "Representations/Infrastructure/TeamInfo.h"
+#include "Representations/MotionControl/OdometryData.h"
+#include "Tools/ImageProcessing/include/KeypointTracker.h"
+#include "Tools/ImageProcessing/include/ReferenceBank.h"
+#include "BriskStageTimes.h"
 #include "Storage.h"
 #include "Tools/Debugging/DebugImages.h"
 
@@ -26,6 +30,7 @@ MODULE(NaturalLandmarkPerceptorBrisk)
   REQUIRES(Image)
   REQUIRES(ColorTable64)
   REQUIRES(FrameInfo)
+  REQUIRES(OdometryData)
   PROVIDES_WITH_MODIFY(NaturalLandmarkPerceptBrisk)
 END_MODULE
 
@@ -59,13 +64,25 @@ void update (NaturalLandmarkPerceptBrisk &naturalLandmarkPerceptBrisk);
 ///** Declare a reference to the image provided by the Nao */
 //const Image* theImage;
 
+/** The keypoints and descriptors of the reference image, built on the first frame */
+ReferenceBank referenceBank;
+std::vector<cv::KeyPoint> referenceKeypoints;
+cv::Mat referenceDescriptors;
+
+/** Tracks the verified matches from frame to frame */
+KeypointTracker tracker;
+
+/** The camera orientation in the last frame, used to predict the motion of the tracks */
+float lastCameraYaw;
+float lastCameraPitch;
+
+/** The durations of the stages, measured if module:NaturalLandmarkPerceptorBrisk:stageTimes is requested */
+BriskStageTimes stageTimes;
+
 public:
 /** The constructor */
 NaturalLandmarkPerceptorBrisk();
 
-/** This function verifies whether or not there was a correct match */
-void verifyMatches(cv::Mat  *imgGray1, vector<cv::KeyPoint> &keypoints, vector<cv::KeyPoint> &keypoints2,	std::vector<std::vector<cv::DMatch> > &matches, FeatureExtraction &feature, DataAnalysis &dataAnalysis);
-
 };
 
 
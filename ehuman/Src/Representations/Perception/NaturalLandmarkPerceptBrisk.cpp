@@ -13,6 +13,8 @@ void NaturalLandmarkPerceptBrisk::serialize(In *in, Out *out)
   STREAM(matchedPoints);
   STREAM(matchingScore);
   STREAM(matchFound);
+  STREAM(bearing);
+  STREAM(landmarkPosition);
   STREAM_REGISTER_FINISH();
 
 }
@@ -55,13 +55,17 @@ MatchedKeypointBrisk() {}
 
 /**Store a vector of perceived keypoints here */
 vector <MatchedKeypointBrisk> matchedPoints;
-/**Store the matching score of the image with the test bank image */
+/**Store the matching score of the image with the test bank image (the number of geometrically verified matches) */
 float matchingScore;
 /**Store whether or not a match has been found */
 bool matchFound;
+/**The direction to the center of the matched keypoints relative to the robot in radians. Only valid if matchFound is set */
+float bearing;
+/**The field position of the landmark shown by the reference image in mm */
+Vector2<> landmarkPosition;
 
 /** The constructor */
-NaturalLandmarkPerceptBrisk(): matchingScore(0), matchFound(false) {}
+NaturalLandmarkPerceptBrisk(): matchingScore(0), matchFound(false), bearing(0) {}
 
 };
 
@@ -0,0 +1,50 @@
+/**
+* @file BenchmarkSupport.h
+* Declares the functions shared by the timers of the perception and localization
+* modules and by the standalone tools in Src/Utils, i.e. a precise clock and the
+* listing of image directories. They do not depend on the framework.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <time.h>
+
+namespace BenchmarkSupport
+{
+  /** The current time of the monotonic clock in ms. */
+  inline double now()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+  }
+
+  /**
+  * Lists the images of a directory.
+  * @param directory The directory.
+  * @param names The names of all .jpg, .jpeg and .png files in alphabetical order.
+  * @return Could the directory be opened?
+  */
+  inline bool listImages(const std::string& directory, std::vector<std::string>& names)
+  {
+    names.clear();
+    DIR* dir = opendir(directory.c_str());
+    if(!dir)
+      return false;
+    for(dirent* entry = readdir(dir); entry; entry = readdir(dir))
+    {
+      const std::string name = entry->d_name;
+      const size_t dot = name.rfind('.');
+      const std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+      if(extension == ".jpg" || extension == ".jpeg" || extension == ".png")
+        names.push_back(name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return true;
+  }
+}
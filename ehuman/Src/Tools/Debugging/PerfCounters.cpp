@@ -0,0 +1,145 @@
+/**
+* @file PerfCounters.cpp
+* Implements a class that reads the hardware performance counters around named scopes.
+*/
+
+#include "PerfCounters.h"
+#include <cstring>
+// The robot code is built against the headers of the Nao toolchain and never reads
+// the counters, so only the tools open them. perf_event.h exists since Linux 2.6.31.
+#if defined(LINUX) && !defined(TARGET_ROBOT)
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 31)
+#define PERF_EVENTS_AVAILABLE
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+__thread PerfCounters* PerfCounters::theInstance = 0;
+
+PerfCounters::Scope::Scope(const char* name) :
+  index(theInstance ? theInstance->getIndex(name) : -1)
+{
+  if(index >= 0)
+    theInstance->read(start);
+}
+
+PerfCounters::Scope::~Scope()
+{
+  if(index >= 0 && theInstance)
+  {
+    long long end[numOfEvents];
+    theInstance->read(end);
+    Entry& entry = theInstance->entries[index];
+    ++entry.calls;
+    for(int i = 0; i < numOfEvents; ++i)
+      entry.deltas[i] += end[i] - start[i];
+  }
+}
+
+PerfCounters::PerfCounters() : numberOfScopes(0), leader(-1)
+{
+#if defined(PERF_EVENTS_AVAILABLE) && defined(__NR_perf_event_open)
+  int numberOfOpenEvents = 0;
+#endif
+  for(int i = 0; i < numOfEvents; ++i)
+  {
+    fds[i] = -1;
+    positions[i] = -1;
+#if defined(PERF_EVENTS_AVAILABLE) && defined(__NR_perf_event_open)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch(i)
+    {
+    case cycles:
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case instructions:
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case l1dMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+      break;
+    case llcMisses:
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case branchMisses:
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    }
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the counters of the calling thread on any cpu
+    fds[i] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+    if(fds[i] >= 0)
+    {
+      if(leader < 0)
+        leader = fds[i];
+      positions[i] = numberOfOpenEvents++;
+    }
+#endif
+  }
+  theInstance = this;
+}
+
+PerfCounters::~PerfCounters()
+{
+  if(theInstance == this)
+    theInstance = 0;
+#ifdef PERF_EVENTS_AVAILABLE
+  for(int i = 0; i < numOfEvents; ++i)
+    if(fds[i] >= 0 && fds[i] != leader)
+      close(fds[i]);
+  if(leader >= 0)
+    close(leader);
+#endif
+}
+
+void PerfCounters::beginFrame()
+{
+  for(int i = 0; i < numberOfScopes; ++i)
+  {
+    entries[i].calls = 0;
+    for(int j = 0; j < numOfEvents; ++j)
+      entries[i].deltas[j] = 0;
+  }
+}
+
+const char* PerfCounters::getEventName(Event event)
+{
+  static const char* names[numOfEvents] = {"cycles", "instructions", "l1dMisses", "llcMisses", "branchMisses"};
+  return names[event];
+}
+
+int PerfCounters::getIndex(const char* name)
+{
+  for(int i = 0; i < numberOfScopes; ++i)
+    if(entries[i].name == name || !strcmp(entries[i].name, name))
+      return i;
+  if(numberOfScopes == maxNumberOfScopes)
+    return -1;
+  Entry& entry = entries[numberOfScopes];
+  entry.name = name;
+  entry.calls = 0;
+  for(int j = 0; j < numOfEvents; ++j)
+    entry.deltas[j] = 0;
+  return numberOfScopes++;
+}
+
+void PerfCounters::read(long long values[numOfEvents]) const
+{
+  // the number of events, followed by their values
+  unsigned long long group[numOfEvents + 1] = {0};
+#ifdef PERF_EVENTS_AVAILABLE
+  if(leader >= 0 && ::read(leader, group, sizeof(group)) <= 0)
+    group[0] = 0;
+#endif
+  for(int i = 0; i < numOfEvents; ++i)
+    values[i] = positions[i] >= 0 && positions[i] < (int) group[0] ? (long long) group[positions[i] + 1] : 0;
+}
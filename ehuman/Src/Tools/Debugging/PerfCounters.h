@@ -0,0 +1,104 @@
+/**
+* @file PerfCounters.h
+* Declares a class that reads the hardware performance counters of the CPU (cycles,
+* instructions, cache and branch misses) around named scopes, e.g. the stages of the
+* BRISK detector or the update of the self-locator. The counters are only read in
+* threads that instantiated a PerfCounters object, e.g. in benchmarks and tools that
+* replay logs. The class does not depend on the framework, so it can also be used
+* from the standalone tools of Tools/ImageProcessing.
+*/
+
+#pragma once
+
+/**
+* @class PerfCounters
+* The counters are opened with perf_event_open as one group for the calling thread and
+* only count in user space. The counter deltas of all scopes with the same name are
+* summed up per frame. While no PerfCounters object exists in the current thread, a
+* Scope costs a single comparison. Events the CPU or the kernel do not support are
+* not available, e.g. in virtual machines or if /proc/sys/kernel/perf_event_paranoid
+* does not allow user space measurements. In the robot code (TARGET_ROBOT), no events
+* are available and the scopes only cost the comparison.
+*/
+class PerfCounters
+{
+public:
+  enum Event
+  {
+    cycles,
+    instructions,
+    l1dMisses, /**< Level 1 data cache read misses. */
+    llcMisses, /**< Last level cache misses. */
+    branchMisses,
+    numOfEvents
+  };
+
+  /**
+  * Reads the counters at the construction and the destruction of the object.
+  */
+  class Scope
+  {
+  public:
+    /**
+    * @param name The name of the scope. Must be a string literal, because only the
+    *             pointer is stored.
+    */
+    Scope(const char* name);
+    ~Scope();
+
+  private:
+    int index; /**< The index of the scope. -1 if nothing is measured. */
+    long long start[numOfEvents]; /**< The counters at the start. */
+  };
+
+  /** Opens the counters and installs them as the counters of the current thread. */
+  PerfCounters();
+
+  /** Closes the counters and uninstalls them. */
+  ~PerfCounters();
+
+  /** Is an event counted? */
+  bool isAvailable(Event event) const {return positions[event] >= 0;}
+
+  /** Starts a new frame, i.e. resets the deltas of all scopes. */
+  void beginFrame();
+
+  int getNumberOfScopes() const {return numberOfScopes;}
+  const char* getName(int index) const {return entries[index].name;}
+
+  /** How often a scope was entered in the current frame. */
+  unsigned getCalls(int index) const {return entries[index].calls;}
+
+  /** The delta of a counter in a scope in the current frame. 0 if the event is not available. */
+  long long getDelta(int index, Event event) const {return entries[index].deltas[event];}
+
+  static const char* getEventName(Event event);
+
+private:
+  enum {maxNumberOfScopes = 32};
+
+  /** A named scope. */
+  struct Entry
+  {
+    const char* name;
+    unsigned calls;
+    long long deltas[numOfEvents];
+  };
+
+  Entry entries[maxNumberOfScopes];
+  int numberOfScopes;
+  int leader; /**< The file descriptor of the group. -1 if no event is available. */
+  int fds[numOfEvents]; /**< The file descriptors of the events. -1 if not available. */
+  int positions[numOfEvents]; /**< The positions of the events in the group. -1 if not available. */
+
+  static __thread PerfCounters* theInstance; /**< The counters of the current thread. 0 if there are none. */
+
+  /**
+  * Returns the index of a scope. Unknown names are added.
+  * @return The index or -1 if there are too many scopes.
+  */
+  int getIndex(const char* name);
+
+  /** Reads all counters. Events that are not available are 0. */
+  void read(long long values[numOfEvents]) const;
+};
@@ -0,0 +1,63 @@
+/**
+* @file ScopeMeter.cpp
+* Implements a class that measures how long named scopes take per frame.
+*/
+
+#include "ScopeMeter.h"
+#include "BenchmarkSupport.h"
+#include <cstring>
+
+PROCESS_WIDE_STORAGE(ScopeMeter) ScopeMeter::theInstance = 0;
+unsigned ScopeMeter::totalAllocations = 0;
+size_t ScopeMeter::totalAllocatedBytes = 0;
+
+ScopeMeter::Scope::Scope(const char* name) :
+  index(theInstance ? theInstance->getIndex(name) : -1), start(index >= 0 ? BenchmarkSupport::now() : 0),
+  startAllocations(totalAllocations), startBytes(totalAllocatedBytes)
+{}
+
+ScopeMeter::Scope::~Scope()
+{
+  if(index >= 0 && theInstance)
+  {
+    Entry& entry = theInstance->entries[index];
+    entry.duration += BenchmarkSupport::now() - start;
+    entry.allocations += totalAllocations - startAllocations;
+    entry.allocatedBytes += totalAllocatedBytes - startBytes;
+  }
+}
+
+ScopeMeter::ScopeMeter() : numberOfScopes(0)
+{
+  theInstance = this;
+}
+
+ScopeMeter::~ScopeMeter()
+{
+  if(theInstance == this)
+    theInstance = 0;
+}
+
+void ScopeMeter::beginFrame()
+{
+  for(int i = 0; i < numberOfScopes; ++i)
+  {
+    entries[i].duration = 0;
+    entries[i].allocations = 0;
+    entries[i].allocatedBytes = 0;
+  }
+}
+
+int ScopeMeter::getIndex(const char* name)
+{
+  for(int i = 0; i < numberOfScopes; ++i)
+    if(entries[i].name == name || !strcmp(entries[i].name, name))
+      return i;
+  if(numberOfScopes == maxNumberOfScopes)
+    return -1;
+  entries[numberOfScopes].name = name;
+  entries[numberOfScopes].duration = 0;
+  entries[numberOfScopes].allocations = 0;
+  entries[numberOfScopes].allocatedBytes = 0;
+  return numberOfScopes++;
+}
@@ -0,0 +1,106 @@
+/**
+* @file ScopeMeter.h
+* Declares a class that measures how long named scopes (e.g. the update functions of
+* modules) take and how much they allocate per frame. The measurements are only taken
+* in processes that instantiated a meter, e.g. in tools that replay logs.
+*/
+
+#pragma once
+
+#include "Platform/SystemCall.h"
+#include <cstddef>
+
+/**
+* @class ScopeMeter
+* The durations of all scopes with the same name are summed up per frame.
+* While no meter exists in the current process, a Scope costs a single comparison.
+* Allocations are only counted if the program links an allocation hook that calls
+* countAllocation() (see Utils/LogReplay/AllocationHook.cpp). They include the
+* allocations of nested scopes.
+*/
+class ScopeMeter
+{
+public:
+  /**
+  * Measures the duration from the construction to the destruction of the object.
+  */
+  class Scope
+  {
+  public:
+    /**
+    * @param name The name of the scope. Must be a string literal, because only the
+    *             pointer is stored.
+    */
+    Scope(const char* name);
+    ~Scope();
+
+  private:
+    int index; /**< The index of the scope in the meter. -1 if nothing is measured. */
+    double start; /**< The start time in ms. */
+    unsigned startAllocations; /**< The number of allocations at the start. */
+    size_t startBytes; /**< The number of bytes allocated at the start. */
+  };
+
+  /** Installs the meter as the meter of the current process. */
+  ScopeMeter();
+
+  /** Uninstalls the meter. */
+  ~ScopeMeter();
+
+  /** Starts a new frame, i.e. resets the durations of all scopes. */
+  void beginFrame();
+
+  int getNumberOfScopes() const {return numberOfScopes;}
+  const char* getName(int index) const {return entries[index].name;}
+
+  /** The duration of a scope in the current frame in ms. */
+  double getDuration(int index) const {return entries[index].duration;}
+
+  /** The number of allocations of a scope in the current frame. */
+  unsigned getAllocations(int index) const {return entries[index].allocations;}
+
+  /** The number of bytes allocated by a scope in the current frame. */
+  size_t getAllocatedBytes(int index) const {return entries[index].allocatedBytes;}
+
+  /** The number of allocations since the start of the program. */
+  static unsigned getTotalAllocations() {return totalAllocations;}
+
+  /** The number of bytes allocated since the start of the program. */
+  static size_t getTotalAllocatedBytes() {return totalAllocatedBytes;}
+
+  /**
+  * Counts an allocation. Called by an allocation hook for every allocation of the
+  * program. The counters are not synchronized, so the hook may only be linked into
+  * single-threaded programs.
+  */
+  static void countAllocation(size_t size)
+  {
+    ++totalAllocations;
+    totalAllocatedBytes += size;
+  }
+
+private:
+  enum {maxNumberOfScopes = 32};
+
+  /** A named scope. */
+  struct Entry
+  {
+    const char* name;
+    double duration; /**< The duration in the current frame in ms. */
+    unsigned allocations; /**< The number of allocations in the current frame. */
+    size_t allocatedBytes; /**< The number of bytes allocated in the current frame. */
+  };
+
+  Entry entries[maxNumberOfScopes];
+  int numberOfScopes;
+
+  PROCESS_WIDE_STORAGE_STATIC(ScopeMeter) theInstance; /**< The meter of the current process. 0 if there is none. */
+  static unsigned totalAllocations;
+  static size_t totalAllocatedBytes;
+
+  /**
+  * Returns the index of a scope. Unknown names are added.
+  * @return The index or -1 if there are too many scopes.
+  */
+  int getIndex(const char* name);
+};
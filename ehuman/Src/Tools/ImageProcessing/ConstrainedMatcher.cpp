@@ -0,0 +1,232 @@
+#include "include/ConstrainedMatcher.h"
+#include <algorithm>
+#include <limits.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define PI 3.14159265
+
+ConstrainedMatcher::ConstrainedMatcher(int maxDistance, float ratio, bool crossCheck, int bucketSize) :
+	maxDistance(maxDistance), ratio(ratio), crossCheck(crossCheck), bucketSize(bucketSize),
+	numComparisons(0), numCoarseComparisons(0), gridCols(0), gridRows(0),
+	coarseBank(0), coarseMaxDistance(0), queryCompact(0)
+{
+	//ctor
+}
+
+ConstrainedMatcher::~ConstrainedMatcher()
+{
+	//dtor
+}
+
+void ConstrainedMatcher::setCoarseStage(const ReferenceBank *bank, int coarseMaxDistance)
+{
+	coarseBank = bank;
+	this->coarseMaxDistance = coarseMaxDistance;
+}
+
+void ConstrainedMatcher::prepareCoarseStage(const cv::Mat &queryDescriptors, int numTrain)
+{
+	numCoarseComparisons = 0;
+	if(!coarseBank)
+		return;
+	CV_Assert(coarseBank->hasSelection() && coarseBank->size()==numTrain);
+	//The compact rows are 32 bytes, so they stay 16 byte aligned for the SSE distance
+	queryCompact = alignedBuffer(queryCompactStorage, queryDescriptors.rows*ReferenceBank::COMPACT_SIZE);
+	for(int q=0; q<queryDescriptors.rows; q++)
+		coarseBank->compact(queryDescriptors.data + queryDescriptors.step*q, queryCompact + q*ReferenceBank::COMPACT_SIZE);
+}
+
+inline bool ConstrainedMatcher::passesCoarseStage(int q, int t)
+{
+	if(!coarseBank)
+		return true;
+	numCoarseComparisons++;
+	return hamming(queryCompact + q*ReferenceBank::COMPACT_SIZE, coarseBank->compactDescriptor(t), ReferenceBank::COMPACT_SIZE)<=coarseMaxDistance;
+}
+
+void ConstrainedMatcher::prepare(int numQuery, int numTrain)
+{
+	numComparisons = 0;
+	bestTrain.assign(numQuery, -1);
+	bestTrainDistance.assign(numQuery, INT_MAX);
+	secondTrainDistance.assign(numQuery, INT_MAX);
+	if(crossCheck){
+		bestQuery.assign(numTrain, -1);
+		bestQueryDistance.assign(numTrain, INT_MAX);
+	}
+}
+
+inline void ConstrainedMatcher::accumulate(int q, int t, int d, std::vector<cv::DMatch> &candidates)
+{
+	//Without a ratio test or cross check, this is a plain radius match
+	if(ratio<=0 && !crossCheck){
+		if(d<maxDistance)
+			candidates.push_back(cv::DMatch(q, t, 0, (float)d));
+		return;
+	}
+	if(d<bestTrainDistance[q]){
+		secondTrainDistance[q] = bestTrainDistance[q];
+		bestTrainDistance[q] = d;
+		bestTrain[q] = t;
+	}
+	else if(d<secondTrainDistance[q])
+		secondTrainDistance[q] = d;
+	if(crossCheck && d<bestQueryDistance[t]){
+		bestQueryDistance[t] = d;
+		bestQuery[t] = q;
+	}
+}
+
+void ConstrainedMatcher::emit(int numQuery, std::vector<std::vector<cv::DMatch> > &matches)
+{
+	//Emit only the matches that satisfy every enabled constraint
+	for(int q=0; q<numQuery; q++){
+		const int t = bestTrain[q];
+		const int d = bestTrainDistance[q];
+		if(t<0 || d>=maxDistance)
+			continue;
+		//If the ratio is greater than the threshold, the second match is too close
+		//and the match is probably noise. A single candidate always passes.
+		if(ratio>0 && secondTrainDistance[q]!=INT_MAX && float(d) > ratio*float(secondTrainDistance[q]))
+			continue;
+		if(crossCheck && bestQuery[t]!=q)
+			continue;
+		matches.push_back(std::vector<cv::DMatch>(1, cv::DMatch(q, t, 0, (float)d)));
+	}
+}
+
+void ConstrainedMatcher::match(const cv::Mat &queryDescriptors, const cv::Mat &trainDescriptors, std::vector<std::vector<cv::DMatch> > &matches)
+{
+	matches.clear();
+	const int numQuery = queryDescriptors.rows;
+	const int numTrain = trainDescriptors.rows;
+	if(numQuery==0 || numTrain==0)
+		return;
+	CV_Assert(queryDescriptors.cols==trainDescriptors.cols);
+	const int size = queryDescriptors.cols;
+	const bool radius = ratio<=0 && !crossCheck;
+
+	prepare(numQuery, numTrain);
+	prepareCoarseStage(queryDescriptors, numTrain);
+
+	//One pass over all pairs gathers the nearest neighbours in both directions
+	std::vector<cv::DMatch> candidates;
+	for(int q=0; q<numQuery; q++){
+		const unsigned char* d1 = queryDescriptors.data + queryDescriptors.step*q;
+		for(int t=0; t<numTrain; t++){
+			if(!passesCoarseStage(q, t))
+				continue;
+			accumulate(q, t, hamming(d1, trainDescriptors.data + trainDescriptors.step*t, size), candidates);
+			numComparisons++;
+		}
+		if(radius && !candidates.empty()){
+			std::sort(candidates.begin(), candidates.end());
+			matches.push_back(std::vector<cv::DMatch>());
+			matches.back().swap(candidates);
+		}
+	}
+
+	if(!radius)
+		emit(numQuery, matches);
+}
+
+void ConstrainedMatcher::buildGrid(const std::vector<cv::KeyPoint> &trainKeypoints)
+{
+	const int numTrain = trainKeypoints.size();
+	int maxX = 0;
+	int maxY = 0;
+	for(int t=0; t<numTrain; t++){
+		maxX = std::max(maxX, int(trainKeypoints[t].pt.x));
+		maxY = std::max(maxY, int(trainKeypoints[t].pt.y));
+	}
+	gridCols = maxX/bucketSize + 1;
+	gridRows = maxY/bucketSize + 1;
+
+	//Counting sort of the keypoint indices by cell
+	cellStart.assign(gridCols*gridRows + 1, 0);
+	for(int t=0; t<numTrain; t++){
+		const int cell = int(trainKeypoints[t].pt.y)/bucketSize*gridCols + int(trainKeypoints[t].pt.x)/bucketSize;
+		cellStart[cell+1]++;
+	}
+	for(int c=0; c<gridCols*gridRows; c++)
+		cellStart[c+1] += cellStart[c];
+	cellIndices.resize(numTrain);
+	std::vector<int> fill(cellStart.begin(), cellStart.end()-1);
+	for(int t=0; t<numTrain; t++){
+		const int cell = int(trainKeypoints[t].pt.y)/bucketSize*gridCols + int(trainKeypoints[t].pt.x)/bucketSize;
+		cellIndices[fill[cell]++] = t;
+	}
+}
+
+void ConstrainedMatcher::match(const cv::Mat &queryDescriptors, const std::vector<cv::KeyPoint> &queryKeypoints,
+		const cv::Mat &trainDescriptors, const std::vector<cv::KeyPoint> &trainKeypoints,
+		const GeometricPrior &prior, std::vector<std::vector<cv::DMatch> > &matches)
+{
+	matches.clear();
+	const int numQuery = queryDescriptors.rows;
+	const int numTrain = trainDescriptors.rows;
+	if(numQuery==0 || numTrain==0)
+		return;
+	CV_Assert(queryDescriptors.cols==trainDescriptors.cols);
+	CV_Assert(int(queryKeypoints.size())==numQuery && int(trainKeypoints.size())==numTrain);
+	const int size = queryDescriptors.cols;
+	const bool radius = ratio<=0 && !crossCheck;
+
+	prepare(numQuery, numTrain);
+	prepareCoarseStage(queryDescriptors, numTrain);
+	buildGrid(trainKeypoints);
+
+	//The angle criterion |atan2(dy, offset)| <= maxAngle becomes |dy| <= offset*tan(maxAngle)
+	const float tanMaxAngle = tan(prior.maxAngle*PI/180);
+	const int maxRowOffset = int(prior.maxOffset*tanMaxAngle) + 1;
+
+	std::vector<cv::DMatch> candidates;
+	for(int q=0; q<numQuery; q++){
+		//The integer coordinates are used as in FeatureExtraction::verifyMatch
+		const int x1 = queryKeypoints[q].pt.x;
+		const int y1 = queryKeypoints[q].pt.y;
+
+		//The window of train keypoints that satisfies the column offset and the angle
+		const int minX = int(ceil(prior.minOffset)) - prior.imageCols + x1;
+		const int maxX = int(prior.maxOffset) - prior.imageCols + x1;
+		const int minY = y1 - maxRowOffset;
+		const int maxY = y1 + maxRowOffset;
+		if(maxX<0 || maxY<0)
+			continue;
+		const int cellX0 = std::max(minX, 0)/bucketSize;
+		const int cellX1 = std::min(maxX/bucketSize, gridCols-1);
+		const int cellY0 = std::max(minY, 0)/bucketSize;
+		const int cellY1 = std::min(maxY/bucketSize, gridRows-1);
+
+		const unsigned char* d1 = queryDescriptors.data + queryDescriptors.step*q;
+		for(int cy=cellY0; cy<=cellY1; cy++){
+			for(int cx=cellX0; cx<=cellX1; cx++){
+				const int cell = cy*gridCols + cx;
+				for(int k=cellStart[cell]; k<cellStart[cell+1]; k++){
+					const int t = cellIndices[k];
+					//Exact geometric test before the expensive descriptor comparison
+					const int x2 = trainKeypoints[t].pt.x;
+					const int y2 = trainKeypoints[t].pt.y;
+					const float offset = float(prior.imageCols - x1 + x2);
+					if(offset<prior.minOffset || offset>prior.maxOffset)
+						continue;
+					if(float(abs(y2-y1)) > offset*tanMaxAngle)
+						continue;
+					if(!passesCoarseStage(q, t))
+						continue;
+					accumulate(q, t, hamming(d1, trainDescriptors.data + trainDescriptors.step*t, size), candidates);
+					numComparisons++;
+				}
+			}
+		}
+		if(radius && !candidates.empty()){
+			std::sort(candidates.begin(), candidates.end());
+			matches.push_back(std::vector<cv::DMatch>());
+			matches.back().swap(candidates);
+		}
+	}
+
+	if(!radius)
+		emit(numQuery, matches);
+}
@@ -131,19 +131,17 @@ void DataAnalysis::writeToFile(){
 }
 
 void DataAnalysis::help(char** argv){
-	std::cout << "This command line tool lets you evaluate different keypoint "
-			<< "detectors, descriptors and matchers." << std::endl
+	//The command line evaluator that used to take these arguments was replaced by
+	//the briskEvaluation tool (Src/Utils/BriskEvaluation)
+	std::cout << "The detectors, descriptors and matchers are evaluated on the image bank by the "
+			<< "briskEvaluation tool (Src/Utils/BriskEvaluation)." << std::endl
 			<< "usage:" << std::endl
-			<< argv[0] << " <dataset> <2nd> <detector> <descriptor> [descFile1 descFile1]" << std::endl
-			<< "    " << "dataset:    Folder containing the images. The images must be of .ppm "<< std::endl
-			<< "    " << "            format. They must be named img#.ppm, and there must be "<< std::endl
-			<< "    " << "            corresponding homographies named H1to#." << std::endl
-			<< "    " << "            You can also use the prefix rot-, then 2nd will be the" << std::endl
-			<< "    " << "            rotation in degrees." << std::endl
-			<< "    " << "2nd:        Number of the 2nd image (the 1st one is always img1.ppm)"<< std::endl
-			<< "    " << "            or the rotation in degrees, if rot- used." << std::endl
-			<< "    " << "detector:   Feature detector, e.g. AGAST, or BRISK. You can add the "<< std::endl
-			<< "    " << "            threshold, e.g. BRISK80 or SURF2000"<< std::endl
-			<< "    " << "descriptor: Feature descriptor, e.g. SURF, BRIEF, BRISK or U-BRISK."<< std::endl
-			<< "    " << "[descFile]: Optional: files with descriptors to act as detected points."<< std::endl;
+			<< "briskEvaluation [--root <dir>] [--datasets MG,OG,MGOld,OGOld] [--thresholds t1,t2,..]" << std::endl
+			<< "    " << "[--octaves o1,..] [--patternScales s1,..] [--hammingDistances h1,..] [--ratios r1,..]" << std::endl
+			<< "    " << "[--threads n] [--csv file] [--summary file]" << std::endl
+			<< "    " << "It matches every left image of the overlapping datasets against the" << std::endl
+			<< "    " << "corresponding right image for every combination of the parameters and" << std::endl
+			<< "    " << "writes the matching scores, the valid and invalid matches and the" << std::endl
+			<< "    " << "durations of the stages as CSV, and the Pareto front of latency vs." << std::endl
+			<< "    " << "precision and recall." << std::endl;
 }
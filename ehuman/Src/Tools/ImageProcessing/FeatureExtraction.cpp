@@ -4,7 +4,7 @@
 #define FEATURE_DEBUG_MODE 0
 #define FEATURE_DEBUG_MATCHES 0
 
-FeatureExtraction::FeatureExtraction()
+FeatureExtraction::FeatureExtraction() : knnRatio(0.7f)
 {
 	//ctor
 }
@@ -217,7 +217,7 @@ cv::Ptr<cv::DescriptorExtractor> FeatureExtraction::getExtractor(int argc, strin
 
 }
 
-void FeatureExtraction::performMatchingValidation(const cv::Mat & img, std::vector<cv::KeyPoint> &keypoints, std::vector<cv::KeyPoint> &keypoints2, std::vector<std::vector<cv::DMatch> > &matches, bool hamming)
+void FeatureExtraction::performMatchingValidation(const cv::Mat & img, std::vector<cv::KeyPoint> &keypoints, std::vector<cv::KeyPoint> &keypoints2, std::vector<std::vector<cv::DMatch> > &matches, bool hamming, bool ratioTested)
 {
 
 	//Initialise the scoring variables
@@ -229,9 +229,7 @@ void FeatureExtraction::performMatchingValidation(const cv::Mat & img, std::vect
 	totalNumBestMatches = 0;
 
 	int allMatches = 0;
-	int counter = 0;
-	int matchSize = 0;
-	bool isTrueMatchFound= false;
+	int kept = 0;
 
 	//For matching
 	int i1 = -1;
@@ -248,158 +246,93 @@ void FeatureExtraction::performMatchingValidation(const cv::Mat & img, std::vect
 	//Loops through all of the matches
 	for( size_t i = 0; i < matches.size(); i++ )
 	{
+		std::vector<cv::DMatch> &candidates = matches[i];
+		allMatches = candidates.size();
+		totalNumMatches = totalNumMatches + allMatches;
 
-		//Verify the Knn Neighbors matching criteria
-		if (matches[i].size()>0){
-
-			verifyKNNMatches(matches[i]);//Check if the KNN ratio holds
+		//Verify the Knn Neighbors matching criteria, unless the matcher already did
+		isKnnMatch = true;
+		if(!ratioTested && allMatches>0)
+			verifyKNNMatches(candidates);//Check if the KNN ratio holds
 
 #if (FEATURE_DEBUG_MATCHES)
-			cout<<"The index is: "<<i<<endl;
-			cout<<"Is the knn criteria met? "<<isKnnMatch<<endl;
-			cout<<"The number of matches is : "<<matches[i].size()<<endl;
-			cout<<"****************************************"<<endl;
+		cout<<"The index is: "<<i<<endl;
+		cout<<"Is the knn criteria met? "<<isKnnMatch<<endl;
+		cout<<"The number of matches is : "<<allMatches<<endl;
+		cout<<"****************************************"<<endl;
 #endif
-		}
 
-		//Initialise the variables
-		allMatches = matches[i].size();
-		counter = 0;
-		matchSize = matches[i].size();
-		isTrueMatchFound = false;
-
-		//Check if the matches satisifies the Knn Criteria
-		if(isKnnMatch)
+		if(!isKnnMatch)
 		{
-			//If it satisfies the Knn criteria, then check the angle and distance criteria
-			while(counter<matchSize)
-			{
-				//Corresponds to the left image. Used as the reference matching point
-				//Therefore all matches are relative to this point
-				i1 = matches[i][counter].queryIdx;
-
-				//Corresponds to the right image
-				i2 = matches[i][counter].trainIdx;
-
-				//Determine the distance between matches
-				distanceMatch = matches[i][counter].distance;
+			//Remove all matches of this keypoint
+			candidates.clear();
+			continue;
+		}
 
-				//Give a constant reward for being under a certain threshold
-				matchingScore = 0;
-				if (distanceMatch==0)
-					matchingScore=100;
-				else{
-					if (hamming)
-						matchingScore = 1/distanceMatch;
-					else
-						matchingScore = 1/distanceMatch;
-				}
+		//Check the angle and distance criteria. The valid matches are compacted
+		//to the front of the vector instead of erasing the invalid ones
+		kept = 0;
+		for(int counter = 0; counter < allMatches; counter++)
+		{
+			//Corresponds to the left image. Used as the reference matching point
+			//Therefore all matches are relative to this point
+			i1 = candidates[counter].queryIdx;
 
+			//Corresponds to the right image
+			i2 = candidates[counter].trainIdx;
 
-#if (FEATURE_DEBUG_MATCHES)
-				cout<<"*************"<<endl;
-				cout<<"All matching keypoints: "<<matches.size()<<endl;
-				cout<<"The number of matches is : "<<matches[i].size()<<endl;
-				cout<<"Match Index: "<<i<<endl;
-				cout<<"Counter Number: "<<counter<<endl;
-				cout<<"Query Index: "<<i1<<endl;
-				cout<<"Train Index: "<<i2<<endl;
-				cout<<"*************"<<endl;
-				cout<<"Keypoint indices i1, i2: "<<i1<<", "<<i2<<endl;
-				cout<<"****************************"<<endl;
-				cout<<"Keypoint Right  row,col : "<<(*(keypoints2.begin()+i2)).pt.y<<", "<<(*(keypoints2.begin()+i2)).pt.x<<endl;
-				cout<<"Keypoint Left row,col : "<<(*(keypoints.begin() + i1)).pt.y<<", "<<(*(keypoints.begin() + i1)).pt.x<<endl;
-				cout<<"****************************"<<endl;
-#endif
+			//Determine the distance between matches
+			distanceMatch = candidates[counter].distance;
 
-#if (FEATURE_DEBUG_MATCHES)
-				//dataAnalysis.displayOutput(keypoints2, keypoints, matchingScore, i1, i2);
-#endif
-
-				//Verify whether the match is correct or not based on angles and length of the match
-				//****************************************************
-				correctMatch = verifyMatch(img, keypoints[i1], keypoints2[i2]);
-				//****************************************************
+			//Give a constant reward for being under a certain threshold
+			if (distanceMatch==0)
+				matchingScore=100;
+			else
+				matchingScore = 1/distanceMatch;
 
 #if (FEATURE_DEBUG_MATCHES)
-				cout<<"CorrectMatch: "<<correctMatch<<endl;
+			cout<<"Counter Number: "<<counter<<endl;
+			cout<<"Keypoint indices i1, i2: "<<i1<<", "<<i2<<endl;
+			cout<<"Keypoint Right  row,col : "<<keypoints2[i2].pt.y<<", "<<keypoints2[i2].pt.x<<endl;
+			cout<<"Keypoint Left row,col : "<<keypoints[i1].pt.y<<", "<<keypoints[i1].pt.x<<endl;
+			cout<<"****************************"<<endl;
 #endif
-				//****************************************************
-				//If the match is incorrect, remove the invalid match
-				if (correctMatch==false)
-				{
-#if (FEATURE_DEBUG_MATCHES)
-					cout<<"Keypoint Left to be erased row,col : "<<(*(keypoints.begin() + i1)).pt.y<<", "<<(*(keypoints.begin() + i1)).pt.x<<endl;
-					cout<<"Keypoint Right to be erased row,col : "<<(*(keypoints2.begin()+i2)).pt.y<<", "<<(*(keypoints2.begin()+i2)).pt.x<<endl;
-					cout<<"The number of matches before removal is : "<<matches[i].size()<<endl;
-					cout<<"-----------------------------------------"<<endl;
-					//Erase the corresponding match
-					int delRight = (*(matches[i].begin()+counter)).trainIdx;
-					int delLeft = (*(matches[i].begin()+counter)).queryIdx;
-
-					double keyLeftR = (*(keypoints.begin()+delLeft)).pt.y;
-					double keyLeftC = (*(keypoints.begin()+delLeft)).pt.x;
-
-					double keyRightR = (*(keypoints2.begin()+delRight)).pt.y;
-					double keyRightC = (*(keypoints2.begin()+delRight)).pt.x;
-
-					cout<<"The Left image coordinate to be erased row, col is: "<<keyLeftR<<", "<<keyLeftC<<endl;
-					cout<<"The right image coordinate to be erased row, col is: "<<keyRightR<<", "<<keyRightC<<endl;
-#endif
-
-					//Erase the matches
-					//***************************************************
-					matches[i].erase(matches[i].begin()+counter);
-					//***************************************************
 
-					//Get the size of the new match
-					matchSize = matches[i].size();
+			//Verify whether the match is correct or not based on angles and length of the match
+			//****************************************************
+			correctMatch = verifyMatch(img, keypoints[i1], keypoints2[i2]);
+			//****************************************************
 
 #if (FEATURE_DEBUG_MATCHES)
-					cout<<"The number of matches after removal is : "<<matchSize<<endl;
-					cout<<"counter is : "<<counter<<endl;
-					cout<<"----------------------------------------"<<endl;
+			cout<<"CorrectMatch: "<<correctMatch<<endl;
 #endif
-					//Increment the total number of invalid matches
-					totalNumInvalidMatches = totalNumInvalidMatches + 1;
+			if (correctMatch==false)
+			{
+				//Increment the total number of invalid matches
+				totalNumInvalidMatches = totalNumInvalidMatches + 1;
 
 #if (FEATURE_DEBUG_MATCHES)
-					//This stores the coordinates of the invalid matches
-					rightPoints.push_back(keypoints2[i2].pt);
-					leftPoints.push_back(keypoints[i1].pt);
+				//This stores the coordinates of the invalid matches
+				rightPoints.push_back(keypoints2[i2].pt);
+				leftPoints.push_back(keypoints[i1].pt);
 #endif
-				}
-				else
-				{
-					isTrueMatchFound = true;
-					counter++;
-				}
-
-				//If all matches were deleted from the vector, then skip
-				if(matches[i].size()==0)
-					break;
-
-				//This only considers the best correct match.
-				if(isTrueMatchFound && counter ==1){
-					totalNumBestMatches = totalNumBestMatches + 1;
-					imageMatchingScoreBest = imageMatchingScoreBest + matchingScore;
-					isTrueMatchFound = false;
-				}
-				imageMatchingScore = imageMatchingScore + matchingScore;
+				continue;
 			}
 
-		}//End if KnnMatches Criteria
-		else{
-			//Remove matches if there are matches to be removed
-			if(matches[i].size()>0)
-				for(size_t j=0;j<=matches[i].size();j++){
-					matches[i].erase(matches[i].begin()+j);
-				}
+			//This only considers the best correct match.
+			if(kept==0){
+				totalNumBestMatches = totalNumBestMatches + 1;
+				imageMatchingScoreBest = imageMatchingScoreBest + matchingScore;
+			}
+			imageMatchingScore = imageMatchingScore + matchingScore;
 
+			if(kept!=counter)
+				candidates[kept] = candidates[counter];
+			kept++;
 		}
+		candidates.resize(kept);
 
-		totalNumValidMatches = totalNumValidMatches + matches[i].size();
-		totalNumMatches = totalNumMatches + allMatches;
+		totalNumValidMatches = totalNumValidMatches + kept;
 	}
 
 }
@@ -466,6 +399,11 @@ void FeatureExtraction::verifyKNNMatches(std::vector<cv::DMatch> &matches){
 
 	dist1 = 0;
 	dist2 = 0;
+	//A single candidate has no competing neighbor, so it cannot be ambiguous
+	if(matches.size()<2){
+		isKnnMatch = true;
+		return;
+	}
 	//Get the distances between a keypoint and its nearest neighbors
 	dist1 = matches[0].distance;
 	dist2 = matches[1].distance;
@@ -473,10 +411,10 @@ void FeatureExtraction::verifyKNNMatches(std::vector<cv::DMatch> &matches){
 	//Determine the ratio between the two distances
 	distanceRatio = dist1/dist2;
 
-	//If the ratio is greater than 0.7, then it is probably a false match
+	//If the ratio is greater than knnRatio (0.7 by default), then it is probably a false match
 	//This means that the points are close together and the second match is
 	//probably noise
-	if(distanceRatio > 0.7)
+	if(distanceRatio > knnRatio)
 		isKnnMatch = false;
 	else
 		isKnnMatch = true;
@@ -0,0 +1,434 @@
+#include "include/FrameLog.h"
+#include <algorithm>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char LOG_MAGIC[4] = {'B', 'F', 'L', 'G'};
+static const char INDEX_MAGIC[4] = {'B', 'F', 'L', 'I'};
+static const int LOG_VERSION = 1;
+
+//Frames in a chunk and chunks in the file start on 16 byte boundaries, so the
+//headers can be accessed directly
+static inline size_t align16(size_t size)
+{
+	return (size + 15) & ~(size_t)15;
+}
+
+static bool writePadding(FILE *file, size_t size)
+{
+	static const char zeros[16] = {0};
+	return size==0 || fwrite(zeros, size, 1, file)==1;
+}
+
+//The trailer at the end of the file
+struct FrameLogTrailer
+{
+	long long indexOffset;
+	int numChunks;
+	int numFrames;
+	char magic[4];
+};
+
+//LZ4 block format: sequences of a token (literal length, match length - 4), the
+//literals, a 16 bit match offset and the match. The last sequence only has literals.
+static const int LZ4_MIN_MATCH = 4;
+static const int LZ4_LAST_LITERALS = 5; //The last bytes are always literals
+static const int LZ4_MATCH_LIMIT = 12;  //The last match starts at least this many bytes before the end
+static const int LZ4_HASH_BITS = 12;
+
+static inline size_t lz4Bound(size_t size)
+{
+	return size + size/255 + 16;
+}
+
+static inline unsigned read32(const unsigned char *p)
+{
+	unsigned v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned char* writeLength(unsigned char *op, size_t length)
+{
+	for(length -= 15; length>=255; length -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)length;
+	return op;
+}
+
+static unsigned char* writeSequence(unsigned char *op, const unsigned char *literals, size_t numLiterals)
+{
+	unsigned char *token = op++;
+	*token = (unsigned char)((numLiterals>=15 ? 15 : numLiterals) << 4);
+	if(numLiterals>=15)
+		op = writeLength(op, numLiterals);
+	memcpy(op, literals, numLiterals);
+	return op + numLiterals;
+}
+
+//Greedy compression with a hash table of the last positions of 4 byte sequences.
+//dst must hold lz4Bound(size) bytes. Returns the compressed size.
+static size_t lz4Compress(const unsigned char *src, size_t size, unsigned char *dst)
+{
+	unsigned table[1 << LZ4_HASH_BITS]; //Positions + 1, 0 is empty
+	memset(table, 0, sizeof(table));
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char *end = src + size;
+	unsigned char *op = dst;
+
+	while(size>LZ4_MATCH_LIMIT && ip<end - LZ4_MATCH_LIMIT)
+	{
+		const unsigned sequence = read32(ip);
+		const unsigned hash = (sequence*2654435761U) >> (32 - LZ4_HASH_BITS);
+		const unsigned candidate = table[hash];
+		table[hash] = unsigned(ip - src) + 1;
+		const unsigned char *ref = src + candidate - 1;
+		if(candidate==0 || ip - ref>65535 || read32(ref)!=sequence){
+			ip++;
+			continue;
+		}
+
+		size_t length = LZ4_MIN_MATCH;
+		while(ip + length<end - LZ4_LAST_LITERALS && ref[length]==ip[length])
+			length++;
+
+		unsigned char *token = op;
+		op = writeSequence(op, anchor, ip - anchor);
+		const size_t distance = ip - ref;
+		*op++ = (unsigned char)(distance & 255);
+		*op++ = (unsigned char)(distance >> 8);
+		const size_t matchLength = length - LZ4_MIN_MATCH;
+		*token |= (unsigned char)(matchLength>=15 ? 15 : matchLength);
+		if(matchLength>=15)
+			op = writeLength(op, matchLength);
+		ip += length;
+		anchor = ip;
+	}
+	op = writeSequence(op, anchor, end - anchor);
+	return op - dst;
+}
+
+//Decompresses exactly rawSize bytes. Returns false if the data is corrupt.
+static bool lz4Decompress(const unsigned char *src, size_t size, unsigned char *dst, size_t rawSize)
+{
+	const unsigned char *ip = src;
+	const unsigned char *end = src + size;
+	unsigned char *op = dst;
+	unsigned char *outEnd = dst + rawSize;
+	while(ip<end)
+	{
+		const unsigned token = *ip++;
+		size_t length = token >> 4;
+		if(length==15){
+			unsigned char b;
+			do{
+				if(ip>=end)
+					return false;
+				b = *ip++;
+				length += b;
+			}while(b==255);
+		}
+		if(length>size_t(end - ip) || length>size_t(outEnd - op))
+			return false;
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+		if(ip==end)
+			break;
+
+		if(end - ip<2)
+			return false;
+		const size_t distance = ip[0] | ip[1] << 8;
+		ip += 2;
+		if(distance==0 || distance>size_t(op - dst))
+			return false;
+		length = token & 15;
+		if(length==15){
+			unsigned char b;
+			do{
+				if(ip>=end)
+					return false;
+				b = *ip++;
+				length += b;
+			}while(b==255);
+		}
+		length += LZ4_MIN_MATCH;
+		if(length>size_t(outEnd - op))
+			return false;
+		//The match may overlap the output, so it is copied byte by byte
+		const unsigned char *match = op - distance;
+		for(size_t i=0; i<length; i++)
+			op[i] = match[i];
+		op += length;
+	}
+	return op==outEnd;
+}
+
+FrameLogWriter::FrameLogWriter() :
+	file(0), offset(0), framesPerChunk(16), compress(false), failed(false), framesInChunk(0)
+{
+	//ctor
+}
+
+FrameLogWriter::~FrameLogWriter()
+{
+	if(file)
+		close();
+}
+
+bool FrameLogWriter::open(const std::string &filename, int framesPerChunk, bool compress)
+{
+	if(file)
+		close();
+	file = fopen(filename.c_str(), "wb");
+	if(!file)
+		return false;
+	this->framesPerChunk = std::max(1, framesPerChunk);
+	this->compress = compress;
+	failed = false;
+	framesInChunk = 0;
+	chunk.clear();
+	chunks.clear();
+	frames.clear();
+	offset = sizeof(LOG_MAGIC) + sizeof(LOG_VERSION);
+	failed = fwrite(LOG_MAGIC, sizeof(LOG_MAGIC), 1, file)!=1
+		|| fwrite(&LOG_VERSION, sizeof(LOG_VERSION), 1, file)!=1
+		|| !writePadding(file, align16(offset) - offset);
+	offset = align16(offset);
+	return !failed;
+}
+
+bool FrameLogWriter::addFrame(const FrameHeader &header, const unsigned char *data)
+{
+	if(!file || failed)
+		return false;
+	FrameIndexEntry entry;
+	entry.chunk = int(chunks.size());
+	entry.offset = unsigned(chunk.size());
+	entry.timestamp = header.timestamp;
+	frames.push_back(entry);
+
+	chunk.resize(align16(chunk.size() + sizeof(FrameHeader) + header.dataSize));
+	memcpy(&chunk[entry.offset], &header, sizeof(FrameHeader));
+	if(header.dataSize>0)
+		memcpy(&chunk[entry.offset + sizeof(FrameHeader)], data, header.dataSize);
+	if(++framesInChunk>=framesPerChunk)
+		return flushChunk();
+	return true;
+}
+
+bool FrameLogWriter::addImage(const cv::Mat &image, unsigned timestamp)
+{
+	if(image.type()!=CV_8UC1 && image.type()!=CV_8UC2)
+		return false;
+	FrameHeader header;
+	memset(&header, 0, sizeof(header));
+	header.timestamp = timestamp;
+	header.width = image.cols;
+	header.height = image.rows;
+	header.format = image.type()==CV_8UC1 ? FrameHeader::GREY : FrameHeader::YUV422;
+	header.cameraMatrix[0] = header.cameraMatrix[4] = header.cameraMatrix[8] = 1.f;
+	header.dataSize = unsigned(image.cols*image.rows*(header.format==FrameHeader::GREY ? 1 : 2));
+	if(image.isContinuous())
+		return addFrame(header, image.data);
+	const cv::Mat continuous = image.clone();
+	return addFrame(header, continuous.data);
+}
+
+bool FrameLogWriter::flushChunk()
+{
+	if(framesInChunk==0)
+		return !failed;
+	ChunkIndexEntry entry;
+	entry.offset = offset;
+	entry.rawSize = unsigned(chunk.size());
+	entry.storedSize = entry.rawSize;
+	const unsigned char *stored = &chunk[0];
+	if(compress){
+		compressed.resize(lz4Bound(chunk.size()));
+		const size_t size = lz4Compress(&chunk[0], chunk.size(), &compressed[0]);
+		//Chunks that do not get smaller are stored as they are
+		if(size<chunk.size()){
+			entry.storedSize = unsigned(size);
+			stored = &compressed[0];
+		}
+	}
+	if(fwrite(stored, entry.storedSize, 1, file)!=1
+		|| !writePadding(file, align16(entry.storedSize) - entry.storedSize))
+		failed = true;
+	offset += align16(entry.storedSize);
+	chunks.push_back(entry);
+	chunk.clear();
+	framesInChunk = 0;
+	return !failed;
+}
+
+bool FrameLogWriter::close()
+{
+	if(!file)
+		return false;
+	flushChunk();
+	FrameLogTrailer trailer;
+	trailer.indexOffset = offset;
+	trailer.numChunks = int(chunks.size());
+	trailer.numFrames = int(frames.size());
+	memcpy(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic));
+	if((!chunks.empty() && fwrite(&chunks[0], sizeof(ChunkIndexEntry), chunks.size(), file)!=chunks.size())
+		|| (!frames.empty() && fwrite(&frames[0], sizeof(FrameIndexEntry), frames.size(), file)!=frames.size())
+		|| fwrite(&trailer, sizeof(trailer), 1, file)!=1)
+		failed = true;
+	if(fclose(file)!=0)
+		failed = true;
+	file = 0;
+	return !failed;
+}
+
+FrameLogReader::FrameLogReader() :
+	data(0), fileSize(0), cachedChunk(-1)
+{
+	//ctor
+}
+
+FrameLogReader::~FrameLogReader()
+{
+	close();
+}
+
+bool FrameLogReader::open(const std::string &filename)
+{
+	close();
+	const int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd<0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st)!=0 || size_t(st.st_size)<sizeof(LOG_MAGIC) + sizeof(LOG_VERSION) + sizeof(FrameLogTrailer)){
+		::close(fd);
+		return false;
+	}
+	void *memory = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(memory==MAP_FAILED)
+		return false;
+	data = (const unsigned char*)memory;
+	fileSize = st.st_size;
+
+	int version;
+	FrameLogTrailer trailer;
+	memcpy(&version, data + sizeof(LOG_MAGIC), sizeof(version));
+	memcpy(&trailer, data + fileSize - sizeof(trailer), sizeof(trailer));
+	const size_t indexEnd = fileSize - sizeof(trailer);
+	if(memcmp(data, LOG_MAGIC, sizeof(LOG_MAGIC))!=0 || version!=LOG_VERSION
+		|| memcmp(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic))!=0
+		|| trailer.numChunks<0 || trailer.numFrames<0 || trailer.indexOffset<0
+		|| size_t(trailer.indexOffset)>indexEnd
+		|| (indexEnd - trailer.indexOffset)!=trailer.numChunks*sizeof(ChunkIndexEntry) + trailer.numFrames*sizeof(FrameIndexEntry)){
+		close();
+		return false;
+	}
+	chunks.resize(trailer.numChunks);
+	frames.resize(trailer.numFrames);
+	if(!chunks.empty())
+		memcpy(&chunks[0], data + trailer.indexOffset, chunks.size()*sizeof(ChunkIndexEntry));
+	if(!frames.empty())
+		memcpy(&frames[0], data + trailer.indexOffset + chunks.size()*sizeof(ChunkIndexEntry),
+				frames.size()*sizeof(FrameIndexEntry));
+
+	//Chunks must lie in front of the index and frames inside their chunks
+	for(size_t i=0; i<chunks.size(); i++)
+		if(chunks[i].offset<0 || chunks[i].offset%16!=0 || chunks[i].offset + chunks[i].storedSize>trailer.indexOffset
+			|| chunks[i].storedSize>chunks[i].rawSize){
+			close();
+			return false;
+		}
+	for(size_t i=0; i<frames.size(); i++)
+		if(frames[i].chunk<0 || frames[i].chunk>=int(chunks.size()) || frames[i].offset%16!=0
+			|| size_t(frames[i].offset) + sizeof(FrameHeader)>chunks[frames[i].chunk].rawSize){
+			close();
+			return false;
+		}
+	madvise(memory, fileSize, MADV_SEQUENTIAL);
+	return true;
+}
+
+void FrameLogReader::close()
+{
+	if(data)
+		munmap((void*)data, fileSize);
+	data = 0;
+	fileSize = 0;
+	chunks.clear();
+	frames.clear();
+	cachedChunk = -1;
+	cache.clear();
+}
+
+const FrameHeader* FrameLogReader::getFrame(int i)
+{
+	if(!data || i<0 || i>=size())
+		return 0;
+	const FrameIndexEntry &frame = frames[i];
+	const ChunkIndexEntry &chunk = chunks[frame.chunk];
+	const unsigned char *chunkData = data + chunk.offset;
+	if(chunk.storedSize!=chunk.rawSize){
+		if(cachedChunk!=frame.chunk){
+			cache.resize(chunk.rawSize);
+			if(!lz4Decompress(chunkData, chunk.storedSize, &cache[0], chunk.rawSize)){
+				cachedChunk = -1;
+				return 0;
+			}
+			cachedChunk = frame.chunk;
+		}
+		chunkData = &cache[0];
+	}
+
+	const FrameHeader *header = (const FrameHeader*)(chunkData + frame.offset);
+	if(frame.offset + sizeof(FrameHeader) + size_t(header->dataSize)>chunk.rawSize)
+		return 0;
+	return header;
+}
+
+int FrameLogReader::findFrame(unsigned timestamp) const
+{
+	int low = 0, high = size();
+	while(low<high)
+	{
+		const int mid = (low + high)/2;
+		if(frames[mid].timestamp<timestamp)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+bool FrameLogReader::getGrey(int i, cv::Mat &image)
+{
+	const FrameHeader *header = getFrame(i);
+	if(!header)
+		return false;
+	const FrameHeader &h = *header;
+	const unsigned char *pixels = (const unsigned char*)header + sizeof(FrameHeader);
+	const size_t numPixels = size_t(h.width)*h.height;
+	if(h.width<=0 || h.height<=0)
+		return false;
+	if(h.format==FrameHeader::GREY && h.dataSize>=numPixels){
+		image = cv::Mat(h.height, h.width, CV_8UC1, (void*)pixels);
+		return true;
+	}
+	if(h.format==FrameHeader::YUV422 && h.dataSize>=numPixels*2){
+		image.create(h.height, h.width, CV_8UC1);
+		for(int y=0; y<h.height; y++)
+		{
+			const unsigned char *src = pixels + size_t(y)*h.width*2;
+			unsigned char *dst = image.ptr<unsigned char>(y);
+			for(int x=0; x<h.width; x++)
+				dst[x] = src[x*2];
+		}
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,139 @@
+#include "include/KeypointTracker.h"
+#include <limits.h>
+#include <string.h>
+
+KeypointTracker::KeypointTracker(float windowRadius, int minTracks, float minTrackedRatio) :
+	windowRadius(windowRadius), minTracks(minTracks), minTrackedRatio(minTrackedRatio)
+{
+	//ctor
+}
+
+KeypointTracker::~KeypointTracker()
+{
+	//dtor
+}
+
+bool KeypointTracker::isTracking() const
+{
+	return int(positions.size())>=minTracks;
+}
+
+void KeypointTracker::reset()
+{
+	positions.clear();
+	referenceKeypoints.clear();
+	referenceDescriptors.release();
+}
+
+void KeypointTracker::predict(float dx, float dy)
+{
+	for(size_t i=0; i<positions.size(); i++){
+		positions[i].x += dx;
+		positions[i].y += dy;
+	}
+}
+
+void KeypointTracker::selectKeypoints(std::vector<cv::KeyPoint> &keypoints) const
+{
+	const float radius2 = windowRadius*windowRadius;
+	size_t kept = 0;
+	for(size_t k=0; k<keypoints.size(); k++){
+		const cv::Point2f &pt = keypoints[k].pt;
+		for(size_t i=0; i<positions.size(); i++){
+			const float dx = pt.x-positions[i].x;
+			const float dy = pt.y-positions[i].y;
+			if(dx*dx+dy*dy<=radius2){
+				if(kept!=k)
+					keypoints[kept] = keypoints[k];
+				kept++;
+				break;
+			}
+		}
+	}
+	keypoints.resize(kept);
+}
+
+bool KeypointTracker::match(const cv::Mat &queryDescriptors, const std::vector<cv::KeyPoint> &queryKeypoints,
+		int maxDistance, std::vector<std::vector<cv::DMatch> > &matches)
+{
+	matches.clear();
+	const int numTracks = positions.size();
+	const int numQuery = queryDescriptors.rows;
+	if(numTracks==0 || numQuery==0)
+		return false;
+	CV_Assert(queryDescriptors.cols==referenceDescriptors.cols);
+	const int size = queryDescriptors.cols;
+	const float radius2 = windowRadius*windowRadius;
+
+	//Mutual best matches between tracks and the live keypoints in their windows
+	bestQuery.assign(numTracks, -1);
+	bestDistance.assign(numTracks, INT_MAX);
+	bestTrack.assign(numQuery, -1);
+	bestTrackDistance.assign(numQuery, INT_MAX);
+	for(int q=0; q<numQuery; q++){
+		const cv::Point2f &pt = queryKeypoints[q].pt;
+		const unsigned char* d1 = queryDescriptors.data + queryDescriptors.step*q;
+		for(int t=0; t<numTracks; t++){
+			const float dx = pt.x-positions[t].x;
+			const float dy = pt.y-positions[t].y;
+			if(dx*dx+dy*dy>radius2)
+				continue;
+			const int d = hamming(d1, referenceDescriptors.data + referenceDescriptors.step*t, size);
+			if(d>=maxDistance)
+				continue;
+			if(d<bestDistance[t]){
+				bestDistance[t] = d;
+				bestQuery[t] = q;
+			}
+			if(d<bestTrackDistance[q]){
+				bestTrackDistance[q] = d;
+				bestTrack[q] = t;
+			}
+		}
+	}
+
+	int found = 0;
+	for(int t=0; t<numTracks; t++){
+		const int q = bestQuery[t];
+		if(q<0 || bestTrack[q]!=t)
+			continue;
+		matches.push_back(std::vector<cv::DMatch>(1, cv::DMatch(q, t, 0, (float)bestDistance[t])));
+		found++;
+	}
+
+	return found>=minTracks && float(found)>=minTrackedRatio*numTracks;
+}
+
+void KeypointTracker::update(const std::vector<cv::KeyPoint> &queryKeypoints, const std::vector<cv::KeyPoint> &trainKeypoints,
+		const cv::Mat &trainDescriptors, const std::vector<std::vector<cv::DMatch> > &matches)
+{
+	int numTracks = 0;
+	for(size_t i=0; i<matches.size(); i++)
+		if(!matches[i].empty())
+			numTracks++;
+
+	newPositions.clear();
+	newKeypoints.clear();
+	if(numTracks==0){
+		reset();
+		return;
+	}
+	newDescriptors.create(numTracks, trainDescriptors.cols, trainDescriptors.type());
+	int row = 0;
+	for(size_t i=0; i<matches.size(); i++){
+		if(matches[i].empty())
+			continue;
+		const cv::DMatch &m = matches[i][0];
+		newPositions.push_back(queryKeypoints[m.queryIdx].pt);
+		newKeypoints.push_back(trainKeypoints[m.trainIdx]);
+		memcpy(newDescriptors.data + newDescriptors.step*row, trainDescriptors.data + trainDescriptors.step*m.trainIdx, trainDescriptors.cols);
+		row++;
+	}
+
+	//Swap the buffers, so the old ones are reused by the next update
+	positions.swap(newPositions);
+	referenceKeypoints.swap(newKeypoints);
+	cv::Mat previous = referenceDescriptors;
+	referenceDescriptors = newDescriptors;
+	newDescriptors = previous;
+}
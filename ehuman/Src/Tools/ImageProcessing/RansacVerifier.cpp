@@ -0,0 +1,240 @@
+#include "include/RansacVerifier.h"
+#include <algorithm>
+#include <math.h>
+#include <emmintrin.h>
+
+//The number of set bits of the 4 bit SSE comparison masks
+static const int MASK_BITS[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+//Fixed seed so the verification of a frame is reproducible
+static const unsigned int RANSAC_SEED = 12345;
+
+RansacVerifier::RansacVerifier(Model model, float threshold, int maxIterations, float confidence) :
+	model(model), threshold(threshold), maxIterations(maxIterations), confidence(confidence),
+	numInliers(0), numIterations(0), numPoints(0), randomState(RANSAC_SEED)
+{
+	for(int i=0; i<9; i++)
+		transformation[i] = (i%4==0) ? 1.0f : 0.0f;
+}
+
+RansacVerifier::~RansacVerifier()
+{
+	//dtor
+}
+
+inline unsigned int RansacVerifier::nextRandom()
+{
+	randomState = randomState*1664525u + 1013904223u;
+	//The low bits of a linear congruential generator are weak
+	return randomState >> 8;
+}
+
+void RansacVerifier::drawSample(int n, int size, int *sample)
+{
+	for(int i=0; i<size; i++){
+		bool unique;
+		do{
+			sample[i] = nextRandom()%n;
+			unique = true;
+			for(int j=0; j<i; j++)
+				if(sample[j]==sample[i])
+					unique = false;
+		}while(!unique);
+	}
+}
+
+bool RansacVerifier::solveAffine(const int *sample, float *h) const
+{
+	const float x0 = srcX[sample[0]], y0 = srcY[sample[0]];
+	const float x1 = srcX[sample[1]]-x0, y1 = srcY[sample[1]]-y0;
+	const float x2 = srcX[sample[2]]-x0, y2 = srcY[sample[2]]-y0;
+	const float det = x1*y2 - x2*y1;
+	//Reject (nearly) collinear samples
+	if(fabs(det)<1.0f)
+		return false;
+	const float invDet = 1.0f/det;
+
+	const float u0 = dstX[sample[0]], v0 = dstY[sample[0]];
+	const float u1 = dstX[sample[1]]-u0, v1 = dstY[sample[1]]-v0;
+	const float u2 = dstX[sample[2]]-u0, v2 = dstY[sample[2]]-v0;
+
+	h[0] = (u1*y2 - u2*y1)*invDet;
+	h[1] = (x1*u2 - x2*u1)*invDet;
+	h[2] = u0 - h[0]*x0 - h[1]*y0;
+	h[3] = (v1*y2 - v2*y1)*invDet;
+	h[4] = (x1*v2 - x2*v1)*invDet;
+	h[5] = v0 - h[3]*x0 - h[4]*y0;
+	h[6] = 0;
+	h[7] = 0;
+	h[8] = 1;
+	return true;
+}
+
+bool RansacVerifier::solveHomography(const int *sample, float *h) const
+{
+	//Direct linear transformation with h[8] = 1, solved by Gaussian elimination
+	double A[8][9];
+	for(int i=0; i<4; i++){
+		const double x = srcX[sample[i]], y = srcY[sample[i]];
+		const double u = dstX[sample[i]], v = dstY[sample[i]];
+		double *r0 = A[2*i];
+		double *r1 = A[2*i+1];
+		r0[0] = x; r0[1] = y; r0[2] = 1; r0[3] = 0; r0[4] = 0; r0[5] = 0; r0[6] = -u*x; r0[7] = -u*y; r0[8] = u;
+		r1[0] = 0; r1[1] = 0; r1[2] = 0; r1[3] = x; r1[4] = y; r1[5] = 1; r1[6] = -v*x; r1[7] = -v*y; r1[8] = v;
+	}
+	for(int c=0; c<8; c++){
+		int pivot = c;
+		for(int r=c+1; r<8; r++)
+			if(fabs(A[r][c])>fabs(A[pivot][c]))
+				pivot = r;
+		if(fabs(A[pivot][c])<1e-9)
+			return false;
+		if(pivot!=c)
+			for(int k=c; k<9; k++)
+				std::swap(A[c][k], A[pivot][k]);
+		const double inv = 1.0/A[c][c];
+		for(int r=c+1; r<8; r++){
+			const double f = A[r][c]*inv;
+			for(int k=c; k<9; k++)
+				A[r][k] -= f*A[c][k];
+		}
+	}
+	double solution[8];
+	for(int r=7; r>=0; r--){
+		double sum = A[r][8];
+		for(int k=r+1; k<8; k++)
+			sum -= A[r][k]*solution[k];
+		solution[r] = sum/A[r][r];
+	}
+	for(int i=0; i<8; i++)
+		h[i] = (float)solution[i];
+	h[8] = 1;
+	return true;
+}
+
+int RansacVerifier::countInliers(const float *h) const
+{
+	//The error is compared without the perspective division:
+	//|n - w*p|^2 < t^2*w^2 with w > 0
+	const float t2 = threshold*threshold;
+	const __m128 h0 = _mm_set1_ps(h[0]), h1 = _mm_set1_ps(h[1]), h2 = _mm_set1_ps(h[2]);
+	const __m128 h3 = _mm_set1_ps(h[3]), h4 = _mm_set1_ps(h[4]), h5 = _mm_set1_ps(h[5]);
+	const __m128 h6 = _mm_set1_ps(h[6]), h7 = _mm_set1_ps(h[7]), h8 = _mm_set1_ps(h[8]);
+	const __m128 thr = _mm_set1_ps(t2);
+	const __m128 zero = _mm_setzero_ps();
+
+	int count = 0;
+	int i = 0;
+	for(; i+4<=numPoints; i+=4){
+		const __m128 x = _mm_loadu_ps(&srcX[i]);
+		const __m128 y = _mm_loadu_ps(&srcY[i]);
+		const __m128 u = _mm_loadu_ps(&dstX[i]);
+		const __m128 v = _mm_loadu_ps(&dstY[i]);
+		const __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h6, x), _mm_mul_ps(h7, y)), h8);
+		const __m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h0, x), _mm_mul_ps(h1, y)), h2);
+		const __m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h3, x), _mm_mul_ps(h4, y)), h5);
+		const __m128 ex = _mm_sub_ps(nx, _mm_mul_ps(u, w));
+		const __m128 ey = _mm_sub_ps(ny, _mm_mul_ps(v, w));
+		const __m128 err = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+		const __m128 limit = _mm_mul_ps(thr, _mm_mul_ps(w, w));
+		const __m128 inlier = _mm_and_ps(_mm_cmplt_ps(err, limit), _mm_cmpgt_ps(w, zero));
+		count += MASK_BITS[_mm_movemask_ps(inlier)];
+	}
+	for(; i<numPoints; i++){
+		const float w = h[6]*srcX[i] + h[7]*srcY[i] + h[8];
+		const float ex = h[0]*srcX[i] + h[1]*srcY[i] + h[2] - dstX[i]*w;
+		const float ey = h[3]*srcX[i] + h[4]*srcY[i] + h[5] - dstY[i]*w;
+		if(w>0 && ex*ex + ey*ey < t2*w*w)
+			count++;
+	}
+	return count;
+}
+
+int RansacVerifier::verify(const std::vector<cv::KeyPoint> &queryKeypoints, const std::vector<cv::KeyPoint> &trainKeypoints,
+		const std::vector<std::vector<cv::DMatch> > &matches)
+{
+	const int sampleSize = model==AFFINE ? 3 : 4;
+	numInliers = 0;
+	numIterations = 0;
+	randomState = RANSAC_SEED;
+	inliers.assign(matches.size(), 0);
+
+	//Sort the matches by distance, the best ones are sampled first
+	sortBuffer.clear();
+	for(size_t i=0; i<matches.size(); i++)
+		if(!matches[i].empty())
+			sortBuffer.push_back(std::make_pair(matches[i][0].distance, int(i)));
+	std::sort(sortBuffer.begin(), sortBuffer.end());
+
+	numPoints = sortBuffer.size();
+	if(numPoints<sampleSize)
+		return 0;
+	srcX.resize(numPoints);
+	srcY.resize(numPoints);
+	dstX.resize(numPoints);
+	dstY.resize(numPoints);
+	order.resize(numPoints);
+	for(int i=0; i<numPoints; i++){
+		const cv::DMatch &m = matches[sortBuffer[i].second][0];
+		order[i] = sortBuffer[i].second;
+		srcX[i] = queryKeypoints[m.queryIdx].pt.x;
+		srcY[i] = queryKeypoints[m.queryIdx].pt.y;
+		dstX[i] = trainKeypoints[m.trainIdx].pt.x;
+		dstY[i] = trainKeypoints[m.trainIdx].pt.y;
+	}
+
+	//PROSAC: the sampling set grows from the minimal sample to all matches
+	//within the first half of the iterations
+	const int growthIterations = std::max(1, maxIterations/2);
+	const double logFailure = log(1.0 - confidence);
+	int requiredIterations = maxIterations;
+	int bestCount = 0;
+	float h[9];
+	int sample[4];
+	for(int k=0; k<maxIterations && k<requiredIterations; k++){
+		numIterations++;
+		const int subset = std::min(numPoints, sampleSize + (k*(numPoints - sampleSize))/growthIterations);
+		drawSample(subset, sampleSize, sample);
+		const bool solved = model==AFFINE ? solveAffine(sample, h) : solveHomography(sample, h);
+		if(!solved)
+			continue;
+		const int count = countInliers(h);
+		if(count<=bestCount)
+			continue;
+		bestCount = count;
+		for(int i=0; i<9; i++)
+			transformation[i] = h[i];
+
+		//Early termination: the number of samples needed to draw an all inlier sample with the given confidence
+		const double inlierRatio = double(count)/numPoints;
+		const double allInlier = pow(inlierRatio, sampleSize);
+		if(allInlier>=1.0)
+			requiredIterations = 0;
+		else if(allInlier>0)
+			requiredIterations = std::min(maxIterations, int(ceil(logFailure/log(1.0 - allInlier))));
+	}
+
+	if(bestCount==0)
+		return 0;
+
+	//Flag the inliers of the best model
+	const float *t = transformation;
+	const float t2 = threshold*threshold;
+	for(int i=0; i<numPoints; i++){
+		const float w = t[6]*srcX[i] + t[7]*srcY[i] + t[8];
+		const float ex = t[0]*srcX[i] + t[1]*srcY[i] + t[2] - dstX[i]*w;
+		const float ey = t[3]*srcX[i] + t[4]*srcY[i] + t[5] - dstY[i]*w;
+		if(w>0 && ex*ex + ey*ey < t2*w*w){
+			inliers[order[i]] = 1;
+			numInliers++;
+		}
+	}
+	return numInliers;
+}
+
+void RansacVerifier::removeOutliers(std::vector<std::vector<cv::DMatch> > &matches) const
+{
+	for(size_t i=0; i<matches.size() && i<inliers.size(); i++)
+		if(!inliers[i])
+			matches[i].clear();
+}
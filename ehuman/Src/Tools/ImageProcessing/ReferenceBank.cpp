@@ -0,0 +1,281 @@
+#include "include/ReferenceBank.h"
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+
+static const char BANK_MAGIC[4] = {'B', 'R', 'K', 'B'};
+static const int BANK_VERSION = 2;
+
+//Saturating conversion to the range of a packed field
+static inline int clampTo(float value, int minValue, int maxValue)
+{
+	const int v = int(floor(value + 0.5f));
+	return v<minValue ? minValue : (v>maxValue ? maxValue : v);
+}
+
+bool ReferenceBankParameters::operator==(const ReferenceBankParameters &other) const
+{
+	return imageHash==other.imageHash && threshold==other.threshold && octaves==other.octaves &&
+		rotationInvariant==other.rotationInvariant && scaleInvariant==other.scaleInvariant &&
+		patternScale==other.patternScale && withSelection==other.withSelection;
+}
+
+unsigned long long ReferenceBankParameters::hashImage(const cv::Mat &image)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	const int size[2] = {image.rows, image.cols*int(image.elemSize())};
+	const unsigned char *bytes = (const unsigned char*)size;
+	for(size_t i=0; i<sizeof(size); i++)
+		hash = (hash ^ bytes[i])*1099511628211ull;
+	//Row by row, so the padding of the rows is not hashed
+	for(int r=0; r<size[0]; r++){
+		const unsigned char *row = image.ptr<unsigned char>(r);
+		for(int c=0; c<size[1]; c++)
+			hash = (hash ^ row[c])*1099511628211ull;
+	}
+	return hash;
+}
+
+ReferenceBank::ReferenceBank() :
+	numKeypoints(0), descriptorSize(0), rowStride(0), descriptorData(0), compactData(0)
+{
+	//ctor
+}
+
+ReferenceBank::~ReferenceBank()
+{
+	//dtor
+}
+
+void ReferenceBank::clear()
+{
+	parameters = ReferenceBankParameters();
+	numKeypoints = 0;
+	descriptorSize = 0;
+	rowStride = 0;
+	keypoints.clear();
+	descriptorStorage.clear();
+	descriptorData = 0;
+	selection.clear();
+	compactStorage.clear();
+	compactData = 0;
+}
+
+void ReferenceBank::build(const std::vector<cv::KeyPoint> &keypoints, const cv::Mat &descriptors, const ReferenceBankParameters &parameters)
+{
+	clear();
+	this->parameters = parameters;
+	//Only binary descriptors are supported
+	CV_Assert(int(keypoints.size())==descriptors.rows && descriptors.elemSize()==1);
+	if(keypoints.empty())
+		return;
+	numKeypoints = descriptors.rows;
+	descriptorSize = descriptors.cols;
+	rowStride = (descriptorSize + 63)/64*64;
+
+	this->keypoints.resize(numKeypoints);
+	for(int i=0; i<numKeypoints; i++){
+		const cv::KeyPoint &kp = keypoints[i];
+		PackedKeypoint &p = this->keypoints[i];
+		p.x = (short)clampTo(kp.pt.x*4, -32768, 32767);
+		p.y = (short)clampTo(kp.pt.y*4, -32768, 32767);
+		p.size = (unsigned char)clampTo(kp.size*2, 0, 255);
+		//The angle wraps around, so bin 256 is bin 0
+		p.angle = (unsigned char)(clampTo(kp.angle*256/360, 0, 256) & 255);
+		p.octave = (unsigned char)std::max(0, std::min(kp.octave, 255));
+		p.response = (unsigned char)clampTo(kp.response, 0, 255);
+	}
+
+	descriptorData = alignedBuffer(descriptorStorage, numKeypoints*rowStride);
+	memset(descriptorData, 0, numKeypoints*rowStride);
+	for(int i=0; i<numKeypoints; i++)
+		memcpy(descriptorData + i*rowStride, descriptors.data + descriptors.step*i, descriptorSize);
+
+	if(parameters.withSelection && descriptorSize*8>=SELECTED_BITS){
+		selectBits();
+		compactAll();
+	}
+}
+
+void ReferenceBank::selectBits()
+{
+	const int numBits = descriptorSize*8;
+	const int words = (numKeypoints + 63)/64;
+
+	//Transpose the descriptors, so every bit becomes a bit vector over all keypoints
+	std::vector<unsigned long long> columns(numBits*words, 0);
+	std::vector<int> ones(numBits, 0);
+	for(int i=0; i<numKeypoints; i++){
+		const unsigned char *d = descriptorData + i*rowStride;
+		for(int b=0; b<numBits; b++){
+			if(d[b>>3] & (1<<(b&7))){
+				columns[b*words + (i>>6)] |= 1ull<<(i&63);
+				ones[b]++;
+			}
+		}
+	}
+
+	//Order the bits by how close their mean is to 0.5
+	std::vector<std::pair<float, int> > order(numBits);
+	for(int b=0; b<numBits; b++)
+		order[b] = std::make_pair(float(fabs(float(ones[b])/numKeypoints - 0.5f)), b);
+	std::sort(order.begin(), order.end());
+
+	//Greedily add bits that are little correlated with the selected ones. The
+	//correlation limit is relaxed until enough bits have been found
+	std::vector<unsigned char> taken(numBits, 0);
+	for(float maxCorrelation=0.2f; int(selection.size())<SELECTED_BITS; maxCorrelation+=0.1f){
+		for(int k=0; k<numBits && int(selection.size())<SELECTED_BITS; k++){
+			const int b = order[k].second;
+			if(taken[b])
+				continue;
+			const float pb = float(ones[b])/numKeypoints;
+			bool correlated = false;
+			for(size_t s=0; s<selection.size() && !correlated; s++){
+				const int c = selection[s];
+				const float pc = float(ones[c])/numKeypoints;
+				const float variance = pb*(1-pb)*pc*(1-pc);
+				if(variance<=0){
+					//Constant bits carry no information, they are only taken when nothing else is left
+					correlated = maxCorrelation<1.0f;
+					continue;
+				}
+				int both = 0;
+				for(int w=0; w<words; w++)
+					both += __builtin_popcountll(columns[b*words + w] & columns[c*words + w]);
+				const float correlation = (float(both)/numKeypoints - pb*pc)/sqrt(variance);
+				if(fabs(correlation)>maxCorrelation)
+					correlated = true;
+			}
+			if(!correlated){
+				taken[b] = 1;
+				selection.push_back((unsigned short)b);
+			}
+		}
+	}
+}
+
+void ReferenceBank::compact(const unsigned char *descriptor, unsigned char *result) const
+{
+	memset(result, 0, COMPACT_SIZE);
+	for(int k=0; k<SELECTED_BITS; k++){
+		const int b = selection[k];
+		if(descriptor[b>>3] & (1<<(b&7)))
+			result[k>>3] |= (unsigned char)(1<<(k&7));
+	}
+}
+
+void ReferenceBank::compactAll()
+{
+	compactData = alignedBuffer(compactStorage, numKeypoints*COMPACT_SIZE);
+	for(int i=0; i<numKeypoints; i++)
+		compact(descriptorData + i*rowStride, compactData + i*COMPACT_SIZE);
+}
+
+void ReferenceBank::getKeypoints(std::vector<cv::KeyPoint> &keypoints) const
+{
+	keypoints.resize(numKeypoints);
+	for(int i=0; i<numKeypoints; i++){
+		const PackedKeypoint &p = this->keypoints[i];
+		keypoints[i] = cv::KeyPoint(p.x*0.25f, p.y*0.25f, p.size*0.5f, p.angle*360.0f/256, p.response, p.octave);
+	}
+}
+
+cv::Mat ReferenceBank::getDescriptors() const
+{
+	if(empty())
+		return cv::Mat();
+	return cv::Mat(numKeypoints, descriptorSize, CV_8U, descriptorData, rowStride);
+}
+
+bool ReferenceBank::save(const std::string &filename) const
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if(!out)
+		return false;
+	const int version = BANK_VERSION;
+	const int flags[5] = {parameters.threshold, parameters.octaves, int(parameters.rotationInvariant),
+		int(parameters.scaleInvariant), int(parameters.withSelection)};
+	const int header[3] = {numKeypoints, descriptorSize, int(selection.size())};
+	out.write(BANK_MAGIC, sizeof(BANK_MAGIC));
+	out.write((const char*)&version, sizeof(version));
+	out.write((const char*)&parameters.imageHash, sizeof(parameters.imageHash));
+	out.write((const char*)flags, 4*sizeof(int));
+	out.write((const char*)&parameters.patternScale, sizeof(parameters.patternScale));
+	out.write((const char*)&flags[4], sizeof(int));
+	out.write((const char*)header, sizeof(header));
+	if(!selection.empty())
+		out.write((const char*)&selection[0], selection.size()*sizeof(unsigned short));
+	if(numKeypoints>0)
+		out.write((const char*)&keypoints[0], numKeypoints*sizeof(PackedKeypoint));
+	for(int i=0; i<numKeypoints; i++)
+		out.write((const char*)descriptorData + i*rowStride, descriptorSize);
+	return out.good();
+}
+
+bool ReferenceBank::load(const std::string &filename, const ReferenceBankParameters &expected)
+{
+	clear();
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if(!in)
+		return false;
+	char magic[4];
+	int version = 0;
+	int flags[5];
+	int header[3];
+	ReferenceBankParameters stored;
+	in.read(magic, sizeof(magic));
+	in.read((char*)&version, sizeof(version));
+	if(!in || memcmp(magic, BANK_MAGIC, sizeof(magic))!=0 || version!=BANK_VERSION)
+		return false;
+	in.read((char*)&stored.imageHash, sizeof(stored.imageHash));
+	in.read((char*)flags, 4*sizeof(int));
+	in.read((char*)&stored.patternScale, sizeof(stored.patternScale));
+	in.read((char*)&flags[4], sizeof(int));
+	in.read((char*)header, sizeof(header));
+	if(!in)
+		return false;
+	stored.threshold = flags[0];
+	stored.octaves = flags[1];
+	stored.rotationInvariant = flags[2]!=0;
+	stored.scaleInvariant = flags[3]!=0;
+	stored.withSelection = flags[4]!=0;
+	//A bank of another image or other parameters is stale
+	if(stored!=expected)
+		return false;
+	const int count = header[0];
+	const int size = header[1];
+	const int numSelected = header[2];
+	if(count<0 || size<=0 || (numSelected!=0 && (numSelected!=SELECTED_BITS || size*8<SELECTED_BITS)))
+		return false;
+
+	selection.resize(numSelected);
+	if(numSelected>0)
+		in.read((char*)&selection[0], numSelected*sizeof(unsigned short));
+	keypoints.resize(count);
+	if(count>0)
+		in.read((char*)&keypoints[0], count*sizeof(PackedKeypoint));
+	rowStride = (size + 63)/64*64;
+	descriptorData = alignedBuffer(descriptorStorage, count*rowStride);
+	memset(descriptorData, 0, count*rowStride);
+	for(int i=0; i<count; i++)
+		in.read((char*)descriptorData + i*rowStride, size);
+	if(!in){
+		clear();
+		return false;
+	}
+	for(int k=0; k<numSelected; k++){
+		if(selection[k]>=size*8){
+			clear();
+			return false;
+		}
+	}
+
+	parameters = stored;
+	numKeypoints = count;
+	descriptorSize = size;
+	if(numSelected>0)
+		compactAll();
+	return true;
+}
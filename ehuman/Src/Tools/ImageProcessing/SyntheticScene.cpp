@@ -0,0 +1,386 @@
+#include "include/SyntheticScene.h"
+#include <algorithm>
+#include <math.h>
+
+//Orders the indices of keypoints by their x coordinate
+struct KeypointXLess
+{
+	const std::vector<cv::KeyPoint> &keypoints;
+	KeypointXLess(const std::vector<cv::KeyPoint> &keypoints) : keypoints(keypoints) {}
+	bool operator()(int a, int b) const {return keypoints[a].pt.x<keypoints[b].pt.x;}
+	bool operator()(int a, float x) const {return keypoints[a].pt.x<x;}
+};
+
+static void multiply(const double a[3][3], const double b[3][3], double result[3][3])
+{
+	for(int r=0; r<3; r++)
+		for(int c=0; c<3; c++)
+			result[r][c] = a[r][0]*b[0][c] + a[r][1]*b[1][c] + a[r][2]*b[2][c];
+}
+
+static inline unsigned char saturate(double value)
+{
+	return (unsigned char)(value<0 ? 0 : (value>255 ? 255 : value + 0.5));
+}
+
+//Fills the rectangle between two corners, which are both included
+static void fillRectangle(cv::Mat &image, int x0, int y0, int x1, int y1, unsigned char value)
+{
+	x0 = std::max(0, std::min(x0, x1));
+	y0 = std::max(0, std::min(y0, y1));
+	x1 = std::min(image.cols - 1, std::max(x0, x1));
+	y1 = std::min(image.rows - 1, std::max(y0, y1));
+	for(int y=y0; y<=y1; y++)
+	{
+		unsigned char *row = image.ptr<unsigned char>(y);
+		for(int x=x0; x<=x1; x++)
+			row[x] = value;
+	}
+}
+
+//Fills an ellipse with the half axes a and b, which is rotated by angle (in radians)
+static void fillEllipse(cv::Mat &image, int cx, int cy, int a, int b, double angle, unsigned char value)
+{
+	const double c = cos(angle), s = sin(angle);
+	const double a2 = double(a)*a, b2 = double(b)*b;
+	const int r = std::max(a, b);
+	for(int y=std::max(0, cy - r); y<=std::min(image.rows - 1, cy + r); y++)
+	{
+		unsigned char *row = image.ptr<unsigned char>(y);
+		for(int x=std::max(0, cx - r); x<=std::min(image.cols - 1, cx + r); x++)
+		{
+			const double u = (x - cx)*c + (y - cy)*s;
+			const double v = (y - cy)*c - (x - cx)*s;
+			if(u*u*b2 + v*v*a2<=a2*b2)
+				row[x] = value;
+		}
+	}
+}
+
+//Draws a line by filling all pixels whose centers are at most half the thickness away from it
+static void drawLine(cv::Mat &image, int x0, int y0, int x1, int y1, int thickness, unsigned char value)
+{
+	const double dx = x1 - x0, dy = y1 - y0;
+	const double length2 = dx*dx + dy*dy;
+	const double radius2 = thickness*thickness*0.25 + 0.25; //Diagonal lines of thickness 1 stay connected
+	const int margin = thickness/2 + 1;
+	for(int y=std::max(0, std::min(y0, y1) - margin); y<=std::min(image.rows - 1, std::max(y0, y1) + margin); y++)
+	{
+		unsigned char *row = image.ptr<unsigned char>(y);
+		for(int x=std::max(0, std::min(x0, x1) - margin); x<=std::min(image.cols - 1, std::max(x0, x1) + margin); x++)
+		{
+			const double t = length2>0 ? std::max(0., std::min(1., ((x - x0)*dx + (y - y0)*dy)/length2)) : 0.;
+			const double ex = x0 + t*dx - x, ey = y0 + t*dy - y;
+			if(ex*ex + ey*ey<=radius2)
+				row[x] = value;
+		}
+	}
+}
+
+//Warps an image with a homography and bilinear interpolation. Pixels without a source get the value border
+static void warp(const cv::Mat &image, const cv::Mat &homography, cv::Mat &result, unsigned char border)
+{
+	//The inverse homography (the adjugate, the scale does not matter) maps the result to the image
+	const double *h = homography.ptr<double>(0);
+	const double inverse[9] = {
+		h[4]*h[8] - h[5]*h[7], h[2]*h[7] - h[1]*h[8], h[1]*h[5] - h[2]*h[4],
+		h[5]*h[6] - h[3]*h[8], h[0]*h[8] - h[2]*h[6], h[2]*h[3] - h[0]*h[5],
+		h[3]*h[7] - h[4]*h[6], h[1]*h[6] - h[0]*h[7], h[0]*h[4] - h[1]*h[3]};
+	result.create(image.rows, image.cols, CV_8UC1);
+	for(int y=0; y<result.rows; y++)
+	{
+		unsigned char *row = result.ptr<unsigned char>(y);
+		for(int x=0; x<result.cols; x++)
+		{
+			const double w = inverse[6]*x + inverse[7]*y + inverse[8];
+			const double sx = (inverse[0]*x + inverse[1]*y + inverse[2])/w;
+			const double sy = (inverse[3]*x + inverse[4]*y + inverse[5])/w;
+			if(!(sx>=0 && sy>=0 && sx<image.cols - 1 && sy<image.rows - 1)){
+				row[x] = border;
+				continue;
+			}
+			const int ix = int(sx), iy = int(sy);
+			const double fx = sx - ix, fy = sy - iy;
+			const unsigned char *p = image.ptr<unsigned char>(iy) + ix;
+			const unsigned char *q = p + image.step;
+			row[x] = saturate((1 - fy)*((1 - fx)*p[0] + fx*p[1]) + fy*((1 - fx)*q[0] + fx*q[1]));
+		}
+	}
+}
+
+//Blurs an image with a Gaussian kernel, the border is replicated
+static void blur(cv::Mat &image, double sigma)
+{
+	const int radius = std::max(1, int(ceil(3*sigma)));
+	std::vector<double> kernel(2*radius + 1);
+	double sum = 0;
+	for(int i=-radius; i<=radius; i++)
+		sum += kernel[i + radius] = exp(-0.5*i*i/(sigma*sigma));
+	for(size_t i=0; i<kernel.size(); i++)
+		kernel[i] /= sum;
+
+	std::vector<double> rows(image.rows*image.cols);
+	for(int y=0; y<image.rows; y++)
+	{
+		const unsigned char *row = image.ptr<unsigned char>(y);
+		for(int x=0; x<image.cols; x++)
+		{
+			double value = 0;
+			for(int i=-radius; i<=radius; i++)
+				value += kernel[i + radius]*row[std::max(0, std::min(image.cols - 1, x + i))];
+			rows[y*image.cols + x] = value;
+		}
+	}
+	for(int y=0; y<image.rows; y++)
+	{
+		unsigned char *row = image.ptr<unsigned char>(y);
+		for(int x=0; x<image.cols; x++)
+		{
+			double value = 0;
+			for(int i=-radius; i<=radius; i++)
+				value += kernel[i + radius]*rows[std::max(0, std::min(image.rows - 1, y + i))*image.cols + x];
+			row[x] = saturate(value);
+		}
+	}
+}
+
+SyntheticScene::Parameters::Parameters() :
+	shapesPerMegapixel(1000), minShapeSize(4), maxShapeSize(60),
+	maxRotation(30), minScale(0.8f), maxScale(1.2f), maxTranslation(0.1f), maxPerspective(0.2f),
+	maxGain(0.2f), maxOffset(20), maxGradient(30), blurSigma(0.8f), noiseSigma(3)
+{
+	//ctor
+}
+
+SyntheticScene::SyntheticScene(unsigned seed, const Parameters &parameters) :
+	parameters(parameters), seed(seed)
+{
+	//ctor
+}
+
+uint64 SyntheticScene::Random::next()
+{
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state*0x2545F4914F6CDD1DULL;
+}
+
+int SyntheticScene::Random::uniform(int a, int b)
+{
+	return b>a ? a + int(next() % uint64(b - a)) : a;
+}
+
+double SyntheticScene::Random::uniform(double a, double b)
+{
+	//The upper 53 bits give a double in [0, 1)
+	return a + (b - a)*((next() >> 11)*(1.0/9007199254740992.0));
+}
+
+double SyntheticScene::Random::gaussian(double sigma)
+{
+	//Box-Muller with u1 in (0, 1]
+	const double u1 = ((next() >> 11) + 1)*(1.0/9007199254740992.0);
+	const double u2 = (next() >> 11)*(1.0/9007199254740992.0);
+	return sigma*sqrt(-2*log(u1))*cos(2*CV_PI*u2);
+}
+
+uint64 SyntheticScene::state(unsigned index, int width, int height, unsigned part) const
+{
+	//Mixes the inputs, so neighbouring indices and sizes give unrelated sequences
+	uint64 s = 0x9E3779B97F4A7C15ULL;
+	const uint64 inputs[5] = {seed, index, (uint64)width, (uint64)height, part};
+	for(int i=0; i<5; i++)
+	{
+		s ^= inputs[i] + 0x9E3779B97F4A7C15ULL + (s << 6) + (s >> 2);
+		s *= 0xBF58476D1CE4E5B9ULL;
+		s ^= s >> 31;
+	}
+	return s ? s : 1; //A state of 0 is not allowed
+}
+
+cv::Mat SyntheticScene::render(unsigned index, int width, int height) const
+{
+	Random random(state(index, width, height, 0));
+	cv::Mat image(height, width, CV_8UC1);
+
+	//Shaded background
+	const double base = random.uniform(60., 190.);
+	const double gx = random.uniform(-40., 40.)/width;
+	const double gy = random.uniform(-40., 40.)/height;
+	for(int y=0; y<height; y++)
+	{
+		unsigned char *row = image.ptr<unsigned char>(y);
+		for(int x=0; x<width; x++)
+			row[x] = saturate(base + gx*x + gy*y);
+	}
+
+	const int shapes = std::max(1, int(parameters.shapesPerMegapixel*width*height/1e6 + 0.5));
+	for(int i=0; i<shapes; i++)
+	{
+		const int px = random.uniform(0, width), py = random.uniform(0, height);
+		const int size = std::max(2, int(random.uniform(parameters.minShapeSize, parameters.maxShapeSize)));
+		const unsigned char color = (unsigned char)random.uniform(0, 256);
+		switch(random.uniform(0, 5))
+		{
+			case 0:
+				fillRectangle(image, px, py, px + size, py + random.uniform(size/3 + 1, size + 1), color);
+				break;
+			case 1:
+			{
+				const int b = random.uniform(size/6 + 1, size/2 + 1);
+				fillEllipse(image, px, py, size/2, b, random.uniform(0., CV_PI), color);
+				break;
+			}
+			case 2:
+			{
+				const int ex = px + random.uniform(-size, size + 1);
+				const int ey = py + random.uniform(-size, size + 1);
+				drawLine(image, px, py, ex, ey, random.uniform(1, 4), color);
+				break;
+			}
+			case 3:
+			{
+				//Checkerboard
+				const int cell = std::max(2, size/random.uniform(2, 6));
+				const unsigned char other = (unsigned char)random.uniform(0, 256);
+				for(int cy=0; cy*cell<size; cy++)
+					for(int cx=0; cx*cell<size; cx++)
+						fillRectangle(image, px + cx*cell, py + cy*cell, px + cx*cell + cell - 1, py + cy*cell + cell - 1, (cx + cy)%2 ? color : other);
+				break;
+			}
+			default:
+			{
+				//Patch of random cells
+				const int cell = std::max(1, size/random.uniform(3, 9));
+				for(int cy=0; cy*cell<size; cy++)
+					for(int cx=0; cx*cell<size; cx++)
+						fillRectangle(image, px + cx*cell, py + cy*cell, px + cx*cell + cell - 1, py + cy*cell + cell - 1, (unsigned char)random.uniform(0, 256));
+				break;
+			}
+		}
+	}
+	return image;
+}
+
+cv::Mat SyntheticScene::randomHomography(Random &random, int width, int height) const
+{
+	const double cx = width*0.5, cy = height*0.5;
+	const double angle = random.uniform(-parameters.maxRotation, parameters.maxRotation)*CV_PI/180;
+	const double scale = random.uniform(parameters.minScale, parameters.maxScale);
+	const double tx = random.uniform(-parameters.maxTranslation, parameters.maxTranslation)*width;
+	const double ty = random.uniform(-parameters.maxTranslation, parameters.maxTranslation)*height;
+	const double px = random.uniform(-parameters.maxPerspective, parameters.maxPerspective)/width;
+	const double py = random.uniform(-parameters.maxPerspective, parameters.maxPerspective)/height;
+
+	//Around the center: perspective, then rotation and scale, then translation
+	const double toCenter[3][3] = {{1, 0, -cx}, {0, 1, -cy}, {0, 0, 1}};
+	const double perspective[3][3] = {{1, 0, 0}, {0, 1, 0}, {px, py, 1}};
+	const double rotation[3][3] = {{scale*cos(angle), -scale*sin(angle), 0}, {scale*sin(angle), scale*cos(angle), 0}, {0, 0, 1}};
+	const double back[3][3] = {{1, 0, cx + tx}, {0, 1, cy + ty}, {0, 0, 1}};
+	double a[3][3], b[3][3], h[3][3];
+	multiply(perspective, toCenter, a);
+	multiply(rotation, a, b);
+	multiply(back, b, h);
+
+	cv::Mat homography(3, 3, CV_64F);
+	for(int r=0; r<3; r++)
+		for(int c=0; c<3; c++)
+			homography.at<double>(r, c) = h[r][c]/h[2][2];
+	return homography;
+}
+
+void SyntheticScene::addNoise(cv::Mat &image, Random &random) const
+{
+	if(parameters.noiseSigma<=0)
+		return;
+	for(int y=0; y<image.rows; y++)
+	{
+		unsigned char *row = image.ptr<unsigned char>(y);
+		for(int x=0; x<image.cols; x++)
+			row[x] = saturate(row[x] + random.gaussian(parameters.noiseSigma));
+	}
+}
+
+void SyntheticScene::generatePair(unsigned index, int width, int height, cv::Mat &first, cv::Mat &second, cv::Mat &homography) const
+{
+	const cv::Mat image = render(index, width, height);
+	Random random(state(index, width, height, 1));
+	homography = randomHomography(random, width, height);
+	warp(image, homography, second, 128);
+
+	//Lighting: contrast, brightness and a brightness gradient in a random direction
+	const double gain = 1 + random.uniform(-parameters.maxGain, parameters.maxGain);
+	const double offset = random.uniform(-parameters.maxOffset, parameters.maxOffset);
+	const double direction = random.uniform(0., 2*CV_PI);
+	const double gx = parameters.maxGradient*cos(direction)/width;
+	const double gy = parameters.maxGradient*sin(direction)/height;
+	for(int y=0; y<height; y++)
+	{
+		unsigned char *row = second.ptr<unsigned char>(y);
+		for(int x=0; x<width; x++)
+			row[x] = saturate(128 + (row[x] - 128)*gain + offset + gx*(x - width*0.5) + gy*(y - height*0.5));
+	}
+	if(parameters.blurSigma>0)
+		blur(second, parameters.blurSigma);
+
+	first = image;
+	addNoise(first, random);
+	addNoise(second, random);
+}
+
+bool SyntheticScene::project(const cv::Mat &homography, const cv::Point2f &point, cv::Point2f &result)
+{
+	const double *h = homography.ptr<double>(0);
+	const double w = h[6]*point.x + h[7]*point.y + h[8];
+	if(fabs(w)<1e-12)
+		return false;
+	result.x = float((h[0]*point.x + h[1]*point.y + h[2])/w);
+	result.y = float((h[3]*point.x + h[4]*point.y + h[5])/w);
+	return true;
+}
+
+MatchQuality SyntheticScene::evaluate(const std::vector<cv::KeyPoint> &keypoints1, const std::vector<cv::KeyPoint> &keypoints2,
+		const std::vector<cv::DMatch> &matches, const cv::Mat &homography, float tolerance)
+{
+	MatchQuality quality;
+	const float tolerance2 = tolerance*tolerance;
+
+	//Keypoints of the second image sorted by x, so only a window has to be searched
+	std::vector<int> order(keypoints2.size());
+	for(size_t i=0; i<order.size(); i++)
+		order[i] = int(i);
+	std::sort(order.begin(), order.end(), KeypointXLess(keypoints2));
+	for(size_t i=0; i<keypoints1.size(); i++)
+	{
+		cv::Point2f p;
+		if(!project(homography, keypoints1[i].pt, p))
+			continue;
+		std::vector<int>::const_iterator it = std::lower_bound(order.begin(), order.end(), p.x - tolerance, KeypointXLess(keypoints2));
+		for(; it!=order.end() && keypoints2[*it].pt.x<=p.x + tolerance; ++it)
+		{
+			const float dx = keypoints2[*it].pt.x - p.x;
+			const float dy = keypoints2[*it].pt.y - p.y;
+			if(dx*dx + dy*dy<=tolerance2){
+				quality.correspondences++;
+				break;
+			}
+		}
+	}
+
+	for(size_t i=0; i<matches.size(); i++)
+	{
+		const cv::DMatch &m = matches[i];
+		if(m.queryIdx<0 || m.queryIdx>=int(keypoints1.size()) || m.trainIdx<0 || m.trainIdx>=int(keypoints2.size()))
+			continue;
+		quality.matches++;
+		cv::Point2f p;
+		if(!project(homography, keypoints1[m.queryIdx].pt, p))
+			continue;
+		const float dx = keypoints2[m.trainIdx].pt.x - p.x;
+		const float dy = keypoints2[m.trainIdx].pt.y - p.y;
+		if(dx*dx + dy*dy<=tolerance2)
+			quality.correctMatches++;
+	}
+	return quality;
+}
@@ -43,6 +43,7 @@
 #include "agast/include/agast/oast9_16.h"
 #include "agast/include/agast/agast7_12s.h"
 #include "agast/include/agast/agast5_8.h"
+#include "Tools/Debugging/PerfCounters.h"
 #include <stdlib.h>
 #include <tmmintrin.h>
 
@@ -383,6 +384,8 @@ bool RoiPredicate(const float minX, const float minY,
 // computes the descriptor
 void BriskDescriptorExtractor::computeImpl(const Mat& image,
 		std::vector<KeyPoint>& keypoints, Mat& descriptors) const{
+	//Mostly the smoothedIntensity gathers
+	PerfCounters::Scope perfScope("computeImpl");
 
 	//Remove keypoints very close to the border
 	size_t ksize=keypoints.size();
@@ -586,6 +589,7 @@ BriskScaleSpace::~BriskScaleSpace(){
 }
 // construct the image pyramids
 void BriskScaleSpace::constructPyramid(const cv::Mat& image){
+	PerfCounters::Scope perfScope("constructPyramid");
 
 	// set correct size:
 	pyramid_.clear();
@@ -604,14 +608,17 @@ void BriskScaleSpace::constructPyramid(const cv::Mat& image){
 }
 //Gets the necessary keypoints for the algorithm
 void BriskScaleSpace::getKeypoints(const uint8_t _threshold, std::vector<cv::KeyPoint>& keypoints){
-	// make sure keypoints is empty
-	keypoints.resize(0);
-	keypoints.reserve(2000);
+	std::vector<std::vector<CvPoint> > agastPoints;
+	getAgastPoints(_threshold, agastPoints);
+	getKeypoints(agastPoints, keypoints);
+}
 
+void BriskScaleSpace::getAgastPoints(const uint8_t _threshold, std::vector<std::vector<CvPoint> >& agastPoints){
+	//The AGAST decision trees
+	PerfCounters::Scope perfScope("getAgastPoints");
 	// assign thresholds
 	threshold_=_threshold;
 	safeThreshold_ = threshold_*safetyFactor_;
-	std::vector<std::vector<CvPoint> > agastPoints;
 	agastPoints.resize(layers_);
 
 	// go through the octaves and intra layers and calculate fast corner scores:
@@ -622,6 +629,19 @@ void BriskScaleSpace::getKeypoints(const uint8_t _threshold, std::vector<cv::Key
 		//MC: Calculates the AGAST corner scores for each of the keypoints
 		l.getAgastPoints(safeThreshold_,agastPoints[i]);
 	}
+}
+
+void BriskScaleSpace::resetScores(){
+	for(uint8_t i = 0; i<layers_; i++)
+		pyramid_[i].resetScores();
+}
+
+void BriskScaleSpace::getKeypoints(const std::vector<std::vector<CvPoint> >& agastPoints, std::vector<cv::KeyPoint>& keypoints){
+	//The non-maximum suppression and refinement of the scores
+	PerfCounters::Scope perfScope("refineKeypoints");
+	// make sure keypoints is empty
+	keypoints.resize(0);
+	keypoints.reserve(2000);
 
 	if(layers_==1){
 		// just do a simple 2d subpixel refinement MC: for each detected maximum, a sub-pixel and continuous scale
@@ -1772,6 +1792,10 @@ void BriskLayer::getAgastPoints(uint8_t threshold, std::vector<CvPoint>& keypoin
 		#endif
 	}
 }
+//The scores depend on the threshold they were computed with
+void BriskLayer::resetScores(){
+	scores_=cv::Mat::zeros(img_.rows,img_.cols,CV_8U);
+}
 //This seems to be in a 3x3 layer
 inline uint8_t BriskLayer::getAgastScore(int x, int y, uint8_t threshold){
 	if(x<3||y<3) return 0;
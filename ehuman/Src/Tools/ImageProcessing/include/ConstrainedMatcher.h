@@ -0,0 +1,122 @@
+#ifndef CONSTRAINEDMATCHER_H
+#define CONSTRAINEDMATCHER_H
+
+#include <opencv2/opencv.hpp>
+#include "brisk.h"
+#include "ReferenceBank.h"
+#include <vector>
+
+/**
+ * The geometric window a match has to fall into. The two images are thought of
+ * as placed next to each other, so the column offset of a match is
+ * (imageCols - x1) + x2 and its angle is atan2(y2 - y1, offset).
+ * The defaults are the ones used by FeatureExtraction::verifyMatch.
+ */
+struct GeometricPrior
+{
+    GeometricPrior(int imageCols = 640, float minOffset = 640 - 200, float maxOffset = 640 + 200, float maxAngle = 10.0f) :
+        imageCols(imageCols), minOffset(minOffset), maxOffset(maxOffset), maxAngle(maxAngle) {}
+
+    int imageCols;  //Number of columns of the query image
+    float minOffset; //Minimum column offset of a match
+    float maxOffset; //Maximum column offset of a match
+    float maxAngle;  //Maximum absolute angle of a match in degrees
+};
+
+/**
+ * Brute force Hamming matcher for BRISK descriptors that applies the
+ * nearest neighbour ratio test and the mutual nearest neighbour (cross check)
+ * constraint while the distances are computed. Only the surviving matches
+ * are written to the output, so no post filtering is needed.
+ */
+class ConstrainedMatcher
+{
+    public:
+        /**
+         * @param maxDistance Matches with a Hamming distance of maxDistance or more are rejected
+         * @param ratio Ratio test threshold (best/second best). 0 disables the test
+         * @param crossCheck Only keep matches that are also the best match in the reverse direction
+         * @param bucketSize Edge length in pixels of the grid cells used by the geometric matching mode
+         */
+        ConstrainedMatcher(int maxDistance = 85, float ratio = 0.0f, bool crossCheck = false, int bucketSize = 32);
+        ~ConstrainedMatcher();
+
+        /**
+         * Matches every query descriptor against all train descriptors.
+         * If neither the ratio test nor the cross check is enabled this behaves like
+         * a radius match: every train descriptor closer than maxDistance is returned,
+         * sorted by distance. Otherwise only the best match of a query survives.
+         * Queries without a surviving match produce no entry in matches.
+         */
+        void match(const cv::Mat &queryDescriptors, const cv::Mat &trainDescriptors, std::vector<std::vector<cv::DMatch> > &matches);
+
+        /**
+         * Same as match(), but a query is only compared against the train descriptors
+         * whose keypoints lie inside the window allowed by the geometric prior.
+         * The train keypoints are bucketed into a grid first, so the Hamming
+         * distances to keypoints outside the window are never computed.
+         * The keypoints must correspond row by row to the descriptors.
+         */
+        void match(const cv::Mat &queryDescriptors, const std::vector<cv::KeyPoint> &queryKeypoints,
+                   const cv::Mat &trainDescriptors, const std::vector<cv::KeyPoint> &trainKeypoints,
+                   const GeometricPrior &prior, std::vector<std::vector<cv::DMatch> > &matches);
+
+        /**
+         * Enables the two stage matching against the descriptors of a reference bank.
+         * A pair is first compared on the bits selected by the bank and only if that
+         * coarse distance is at most coarseMaxDistance the full distance is computed.
+         * The train descriptors passed to match() must then be the ones of the bank.
+         * @param bank The reference bank, 0 disables the coarse stage
+         */
+        void setCoarseStage(const ReferenceBank *bank, int coarseMaxDistance);
+
+        int maxDistance;
+        float ratio;
+        bool crossCheck;
+        int bucketSize;
+
+        //Number of full Hamming distances computed by the last call of match()
+        int numComparisons;
+        //Number of coarse distances computed by the last call of match()
+        int numCoarseComparisons;
+
+    protected:
+    private:
+        //Resets the nearest neighbour bookkeeping for a new matching run
+        void prepare(int numQuery, int numTrain);
+        //Records the distance d between query q and train t
+        inline void accumulate(int q, int t, int d, std::vector<cv::DMatch> &candidates);
+        //Writes the matches that satisfy every enabled constraint
+        void emit(int numQuery, std::vector<std::vector<cv::DMatch> > &matches);
+        //Computes the compact query descriptors for the coarse stage
+        void prepareCoarseStage(const cv::Mat &queryDescriptors, int numTrain);
+        //Whether the pair passes the coarse stage (always true if it is disabled)
+        inline bool passesCoarseStage(int q, int t);
+        //Sorts the train keypoints into the grid cells
+        void buildGrid(const std::vector<cv::KeyPoint> &trainKeypoints);
+
+        //The best and second best train match of every query
+        std::vector<int> bestTrain;
+        std::vector<int> bestTrainDistance;
+        std::vector<int> secondTrainDistance;
+        //The best query match of every train descriptor (for the cross check)
+        std::vector<int> bestQuery;
+        std::vector<int> bestQueryDistance;
+
+        //The grid of train keypoints. The indices of cell c are
+        //cellIndices[cellStart[c]] ... cellIndices[cellStart[c+1]-1]
+        int gridCols;
+        int gridRows;
+        std::vector<int> cellStart;
+        std::vector<int> cellIndices;
+
+        //The coarse stage
+        const ReferenceBank *coarseBank;
+        int coarseMaxDistance;
+        std::vector<unsigned char> queryCompactStorage;
+        unsigned char *queryCompact;
+
+        cv::HammingSse hamming;
+};
+
+#endif // CONSTRAINEDMATCHER_H
@@ -24,7 +24,8 @@ class FeatureExtraction
         cv::Ptr<cv::FeatureDetector> getDetector(int argc, string feat_detector, cv::Ptr<cv::FeatureDetector> detector, int threshold, int testThreshold, int testFlag);
 
         //Verfify that the matches are indeed correct
-        void performMatchingValidation(const cv::Mat & image, std::vector<cv::KeyPoint> &keypoints, std::vector<cv::KeyPoint> &keypoints2, std::vector<std::vector<cv::DMatch> > &matches, bool hamming);
+        //ratioTested skips the KNN ratio check when the matcher already applied it (see ConstrainedMatcher)
+        void performMatchingValidation(const cv::Mat & image, std::vector<cv::KeyPoint> &keypoints, std::vector<cv::KeyPoint> &keypoints2, std::vector<std::vector<cv::DMatch> > &matches, bool hamming, bool ratioTested = false);
         bool verifyMatch(const cv::Mat &image, cv::KeyPoint &keypoint1, cv::KeyPoint &keypoint2);
         void verifyKNNMatches(std::vector<cv::DMatch>  &matches);
         void verifyMatchingOrder(const cv::Mat & image,cv::Mat descriptors, cv::Mat descriptors2, std::vector<std::vector<cv::DMatch> > &matches);
@@ -37,6 +38,8 @@ class FeatureExtraction
         int totalNumMatches;
         int totalNumInvalidMatches;
         int totalNumBestMatches;
+        //The best/second best distance ratio above which verifyKNNMatches rejects a match
+        float knnRatio;
         //Stores the incorrect matches
     	std::vector<cv::Point2f> leftPoints;
     	std::vector<cv::Point2f> rightPoints;
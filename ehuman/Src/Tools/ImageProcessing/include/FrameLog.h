@@ -0,0 +1,145 @@
+#ifndef FRAMELOG_H
+#define FRAMELOG_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+/**
+ * The metadata of a logged frame. It is stored in front of the pixels.
+ */
+struct FrameHeader
+{
+    enum Format
+    {
+        GREY = 0,   //One byte per pixel
+        YUV422 = 1  //Y0 U Y1 V per two pixels, as delivered by the camera
+    };
+
+    unsigned timestamp;     //In ms
+    int width;
+    int height;
+    int format;
+    float cameraMatrix[12]; //Rotation (column major) and translation in mm
+    float odometry[3];      //Accumulated odometry: x and y in mm, rotation in radians
+    unsigned dataSize;      //Bytes of pixels that follow the header
+};
+
+/**
+ * The entry of a frame in the index of a frame log
+ */
+struct FrameIndexEntry
+{
+    int chunk;
+    unsigned offset;        //Offset of the FrameHeader in the uncompressed chunk
+    unsigned timestamp;
+};
+
+/**
+ * The entry of a chunk in the index of a frame log
+ */
+struct ChunkIndexEntry
+{
+    long long offset;       //File offset of the chunk data
+    unsigned storedSize;    //Bytes in the file
+    unsigned rawSize;       //Bytes after decompression, equal to storedSize if not compressed
+};
+
+/**
+ * Writes raw frames and their metadata to a chunked log. Frames are collected
+ * into chunks of framesPerChunk frames, each chunk is optionally compressed
+ * (LZ4 block format) and the index of all chunks and frames is appended on close().
+ *
+ * File layout (native byte order): magic "BFLG", int version, the chunks, the chunk
+ * index, the frame index and a trailer of long long index offset, int number of
+ * chunks, int number of frames and magic "BFLI". Chunks in the file and frames in
+ * the uncompressed chunks start on 16 byte boundaries.
+ */
+class FrameLogWriter
+{
+    public:
+        FrameLogWriter();
+        ~FrameLogWriter();
+
+        /** Returns false if the file could not be created */
+        bool open(const std::string &filename, int framesPerChunk = 16, bool compress = false);
+
+        /** Appends a frame. header.dataSize bytes are read from data */
+        bool addFrame(const FrameHeader &header, const unsigned char *data);
+
+        /** Appends a grey or YUV422 image with default metadata and the given timestamp */
+        bool addImage(const cv::Mat &image, unsigned timestamp);
+
+        /** Writes the last chunk and the index. Returns false if anything could not be written */
+        bool close();
+
+    protected:
+    private:
+        FrameLogWriter(const FrameLogWriter&);
+        FrameLogWriter& operator=(const FrameLogWriter&);
+
+        bool flushChunk();
+
+        FILE *file;
+        long long offset;
+        int framesPerChunk;
+        bool compress;
+        bool failed;
+        int framesInChunk;
+        std::vector<unsigned char> chunk;
+        std::vector<unsigned char> compressed;
+        std::vector<ChunkIndexEntry> chunks;
+        std::vector<FrameIndexEntry> frames;
+};
+
+/**
+ * Reads a frame log written by FrameLogWriter. The file is mapped into memory, so
+ * frames of uncompressed chunks are accessed without copying. Compressed chunks are
+ * decompressed on access; the last decompressed chunk is kept, so sequential reading
+ * decompresses every chunk once.
+ */
+class FrameLogReader
+{
+    public:
+        FrameLogReader();
+        ~FrameLogReader();
+
+        /** Maps a log into memory and reads its index. Returns false and leaves the reader closed on failure */
+        bool open(const std::string &filename);
+        void close();
+
+        bool isOpen() const {return data!=0;}
+        int size() const {return int(frames.size());}
+
+        /**
+         * Returns the header of frame i, or 0 if the frame cannot be read. The pixels
+         * follow the header. The pointer is valid until another frame is requested.
+         */
+        const FrameHeader* getFrame(int i);
+
+        /** The index of the first frame whose timestamp is not less than timestamp */
+        int findFrame(unsigned timestamp) const;
+
+        /**
+         * The luminance of frame i. Grey frames are not copied, i.e. the image is only
+         * valid until another frame is requested. Returns false if the frame cannot be read.
+         */
+        bool getGrey(int i, cv::Mat &image);
+
+    protected:
+    private:
+        FrameLogReader(const FrameLogReader&);
+        FrameLogReader& operator=(const FrameLogReader&);
+
+        const unsigned char *data;
+        size_t fileSize;
+        std::vector<ChunkIndexEntry> chunks;
+        std::vector<FrameIndexEntry> frames;
+
+        //The last decompressed chunk
+        int cachedChunk;
+        std::vector<unsigned char> cache;
+};
+
+#endif // FRAMELOG_H
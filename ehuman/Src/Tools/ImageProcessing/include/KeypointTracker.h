@@ -0,0 +1,81 @@
+#ifndef KEYPOINTTRACKER_H
+#define KEYPOINTTRACKER_H
+
+#include <opencv2/opencv.hpp>
+#include "brisk.h"
+#include <vector>
+
+/**
+ * Carries the verified matches of the previous frame to the next one.
+ * Every track stores where its live keypoint was seen together with the
+ * reference keypoint and reference descriptor it was matched to. After the
+ * tracks have been moved to their predicted positions, only the live keypoints
+ * inside a small window around a prediction have to be described, and they are
+ * only compared against the descriptors of the tracks whose window they lie in.
+ */
+class KeypointTracker
+{
+    public:
+        /**
+         * @param windowRadius Radius in pixels of the search window around a predicted position
+         * @param minTracks Tracking is only used if at least this many tracks exist
+         * @param minTrackedRatio Tracking is given up if fewer than this fraction of the tracks are found again
+         */
+        KeypointTracker(float windowRadius = 12.0f, int minTracks = 8, float minTrackedRatio = 0.5f);
+        ~KeypointTracker();
+
+        /** Whether there are enough tracks to skip the full matching */
+        bool isTracking() const;
+
+        /** Drops all tracks, so the next frame is matched from scratch */
+        void reset();
+
+        /** Moves all tracks by the predicted image motion */
+        void predict(float dx, float dy);
+
+        /** Removes all keypoints that are not inside the window of any track */
+        void selectKeypoints(std::vector<cv::KeyPoint> &keypoints) const;
+
+        /**
+         * Matches the live descriptors against the tracks whose window contains the live keypoint.
+         * The trainIdx of the resulting matches refers to referenceKeypoints/referenceDescriptors.
+         * @return false if too few tracks were found again and the full matching should be used
+         */
+        bool match(const cv::Mat &queryDescriptors, const std::vector<cv::KeyPoint> &queryKeypoints,
+                   int maxDistance, std::vector<std::vector<cv::DMatch> > &matches);
+
+        /**
+         * Replaces the tracks by the verified matches of this frame.
+         * Empty entries of matches are skipped.
+         */
+        void update(const std::vector<cv::KeyPoint> &queryKeypoints, const std::vector<cv::KeyPoint> &trainKeypoints,
+                    const cv::Mat &trainDescriptors, const std::vector<std::vector<cv::DMatch> > &matches);
+
+        float windowRadius;
+        int minTracks;
+        float minTrackedRatio;
+
+        //The reference side of the tracks, row i belongs to track i
+        std::vector<cv::KeyPoint> referenceKeypoints;
+        cv::Mat referenceDescriptors;
+
+    protected:
+    private:
+        //The predicted live positions of the tracks
+        std::vector<cv::Point2f> positions;
+
+        //Temporary buffers for update(), kept to avoid reallocations
+        std::vector<cv::Point2f> newPositions;
+        std::vector<cv::KeyPoint> newKeypoints;
+        cv::Mat newDescriptors;
+
+        //The best live keypoint of every track and the best track of every live keypoint during match()
+        std::vector<int> bestQuery;
+        std::vector<int> bestDistance;
+        std::vector<int> bestTrack;
+        std::vector<int> bestTrackDistance;
+
+        cv::HammingSse hamming;
+};
+
+#endif // KEYPOINTTRACKER_H
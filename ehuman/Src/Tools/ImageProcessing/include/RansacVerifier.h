@@ -0,0 +1,82 @@
+#ifndef RANSACVERIFIER_H
+#define RANSACVERIFIER_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/**
+ * Geometric verification of keypoint matches with PROSAC (progressive sample
+ * consensus). The matches are sorted by descriptor distance and the minimal
+ * samples are drawn from a growing set of the best matches, so a good model is
+ * usually found within a few iterations. The inliers of every hypothesis are
+ * counted with SSE over all matches and the iteration stops as soon as the
+ * required confidence is reached.
+ * All buffers are members that only grow, so the verification does not allocate
+ * memory once it has seen the largest match set.
+ */
+class RansacVerifier
+{
+    public:
+        enum Model
+        {
+            AFFINE,    //6 degrees of freedom, 3 point minimal sample
+            HOMOGRAPHY //8 degrees of freedom, 4 point minimal sample
+        };
+
+        /**
+         * @param model The transformation that is estimated
+         * @param threshold Maximum reprojection error of an inlier in pixels
+         * @param maxIterations Maximum number of hypotheses
+         * @param confidence Probability of having drawn at least one outlier free sample at which the search stops
+         */
+        RansacVerifier(Model model = AFFINE, float threshold = 3.0f, int maxIterations = 200, float confidence = 0.99f);
+        ~RansacVerifier();
+
+        /**
+         * Estimates the transformation from the query keypoints to the train keypoints.
+         * The first match of every entry of matches is used (as produced by ConstrainedMatcher).
+         * @return The number of inliers of the best model. 0 if there were not enough matches.
+         */
+        int verify(const std::vector<cv::KeyPoint> &queryKeypoints, const std::vector<cv::KeyPoint> &trainKeypoints,
+                   const std::vector<std::vector<cv::DMatch> > &matches);
+
+        /** Removes all matches that are not inliers of the best model */
+        void removeOutliers(std::vector<std::vector<cv::DMatch> > &matches) const;
+
+        Model model;
+        float threshold;
+        int maxIterations;
+        float confidence;
+
+        //The result of the last verification
+        float transformation[9];          //Row major 3x3 matrix mapping query to train coordinates
+        int numInliers;
+        int numIterations;
+        std::vector<unsigned char> inliers; //One flag per entry of matches
+
+    protected:
+    private:
+        //Computes the model from the minimal sample. Returns false if the sample is degenerate
+        bool solveAffine(const int *sample, float *h) const;
+        bool solveHomography(const int *sample, float *h) const;
+        //Counts the inliers of a model over all matches using SSE
+        int countInliers(const float *h) const;
+        //Draws size distinct indices out of [0, n)
+        void drawSample(int n, int size, int *sample);
+        //Simple deterministic linear congruential generator, so results are reproducible
+        inline unsigned int nextRandom();
+
+        //The matched coordinates as structure of arrays, sorted by descriptor distance
+        std::vector<float> srcX;
+        std::vector<float> srcY;
+        std::vector<float> dstX;
+        std::vector<float> dstY;
+        //Maps the sorted position back to the entry in matches
+        std::vector<int> order;
+        std::vector<std::pair<float, int> > sortBuffer;
+        int numPoints;
+
+        unsigned int randomState;
+};
+
+#endif // RANSACVERIFIER_H
@@ -0,0 +1,144 @@
+#ifndef REFERENCEBANK_H
+#define REFERENCEBANK_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Returns a pointer into storage that is aligned to 64 bytes (a cache line) and
+ * points to at least size bytes. storage is resized as needed.
+ */
+inline unsigned char* alignedBuffer(std::vector<unsigned char> &storage, size_t size)
+{
+    storage.resize(size + 63);
+    return (unsigned char*)(((size_t)&storage[0] + 63) & ~(size_t)63);
+}
+
+/**
+ * A keypoint of the reference bank in 8 bytes instead of the 28 bytes of a cv::KeyPoint
+ */
+struct PackedKeypoint
+{
+    short x;                //Column in 1/4 pixels
+    short y;                //Row in 1/4 pixels
+    unsigned char size;     //Diameter in 1/2 pixels, saturated at 255
+    unsigned char angle;    //Orientation in 256 bins of 360/256 degrees
+    unsigned char octave;
+    unsigned char response; //Detector score, saturated at 255
+};
+
+/**
+ * The reference image and the parameters a bank was built from. A bank file is only
+ * used if they are the same as the ones of the reader, otherwise it is stale
+ */
+struct ReferenceBankParameters
+{
+    unsigned long long imageHash; //See hashImage()
+    int threshold;                //Of the BRISK detector
+    int octaves;                  //Of the BRISK detector
+    bool rotationInvariant;       //Of the BRISK extractor
+    bool scaleInvariant;          //Of the BRISK extractor
+    float patternScale;           //Of the BRISK extractor
+    bool withSelection;           //Select the most discriminative bits for the coarse stage
+
+    ReferenceBankParameters() :
+        imageHash(0), threshold(0), octaves(0), rotationInvariant(true), scaleInvariant(true),
+        patternScale(1.0f), withSelection(true) {}
+
+    bool operator==(const ReferenceBankParameters &other) const;
+    bool operator!=(const ReferenceBankParameters &other) const {return !(*this==other);}
+
+    /** A 64 bit FNV-1a hash of the size and the pixels of a grayscale image */
+    static unsigned long long hashImage(const cv::Mat &image);
+};
+
+/**
+ * Compact storage of the keypoints and BRISK descriptors of a reference image.
+ * The descriptors are kept in one array whose rows start on 64 byte boundaries,
+ * so they can be compared with the aligned SSE Hamming distance without copying.
+ * Optionally the 256 most discriminative descriptor bits are selected. Their
+ * compact 32 byte descriptors allow a coarse matching stage that only computes
+ * the full distance for the candidates that are close in the selected bits
+ * (see ConstrainedMatcher::setCoarseStage).
+ *
+ * Banks are generated offline with the referenceBankBuilder (Src/Utils/ReferenceBankBuilder).
+ *
+ * File layout (native byte order): magic "BRKB", int version, the parameters (unsigned
+ * long long image hash, int threshold, int octaves, int rotation invariant, int scale
+ * invariant, float pattern scale, int with selection), int number of keypoints,
+ * int descriptor size, int number of selected bits, the selected bit indices as
+ * unsigned shorts, the packed keypoints and the descriptors without padding.
+ */
+class ReferenceBank
+{
+    public:
+        static const int SELECTED_BITS = 256;
+        static const int COMPACT_SIZE = SELECTED_BITS/8;
+
+        ReferenceBank();
+        ~ReferenceBank();
+
+        /**
+         * Packs the keypoints and copies the descriptors (one row per keypoint).
+         * @param parameters The image and the parameters the keypoints and descriptors were computed
+         *                   with. If withSelection is set, the most discriminative bits are also selected
+         */
+        void build(const std::vector<cv::KeyPoint> &keypoints, const cv::Mat &descriptors, const ReferenceBankParameters &parameters);
+
+        /** Writes the bank to a file. Returns false if the file could not be written */
+        bool save(const std::string &filename) const;
+
+        /**
+         * Reads a bank written by save(). Returns false and leaves the bank empty on failure,
+         * including a bank that was built from another image or with other parameters
+         */
+        bool load(const std::string &filename, const ReferenceBankParameters &expected);
+
+        void clear();
+        bool empty() const {return numKeypoints==0;}
+        int size() const {return numKeypoints;}
+        bool hasSelection() const {return !selection.empty();}
+        const ReferenceBankParameters& getParameters() const {return parameters;}
+
+        /** Unpacks the keypoints into cv::KeyPoints */
+        void getKeypoints(std::vector<cv::KeyPoint> &keypoints) const;
+
+        /** A cv::Mat header on the aligned descriptor array. The data is not copied */
+        cv::Mat getDescriptors() const;
+
+        /** The compact descriptor of keypoint i. Only valid if hasSelection() */
+        const unsigned char* compactDescriptor(int i) const {return compactData + i*COMPACT_SIZE;}
+
+        /** Extracts the selected bits of a full descriptor into COMPACT_SIZE bytes */
+        void compact(const unsigned char *descriptor, unsigned char *result) const;
+
+        std::vector<PackedKeypoint> keypoints;
+
+    protected:
+    private:
+        //The data pointers point into the storage vectors, so the bank is not copied
+        ReferenceBank(const ReferenceBank&);
+        ReferenceBank& operator=(const ReferenceBank&);
+
+        //Chooses the bits that are set in about half of the descriptors and are
+        //little correlated with the bits chosen before (as for ORB)
+        void selectBits();
+        //Computes the compact descriptors of all keypoints
+        void compactAll();
+
+        ReferenceBankParameters parameters;
+        int numKeypoints;
+        int descriptorSize;
+        int rowStride; //Descriptor size rounded up to 64 bytes
+
+        std::vector<unsigned char> descriptorStorage;
+        unsigned char *descriptorData;
+
+        //The indices of the selected bits in the full descriptor
+        std::vector<unsigned short> selection;
+        std::vector<unsigned char> compactStorage;
+        unsigned char *compactData;
+};
+
+#endif // REFERENCEBANK_H
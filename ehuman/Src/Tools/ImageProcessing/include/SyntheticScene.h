@@ -0,0 +1,107 @@
+#ifndef SYNTHETICSCENE_H
+#define SYNTHETICSCENE_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/**
+ * The quality of matches between two images with a known homography
+ */
+struct MatchQuality
+{
+    int correspondences;    //Keypoints of the first image with a keypoint of the second image at their projection
+    int matches;
+    int correctMatches;     //Matches whose keypoints are at most the tolerance apart after the projection
+
+    MatchQuality() : correspondences(0), matches(0), correctMatches(0) {}
+
+    float precision() const {return matches>0 ? float(correctMatches)/matches : 0.f;}
+    float recall() const {return correspondences>0 ? float(correctMatches)/correspondences : 0.f;}
+};
+
+/**
+ * A generator of reproducible grey image pairs for benchmarks and tests without
+ * recorded images. The first image of a pair is a textured scene of rectangles,
+ * ellipses, lines, checkerboards and random patches on a shaded background. The second
+ * image is the first one warped with a random homography, with a different lighting,
+ * blurred and with noise. The homography is returned, so matches can be checked
+ * against the ground truth.
+ *
+ * A pair only depends on the seed, its index, the size and the parameters. The random
+ * numbers, the drawing, the warping and the blur are computed here rather than with
+ * OpenCV, so the images do not change with the OpenCV version and can be used for golden
+ * files (see Utils/BriskGolden). The number of shapes is proportional to the image area
+ * and their sizes are given in pixels, so the density of keypoints is about the same at
+ * all sizes, e.g. from 160x120 to 3840x2160.
+ */
+class SyntheticScene
+{
+    public:
+        struct Parameters
+        {
+            float shapesPerMegapixel;
+            float minShapeSize;     //In pixels
+            float maxShapeSize;
+            float maxRotation;      //In degrees
+            float minScale;
+            float maxScale;
+            float maxTranslation;   //Relative to the image size
+            float maxPerspective;   //Change of the scale from one border to the other, e.g. 0.2 for 20%
+            float maxGain;          //Relative change of the contrast
+            float maxOffset;        //Change of the brightness in grey values
+            float maxGradient;      //Change of the brightness from one border to the other in grey values
+            float blurSigma;        //Of the second image, in pixels
+            float noiseSigma;       //Of both images, in grey values
+
+            Parameters();
+        };
+
+        SyntheticScene(unsigned seed = 0x5eed, const Parameters &parameters = Parameters());
+
+        /** Renders the first image of pair index without noise */
+        cv::Mat render(unsigned index, int width, int height) const;
+
+        /**
+         * Generates pair index.
+         * @param homography 3x3 CV_64F matrix that maps points of the first image to the second one
+         */
+        void generatePair(unsigned index, int width, int height, cv::Mat &first, cv::Mat &second, cv::Mat &homography) const;
+
+        /** Projects a point with a homography. Returns false if it is projected to infinity */
+        static bool project(const cv::Mat &homography, const cv::Point2f &point, cv::Point2f &result);
+
+        /**
+         * Checks matches (queryIdx in keypoints1, trainIdx in keypoints2) against the
+         * homography between the images
+         * @param tolerance Maximum distance in pixels between a projected keypoint and its match
+         */
+        static MatchQuality evaluate(const std::vector<cv::KeyPoint> &keypoints1, const std::vector<cv::KeyPoint> &keypoints2,
+                const std::vector<cv::DMatch> &matches, const cv::Mat &homography, float tolerance = 2.5f);
+
+        Parameters parameters;
+
+    protected:
+    private:
+        //A xorshift64* generator of random numbers
+        class Random
+        {
+            public:
+                Random(uint64 state) : state(state) {}
+                uint64 next();
+                int uniform(int a, int b);              //In [a, b)
+                double uniform(double a, double b);     //In [a, b)
+                double gaussian(double sigma);
+
+            private:
+                uint64 state;
+        };
+
+        //The state of the random number generator of a part of pair index
+        uint64 state(unsigned index, int width, int height, unsigned part) const;
+        cv::Mat randomHomography(Random &random, int width, int height) const;
+        void addNoise(cv::Mat &image, Random &random) const;
+
+        unsigned seed;
+};
+
+#endif // SYNTHETICSCENE_H
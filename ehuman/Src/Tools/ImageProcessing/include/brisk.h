@@ -195,6 +195,8 @@ struct BriskLongPair{
 
 		// Fast/Agast without non-max suppression
 		void getAgastPoints(uint8_t threshold, std::vector<CvPoint>& keypoints);
+		// forget the scores cached by previous detections
+		void resetScores();
 
 		// get scores - attention, this is in layer coordinates, not scale=1 coordinates!
 		inline uint8_t getAgastScore(int x, int y, uint8_t threshold);
@@ -240,6 +242,14 @@ struct BriskLongPair{
 		// get Keypoints
 		void getKeypoints(const uint8_t _threshold, std::vector<cv::KeyPoint>& keypoints);
 
+		// the two steps of getKeypoints, so they can be timed separately:
+		// the AGAST corners of all layers (the pyramid must have been constructed)
+		void getAgastPoints(const uint8_t _threshold, std::vector<std::vector<CvPoint> >& agastPoints);
+		// the non-maximum suppression and the refinement of the corners found by getAgastPoints
+		void getKeypoints(const std::vector<std::vector<CvPoint> >& agastPoints, std::vector<cv::KeyPoint>& keypoints);
+		// forget the scores cached in the layers, so the pyramid can be reused with another threshold
+		void resetScores();
+
 	protected:
 		// nonmax suppression:
 		__inline__ bool isMax2D(const uint8_t layer,
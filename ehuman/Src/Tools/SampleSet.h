@@ -0,0 +1,90 @@
+/**
+* @file SampleSet.h
+* The file contains the definition of the class SampleSet and of the samples of
+* the SelfLocator.
+*
+* SampleSet<SelfLocatorSample> is specialized in SelfLocatorSampleSet.h, which is
+* included at the end of this file, so every translation unit that uses the samples
+* of the SelfLocator, e.g. the sensor models and the pose calculators, sees the
+* specialization.
+*/
+
+#pragma once
+
+#include "Tools/Math/Pose2D.h"
+
+/**
+* @class SelfLocatorSample
+* A sample of the SelfLocator.
+*/
+class SelfLocatorSample
+{
+public:
+  Vector2<int> translation; /**< The position in mm. */
+  Vector2<int> rotation; /**< Cosine and sine of the rotation * 1024. */
+  float angle; /**< The rotation in radians. */
+  float weighting; /**< The weighting of the sample. */
+  int cluster; /**< The index of the cluster the sample belongs to. */
+
+  SelfLocatorSample() : angle(0), weighting(1.f), cluster(0) {}
+
+  /** The pose of the sample. */
+  Pose2D toPose() const {return Pose2D(angle, (float) translation.x, (float) translation.y);}
+};
+
+/**
+* @class SampleSet
+* A container for samples. Two independent sets of samples are maintained. The
+* current set is accessed through at(). The other set is returned by swap().
+*/
+template<class T> class SampleSet
+{
+private:
+  T* current; /**< The current set of samples. */
+  T* other; /**< The other set of samples. */
+  int numberOfSamples; /**< The number of samples in both sets. */
+
+  SampleSet(const SampleSet&);
+  SampleSet& operator=(const SampleSet&);
+
+public:
+  /**
+  * Constructor.
+  * @param numberOfSamples The number of samples in both sets.
+  */
+  SampleSet(int numberOfSamples) :
+    current(new T[numberOfSamples]), other(new T[numberOfSamples]), numberOfSamples(numberOfSamples) {}
+
+  /** Destructor. */
+  ~SampleSet()
+  {
+    delete [] current;
+    delete [] other;
+  }
+
+  /**
+  * The function exchanges the current and the other set.
+  * @return The set that was current before.
+  */
+  T* swap()
+  {
+    T* temp = current;
+    current = other;
+    other = temp;
+    return other;
+  }
+
+  /** Access to sample i. */
+  T& at(int i) {return current[i];}
+
+  /** Constant access to sample i. */
+  const T& at(int i) const {return current[i];}
+
+  /** Assigns sample i to a cluster. */
+  void setCluster(int i, int cluster) {current[i].cluster = cluster;}
+
+  /** The number of samples. */
+  int size() const {return numberOfSamples;}
+};
+
+#include "Tools/SelfLocatorSampleSet.h"
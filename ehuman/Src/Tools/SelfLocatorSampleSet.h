@@ -0,0 +1,294 @@
+/**
+* @file SelfLocatorSampleSet.h
+* Specializes the SampleSet for SelfLocatorSamples. The samples are stored as a
+* structure of arrays, so loops over a single field of all samples stream through
+* contiguous memory and can be vectorized. Each array is 32-byte aligned and padded
+* to a multiple of 8 samples. The padding is only processed, so loops over the arrays
+* need no remainder. Its values are not maintained and must not be used.
+*
+* The interface is the one of SampleSet, so pose calculators and sensor models can
+* still access single samples through at(). Since there is no SelfLocatorSample
+* object in memory, the non-const at() returns a reference object whose members
+* refer to the elements of the arrays. It is bound by value, i.e.
+* SampleSet<SelfLocatorSample>::Reference s(samples.at(i)), not by Sample&.
+* Code that only reads a sample binds it as a const Sample& or a Sample, and
+* assigns a cluster with setCluster(i, c), which both versions of SampleSet provide.
+*
+* This file is included at the end of Tools/SampleSet.h. Include that file instead.
+*/
+
+#pragma once
+
+#include "Tools/SampleSet.h"
+#include <algorithm>
+#include <cstdlib>
+
+/**
+* @class SelfLocatorSampleArrays
+* One set of arrays with all fields of the samples.
+*/
+class SelfLocatorSampleArrays
+{
+public:
+  /**
+  * A reference to a single sample in the arrays. It behaves like a SelfLocatorSample&.
+  */
+  class Reference
+  {
+  public:
+    /** A Vector2<int>& whose components are stored in two arrays. */
+    class VectorReference
+    {
+    public:
+      int& x;
+      int& y;
+
+      VectorReference(int& x, int& y) : x(x), y(y) {}
+      VectorReference& operator=(const Vector2<int>& other) {x = other.x; y = other.y; return *this;}
+      VectorReference& operator=(const VectorReference& other) {x = other.x; y = other.y; return *this;}
+      operator Vector2<int>() const {return Vector2<int>(x, y);}
+    };
+
+    VectorReference translation;
+    VectorReference rotation;
+    float& angle;
+    float& weighting;
+    int& cluster;
+
+    Reference(SelfLocatorSampleArrays& arrays, int i) :
+      translation(arrays.x[i], arrays.y[i]), rotation(arrays.cosAngle[i], arrays.sinAngle[i]),
+      angle(arrays.angle[i]), weighting(arrays.weighting[i]), cluster(arrays.cluster[i]) {}
+
+    /** Copies the values of another sample. */
+    Reference& operator=(const Reference& other)
+    {
+      translation = other.translation;
+      rotation = other.rotation;
+      angle = other.angle;
+      weighting = other.weighting;
+      cluster = other.cluster;
+      return *this;
+    }
+
+    Reference& operator=(const SelfLocatorSample& other)
+    {
+      translation = other.translation;
+      rotation = other.rotation;
+      angle = other.angle;
+      weighting = other.weighting;
+      cluster = other.cluster;
+      return *this;
+    }
+
+    operator SelfLocatorSample() const
+    {
+      SelfLocatorSample sample;
+      sample.translation = translation;
+      sample.rotation = rotation;
+      sample.angle = angle;
+      sample.weighting = weighting;
+      sample.cluster = cluster;
+      return sample;
+    }
+  };
+
+  int* x; /**< The x coordinates of the positions in mm. */
+  int* y; /**< The y coordinates of the positions in mm. */
+  int* cosAngle; /**< The cosine of the rotations * 1024. */
+  int* sinAngle; /**< The sine of the rotations * 1024. */
+  float* angle; /**< The rotations. */
+  float* weighting; /**< The weightings. */
+  int* cluster; /**< The indices of the clusters the samples belong to. */
+
+  SelfLocatorSampleArrays() : x(0), y(0), cosAngle(0), sinAngle(0), angle(0), weighting(0), cluster(0), buffer(0) {}
+  ~SelfLocatorSampleArrays() {free(buffer);}
+
+  /**
+  * Allocates the arrays.
+  * @param paddedSize The number of elements of each array. Must be a multiple of 8.
+  */
+  void allocate(int paddedSize)
+  {
+    free(buffer);
+    // 7 arrays of 4-byte elements, each a multiple of 32 bytes long, plus space for the alignment
+    buffer = (char*) malloc(7 * 4 * paddedSize + 31);
+    char* p = (char*) (((size_t) buffer + 31) & ~(size_t) 31);
+    x = (int*) p;
+    y = x + paddedSize;
+    cosAngle = y + paddedSize;
+    sinAngle = cosAngle + paddedSize;
+    angle = (float*) (sinAngle + paddedSize);
+    weighting = angle + paddedSize;
+    cluster = (int*) (weighting + paddedSize);
+    for(int i = 0; i < paddedSize; ++i)
+    {
+      x[i] = y[i] = sinAngle[i] = cluster[i] = 0;
+      cosAngle[i] = 1024;
+      angle[i] = weighting[i] = 0;
+    }
+  }
+
+  /** Returns a reference to sample i. */
+  Reference operator[](int i) {return Reference(*this, i);}
+
+  /** Copies sample j of other to sample i. */
+  void copy(int i, const SelfLocatorSampleArrays& other, int j)
+  {
+    x[i] = other.x[j];
+    y[i] = other.y[j];
+    cosAngle[i] = other.cosAngle[j];
+    sinAngle[i] = other.sinAngle[j];
+    angle[i] = other.angle[j];
+    weighting[i] = other.weighting[j];
+    cluster[i] = other.cluster[j];
+  }
+
+  /**
+  * Copies the samples indices[0] ... indices[count - 1] of other to the samples 0 ... count - 1.
+  * Each field is gathered in a separate loop.
+  */
+  void gather(const SelfLocatorSampleArrays& other, const int* indices, int count)
+  {
+    for(int i = 0; i < count; ++i)
+      x[i] = other.x[indices[i]];
+    for(int i = 0; i < count; ++i)
+      y[i] = other.y[indices[i]];
+    for(int i = 0; i < count; ++i)
+      cosAngle[i] = other.cosAngle[indices[i]];
+    for(int i = 0; i < count; ++i)
+      sinAngle[i] = other.sinAngle[indices[i]];
+    for(int i = 0; i < count; ++i)
+      angle[i] = other.angle[indices[i]];
+    for(int i = 0; i < count; ++i)
+      weighting[i] = other.weighting[indices[i]];
+    for(int i = 0; i < count; ++i)
+      cluster[i] = other.cluster[indices[i]];
+  }
+
+  /** Exchanges the arrays with the ones of another set. */
+  void swap(SelfLocatorSampleArrays& other)
+  {
+    std::swap(x, other.x);
+    std::swap(y, other.y);
+    std::swap(cosAngle, other.cosAngle);
+    std::swap(sinAngle, other.sinAngle);
+    std::swap(angle, other.angle);
+    std::swap(weighting, other.weighting);
+    std::swap(cluster, other.cluster);
+    std::swap(buffer, other.buffer);
+  }
+
+protected:
+  /**
+  * Lets the arrays refer to the ones of another set without owning them.
+  * @param arrays The other set.
+  * @param begin The index in the other set that becomes the first element.
+  */
+  void refer(SelfLocatorSampleArrays& arrays, int begin)
+  {
+    free(buffer);
+    buffer = 0;
+    x = arrays.x + begin;
+    y = arrays.y + begin;
+    cosAngle = arrays.cosAngle + begin;
+    sinAngle = arrays.sinAngle + begin;
+    angle = arrays.angle + begin;
+    weighting = arrays.weighting + begin;
+    cluster = arrays.cluster + begin;
+  }
+
+private:
+  char* buffer; /**< The memory of all arrays. 0 if the arrays belong to another set. */
+
+  SelfLocatorSampleArrays(const SelfLocatorSampleArrays&);
+  SelfLocatorSampleArrays& operator=(const SelfLocatorSampleArrays&);
+};
+
+/**
+* @class SampleSet<SelfLocatorSample>
+* The current samples are the arrays inherited from SelfLocatorSampleArrays.
+*/
+template<> class SampleSet<SelfLocatorSample> : public SelfLocatorSampleArrays
+{
+private:
+  SelfLocatorSampleArrays other; /**< The second set of arrays used for resampling. */
+  int numberOfSamples; /**< The number of samples. */
+  int numberOfPaddedSamples; /**< The number of samples rounded up to a multiple of 8. */
+  int maxNumberOfSamples; /**< The number of samples the arrays were allocated for. */
+
+public:
+  typedef SelfLocatorSampleArrays::Reference Reference;
+
+  /**
+  * Constructor.
+  * @param numberOfSamples The number of samples in the set. This is also the capacity of the set.
+  */
+  SampleSet(int numberOfSamples) :
+    numberOfSamples(numberOfSamples), numberOfPaddedSamples((numberOfSamples + 7) & ~7),
+    maxNumberOfSamples(numberOfSamples)
+  {
+    allocate(numberOfPaddedSamples);
+    other.allocate(numberOfPaddedSamples);
+  }
+
+  /**
+  * Constructs a view of a range of the samples of another set. The view does not
+  * own its arrays, so it must neither be swapped nor outlive the other set.
+  * @param set The set the view refers to.
+  * @param begin The index of the first sample. Must be a multiple of 8, so the arrays stay aligned.
+  * @param numberOfSamples The number of samples in the view.
+  */
+  SampleSet(SampleSet& set, int begin, int numberOfSamples) :
+    numberOfSamples(numberOfSamples),
+    numberOfPaddedSamples(std::min((numberOfSamples + 7) & ~7, set.numberOfPaddedSamples - begin)),
+    maxNumberOfSamples(numberOfSamples)
+  {
+    refer(set, begin);
+  }
+
+  /**
+  * Lets a view refer to the current arrays of another set again, e.g. after that set
+  * was swapped. Must only be called for views.
+  * @param set The set the view refers to.
+  * @param begin The index of the first sample. Must be a multiple of 8.
+  */
+  void referTo(SampleSet& set, int begin) {refer(set, begin);}
+
+  /**
+  * The function exchanges the current and the other arrays.
+  * @return The arrays that were current before.
+  */
+  SelfLocatorSampleArrays& swap()
+  {
+    SelfLocatorSampleArrays::swap(other);
+    return other;
+  }
+
+  /** Access to sample i. */
+  Reference at(int i) {return Reference(*this, i);}
+
+  /** Constant access to sample i. The sample is returned by value. */
+  SelfLocatorSample at(int i) const {return Reference(const_cast<SampleSet&>(*this), i);}
+
+  /** Assigns sample i to a cluster. */
+  void setCluster(int i, int cluster) {this->cluster[i] = cluster;}
+
+  /** The number of samples. */
+  int size() const {return numberOfSamples;}
+
+  /** The number of elements of the arrays that are in use, i.e. the number of samples rounded up to a multiple of 8. */
+  int paddedSize() const {return numberOfPaddedSamples;}
+
+  /** The maximum number of samples. */
+  int capacity() const {return maxNumberOfSamples;}
+
+  /**
+  * Changes the number of samples without allocating memory.
+  * @param numberOfSamples The new number of samples. It is limited to the capacity.
+  */
+  void resize(int numberOfSamples)
+  {
+    this->numberOfSamples = std::min(numberOfSamples, maxNumberOfSamples);
+    numberOfPaddedSamples = (this->numberOfSamples + 7) & ~7;
+  }
+};
@@ -0,0 +1,172 @@
+/**
+* @file BatchedLocalization.cpp
+* Implements a particle filter that localizes many robots at once, e.g. all robots
+* of a simulated game.
+*/
+
+#include "BatchedLocalization.h"
+#include "Tools/Math/Common.h"
+#include <cmath>
+
+BatchedLocalization::BatchedLocalization() :
+  samples(0), samplesPerRobot(0), blockSize(0), sensorEvaluation(*this)
+{}
+
+BatchedLocalization::~BatchedLocalization()
+{
+  deleteViews();
+  delete samples;
+}
+
+void BatchedLocalization::init(int numberOfRobots, int samplesPerRobot,
+                               const Vector2<>& carpetMin, const Vector2<>& carpetMax, int numberOfThreads)
+{
+  deleteViews();
+  delete samples;
+  this->samplesPerRobot = samplesPerRobot;
+  blockSize = (samplesPerRobot + 7) & ~7;
+  this->carpetMin = carpetMin;
+  this->carpetMax = carpetMax;
+
+  const int size = numberOfRobots * blockSize;
+  samples = new SampleSet<SelfLocatorSample>(size);
+  modelWeightings.resize(size);
+  cumulativeWeightings.resize(blockSize);
+  resampledIndices.resize(size);
+  updated.resize(numberOfRobots);
+  robotSamples.resize(numberOfRobots, 0);
+  createViews();
+
+  // uniformly distributed samples, the padding has a weighting of 0
+  for(int i = 0; i < size; ++i)
+  {
+    const float angle = (randomFloat() * 2.f - 1.f) * pi;
+    samples->x[i] = int(carpetMin.x + randomFloat() * (carpetMax.x - carpetMin.x));
+    samples->y[i] = int(carpetMin.y + randomFloat() * (carpetMax.y - carpetMin.y));
+    samples->angle[i] = angle;
+    samples->cosAngle[i] = int(cos(angle) * 1024);
+    samples->sinAngle[i] = int(sin(angle) * 1024);
+    samples->weighting[i] = i % blockSize < samplesPerRobot ? 1.f : 0.f;
+    samples->cluster[i] = 0;
+  }
+
+  motionModel.seed(0);
+  threadPool.start(numberOfThreads);
+}
+
+void BatchedLocalization::createViews()
+{
+  for(unsigned r = 0; r < robotSamples.size(); ++r)
+    robotSamples[r] = new SampleSet<SelfLocatorSample>(*samples, r * blockSize, samplesPerRobot);
+}
+
+void BatchedLocalization::updateViews()
+{
+  for(unsigned r = 0; r < robotSamples.size(); ++r)
+    robotSamples[r]->referTo(*samples, r * blockSize);
+}
+
+void BatchedLocalization::deleteViews()
+{
+  for(unsigned r = 0; r < robotSamples.size(); ++r)
+  {
+    delete robotSamples[r];
+    robotSamples[r] = 0;
+  }
+}
+
+void BatchedLocalization::step(const std::vector<Odometry>& odometry, SensorUpdate& sensorUpdate)
+{
+  // motion update, the blocks of the robots are processed one after the other
+  const int numberOfRobots = getNumberOfRobots();
+  for(int r = 0; r < numberOfRobots; ++r)
+    motionModel.update(*robotSamples[r], odometry[r].offset, odometry[r].translationError,
+                       odometry[r].rotationError, carpetMin, carpetMax);
+
+  // sensor update, one robot per chunk
+  sensorEvaluation.sensorUpdate = &sensorUpdate;
+  threadPool.run(sensorEvaluation, numberOfRobots);
+
+  bool anyUpdated = false;
+  for(int r = 0; r < numberOfRobots; ++r)
+    anyUpdated |= updated[r] != 0;
+  if(anyUpdated)
+  {
+    resampling(samples->swap());
+    updateViews();
+  }
+}
+
+void BatchedLocalization::applySensorUpdate(int robot, SensorUpdate& sensorUpdate)
+{
+  float* modelWeighting = &modelWeightings[robot * blockSize];
+  updated[robot] = sensorUpdate.computeWeightings(robot, *robotSamples[robot], modelWeighting);
+  if(updated[robot])
+  {
+    float* weighting = robotSamples[robot]->weighting;
+    for(int i = 0; i < samplesPerRobot; ++i)
+      weighting[i] *= modelWeighting[i];
+  }
+}
+
+void BatchedLocalization::resampling(const SelfLocatorSampleArrays& oldSet)
+{
+  const int numberOfRobots = getNumberOfRobots();
+  for(int r = 0; r < numberOfRobots; ++r)
+  {
+    const int begin = r * blockSize;
+    int* indices = &resampledIndices[begin];
+
+    // robots without an observation keep their samples, the padding is kept as well
+    for(int i = 0; i < blockSize; ++i)
+      indices[i] = begin + i;
+    if(!updated[r])
+      continue;
+
+    float sum = 0;
+    for(int i = 0; i < samplesPerRobot; ++i)
+      cumulativeWeightings[i] = sum += oldSet.weighting[begin + i];
+    if(sum <= 0)
+      continue;
+
+    // systematic resampling
+    const float step = sum / samplesPerRobot;
+    float position = randomFloat() * step;
+    int j = 0;
+    for(int i = 0; i < samplesPerRobot; ++i, position += step)
+    {
+      while(j < samplesPerRobot - 1 && cumulativeWeightings[j] <= position)
+        ++j;
+      indices[i] = begin + j;
+    }
+  }
+
+  // a single pass over the samples of all robots
+  samples->gather(oldSet, &resampledIndices[0], numberOfRobots * blockSize);
+
+  for(int r = 0; r < numberOfRobots; ++r)
+    if(updated[r])
+    {
+      float* weighting = samples->weighting + r * blockSize;
+      for(int i = 0; i < samplesPerRobot; ++i)
+        weighting[i] = 1.f;
+    }
+}
+
+Pose2D BatchedLocalization::getPose(int robot) const
+{
+  const SampleSet<SelfLocatorSample>& set = *robotSamples[robot];
+  float x = 0, y = 0, cosSum = 0, sinSum = 0, weightingSum = 0;
+  for(int i = 0; i < set.size(); ++i)
+  {
+    const float w = set.weighting[i];
+    x += set.x[i] * w;
+    y += set.y[i] * w;
+    cosSum += set.cosAngle[i] * w;
+    sinSum += set.sinAngle[i] * w;
+    weightingSum += w;
+  }
+  if(weightingSum <= 0)
+    return Pose2D();
+  return Pose2D(atan2(sinSum, cosSum), x / weightingSum, y / weightingSum);
+}
@@ -0,0 +1,154 @@
+/**
+* @file BatchedLocalization.h
+* Declares a particle filter that localizes many robots at once, e.g. all robots
+* of a simulated game. It is not part of the robot code, but of the simulation in
+* BatchedLocalizationSimulation.cpp.
+*/
+
+#pragma once
+
+#include "Tools/Math/Pose2D.h"
+#include "Tools/SampleSet.h"
+#include "Modules/Modeling/ParticleFilterSelfLocator/VectorizedMotionModel.h"
+#include "Modules/Modeling/ParticleFilterSelfLocator/ChunkThreadPool.h"
+#include <vector>
+
+/**
+* @class BatchedLocalization
+* The sample sets of all robots are stored in a single SampleSet, one block of
+* samplesPerRobot samples (padded to a multiple of 8) per robot. A step applies the
+* motion update, the sensor update and the resampling of all robots:
+* - The motion update streams through the blocks of all robots with the
+*   VectorizedMotionModel.
+* - The sensor update is distributed among a ChunkThreadPool, one robot per chunk.
+*   Each robot only writes to its own block.
+* - The resampling draws the samples of all robots systematically and gathers them
+*   from the previous arrays in a single pass.
+*/
+class BatchedLocalization
+{
+public:
+  /** The odometry of a robot since the previous step. */
+  class Odometry
+  {
+  public:
+    Pose2D offset; /**< The odometry offset in robot coordinates. */
+    Vector2<> translationError; /**< The maximum translational error in x and y direction. */
+    float rotationError; /**< The maximum rotational error. */
+
+    Odometry() : rotationError(0) {}
+  };
+
+  /**
+  * @class SensorUpdate
+  * The interface of the sensor models of the robots.
+  */
+  class SensorUpdate
+  {
+  public:
+    virtual ~SensorUpdate() {}
+
+    /**
+    * Computes the weightings of the samples of a robot. Is called concurrently for different robots.
+    * @param robot The index of the robot.
+    * @param samples The samples of the robot.
+    * @param weightings The weightings that are computed, one per sample.
+    * @return Was there an observation? If not, the weightings are ignored.
+    */
+    virtual bool computeWeightings(int robot, const SampleSet<SelfLocatorSample>& samples, float* weightings) = 0;
+  };
+
+  /** Constructor. */
+  BatchedLocalization();
+
+  /** Destructor. */
+  ~BatchedLocalization();
+
+  /**
+  * Allocates the samples of all robots and spreads them uniformly across the carpet.
+  * @param numberOfRobots The number of robots.
+  * @param samplesPerRobot The number of samples of each robot.
+  * @param carpetMin The lower left corner of the carpet.
+  * @param carpetMax The upper right corner of the carpet.
+  * @param numberOfThreads The number of threads used for the sensor update.
+  */
+  void init(int numberOfRobots, int samplesPerRobot,
+            const Vector2<>& carpetMin, const Vector2<>& carpetMax, int numberOfThreads = 1);
+
+  /** The number of robots. */
+  int getNumberOfRobots() const {return (int) robotSamples.size();}
+
+  /**
+  * Access to the samples of a robot. The view is valid until the next step.
+  * @param robot The index of the robot.
+  */
+  SampleSet<SelfLocatorSample>& getSamples(int robot) {return *robotSamples[robot];}
+
+  /**
+  * Moves the samples of all robots, weights them by their observations and resamples
+  * the robots that had observations.
+  * @param odometry The odometry of each robot since the previous step.
+  * @param sensorUpdate The sensor models of the robots.
+  */
+  void step(const std::vector<Odometry>& odometry, SensorUpdate& sensorUpdate);
+
+  /**
+  * The weighted average pose of the samples of a robot.
+  * @param robot The index of the robot.
+  */
+  Pose2D getPose(int robot) const;
+
+private:
+  /**
+  * @class SensorEvaluation
+  * The sensor update of a single robot, executed by the threadPool.
+  */
+  class SensorEvaluation : public ChunkThreadPool::Task
+  {
+  public:
+    SensorEvaluation(BatchedLocalization& localization) : localization(localization), sensorUpdate(0) {}
+    void execute(int robot) {localization.applySensorUpdate(robot, *sensorUpdate);}
+
+    BatchedLocalization& localization;
+    SensorUpdate* sensorUpdate; /**< The sensor models of the current step. */
+  };
+
+  SampleSet<SelfLocatorSample>* samples; /**< The samples of all robots. */
+  std::vector<SampleSet<SelfLocatorSample>*> robotSamples; /**< Views of the samples of the individual robots. */
+  int samplesPerRobot; /**< The number of samples of each robot. */
+  int blockSize; /**< The number of array elements per robot, i.e. samplesPerRobot rounded up to a multiple of 8. */
+  Vector2<> carpetMin; /**< The lower left corner of the carpet. */
+  Vector2<> carpetMax; /**< The upper right corner of the carpet. */
+  VectorizedMotionModel motionModel; /**< Applies the odometry and its noise to the samples. */
+  ChunkThreadPool threadPool; /**< The threads of the sensor update. */
+  SensorEvaluation sensorEvaluation; /**< The task executed by the threadPool. */
+  std::vector<float> modelWeightings; /**< The weightings computed by the sensor update, one block per robot. */
+  std::vector<char> updated; /**< Was there an observation of a robot in the current step? */
+  std::vector<float> cumulativeWeightings; /**< The prefix sums of the weightings of a robot. */
+  std::vector<int> resampledIndices; /**< The indices of the samples of all robots that are drawn during resampling. */
+
+  /** Creates the views of the samples of the individual robots. */
+  void createViews();
+
+  /** Lets the views refer to the current arrays again. Must be called whenever the arrays are swapped. */
+  void updateViews();
+
+  /** Deletes the views of the samples of the individual robots. */
+  void deleteViews();
+
+  /**
+  * Applies the sensor update of a robot to the weightings of its samples.
+  * @param robot The index of the robot.
+  * @param sensorUpdate The sensor models.
+  */
+  void applySensorUpdate(int robot, SensorUpdate& sensorUpdate);
+
+  /**
+  * Draws the samples of all robots. Robots without an observation keep their samples.
+  * @param oldSet The arrays the samples are drawn from.
+  */
+  void resampling(const SelfLocatorSampleArrays& oldSet);
+
+  BatchedLocalization(const BatchedLocalization&);
+  BatchedLocalization& operator=(const BatchedLocalization&);
+};
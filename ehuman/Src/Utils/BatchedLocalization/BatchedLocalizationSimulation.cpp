@@ -0,0 +1,294 @@
+/**
+ * @file BatchedLocalizationSimulation.cpp
+ * Simulates many robots walking on the field and localizes all of them with a single
+ * BatchedLocalization. It does not need the robot runtime.
+ *
+ * Each robot walks forward and turns randomly, and turns back towards the center
+ * of the field when it comes close to the field border. The odometry is the true
+ * motion plus noise. The robots perceive the bearings of the goal posts in their
+ * field of view with noise. The sensor models of the SelfLocator need the
+ * representations of a single robot, so the bearings are weighted by the simulation
+ * itself, like the NaturalLandmarkSensorModel weights the bearing of the opponent goal.
+ *
+ * The mean duration of a step and the mean error of the estimated poses over the
+ * second half of the steps are printed for each number of threads.
+ */
+#include "BatchedLocalization.h"
+#include "Tools/Math/Common.h"
+#include "Tools/Debugging/BenchmarkSupport.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+/** The field, in mm */
+static const float fieldLength = 6000.f;
+static const float fieldWidth = 4000.f;
+static const float carpetBorder = 700.f;
+static const float goalPostY = 700.f;
+static const int numOfGoalPosts = 4;
+
+struct Options
+{
+	int robots;
+	int samples;
+	int steps;
+	std::vector<int> threads;
+	float fieldOfView; //In radians, the full opening angle
+	float bearingDeviation; //In radians, of the simulated percepts
+	float modelDeviation; //In radians, of the sensor model. Larger than bearingDeviation, so a few samples suffice
+	float odometryDeviation; //Relative to the distance walked or the angle turned
+	unsigned seed;
+
+	Options() : robots(20), samples(100), steps(500), fieldOfView(1.0f), bearingDeviation(0.05f), modelDeviation(0.3f), odometryDeviation(0.1f), seed(0)
+	{
+		threads.push_back(1);
+		threads.push_back(2);
+		threads.push_back(4);
+	}
+};
+
+/** The true pose of a simulated robot */
+struct RobotState
+{
+	float x, y, rotation;
+};
+
+/** A gaussian random number */
+static float randomGauss(float sigma)
+{
+	const float u1 = std::max(randomFloat(), 1e-7f);
+	const float u2 = randomFloat();
+	return sigma * sqrt(-2.f * log(u1)) * cos(2.f * pi * u2);
+}
+
+/** Normalizes an angle to [-pi, pi] */
+static float normalizeAngle(float angle)
+{
+	return atan2(sin(angle), cos(angle));
+}
+
+/**
+ * The sensor update of all robots. The bearings perceived by each robot are set
+ * before each step and only read during the step, so robots can be weighted concurrently.
+ */
+class BearingSensorUpdate : public BatchedLocalization::SensorUpdate
+{
+public:
+	std::vector<std::vector<int> > posts; //The indices of the perceived goal posts per robot
+	std::vector<std::vector<float> > bearings; //The perceived bearings per robot
+
+	BearingSensorUpdate(int numberOfRobots, float deviation) :
+		posts(numberOfRobots), bearings(numberOfRobots), factor(-0.5f / (deviation * deviation))
+	{
+		for(int i = 0; i < numOfGoalPosts; ++i)
+		{
+			postX[i] = i < 2 ? fieldLength / 2 : -fieldLength / 2;
+			postY[i] = i % 2 ? goalPostY : -goalPostY;
+		}
+	}
+
+	/** The position of a goal post */
+	float getPostX(int post) const {return postX[post];}
+	float getPostY(int post) const {return postY[post];}
+
+	bool computeWeightings(int robot, const SampleSet<SelfLocatorSample>& samples, float* weightings)
+	{
+		if(posts[robot].empty())
+			return false;
+
+		//The weighting of a sample that does not fit a bearing at all
+		const float minLikelihood = 0.01f;
+		for(int i = 0; i < samples.size(); ++i)
+			weightings[i] = 1.f;
+		for(size_t p = 0; p < posts[robot].size(); ++p)
+		{
+			const int post = posts[robot][p];
+			const float bearing = bearings[robot][p];
+			for(int i = 0; i < samples.size(); ++i)
+			{
+				const float difference = normalizeAngle(atan2(postY[post] - samples.y[i], postX[post] - samples.x[i]) - samples.angle[i] - bearing);
+				weightings[i] *= std::max(minLikelihood, (float) exp(difference * difference * factor));
+			}
+		}
+		return true;
+	}
+
+private:
+	float postX[numOfGoalPosts];
+	float postY[numOfGoalPosts];
+	float factor;
+};
+
+/** Parses a comma separated list of integers */
+static std::vector<int> parseList(const char *text)
+{
+	std::vector<int> values;
+	std::stringstream stream(text);
+	std::string item;
+	while(std::getline(stream, item, ','))
+		values.push_back(atoi(item.c_str()));
+	return values;
+}
+
+static void help(const char *program)
+{
+	std::cout << "Usage: " << program << " [options]" << std::endl
+		<< "  --robots <n>            number of simulated robots (default 20)" << std::endl
+		<< "  --samples <n>           samples per robot (default 100)" << std::endl
+		<< "  --steps <n>             number of steps (default 500)" << std::endl
+		<< "  --threads <t1,t2,..>    numbers of threads of the sensor update (default 1,2,4)" << std::endl
+		<< "  --fov <a>               opening angle of the camera in radians (default 1.0)" << std::endl
+		<< "  --bearing <s>           standard deviation of the bearings in radians (default 0.05)" << std::endl
+		<< "  --model <s>             standard deviation of the sensor model in radians (default 0.3)" << std::endl
+		<< "  --odometry <s>          relative standard deviation of the odometry (default 0.1)" << std::endl
+		<< "  --seed <n>              seed of the simulation (default 0)" << std::endl;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--help" || i + 1 >= argc)
+			return false;
+		const char *value = argv[++i];
+		if(arg == "--robots")
+			options.robots = std::max(1, atoi(value));
+		else if(arg == "--samples")
+			options.samples = std::max(1, atoi(value));
+		else if(arg == "--steps")
+			options.steps = std::max(1, atoi(value));
+		else if(arg == "--threads")
+			options.threads = parseList(value);
+		else if(arg == "--fov")
+			options.fieldOfView = (float) atof(value);
+		else if(arg == "--bearing")
+			options.bearingDeviation = (float) atof(value);
+		else if(arg == "--model")
+			options.modelDeviation = std::max(1e-3f, (float) atof(value));
+		else if(arg == "--odometry")
+			options.odometryDeviation = (float) atof(value);
+		else if(arg == "--seed")
+			options.seed = (unsigned) atoi(value);
+		else
+			return false;
+	}
+	return !options.threads.empty();
+}
+
+/**
+ * Moves a robot and returns the odometry of the motion.
+ */
+static BatchedLocalization::Odometry walk(RobotState &robot, const Options &options)
+{
+	const float distance = 20.f + randomFloat() * 20.f;
+	float turn = randomGauss(0.05f);
+	if(std::abs(robot.x) > fieldLength / 2 || std::abs(robot.y) > fieldWidth / 2)
+		turn = 0.2f * normalizeAngle(atan2(-robot.y, -robot.x) - robot.rotation);
+	robot.x += cos(robot.rotation) * distance;
+	robot.y += sin(robot.rotation) * distance;
+	robot.rotation = normalizeAngle(robot.rotation + turn);
+
+	BatchedLocalization::Odometry odometry;
+	odometry.offset = Pose2D(turn + randomGauss(options.odometryDeviation * std::abs(turn)),
+			distance + randomGauss(options.odometryDeviation * distance), 0.f);
+	odometry.translationError = Vector2<>(distance * options.odometryDeviation, distance * options.odometryDeviation);
+	odometry.rotationError = std::abs(turn) * options.odometryDeviation + 0.01f;
+	return odometry;
+}
+
+/**
+ * Lets a robot perceive the goal posts in its field of view.
+ */
+static void perceive(int index, const RobotState &robot, const Options &options, BearingSensorUpdate &sensorUpdate)
+{
+	sensorUpdate.posts[index].clear();
+	sensorUpdate.bearings[index].clear();
+	for(int post = 0; post < numOfGoalPosts; ++post)
+	{
+		const float bearing = normalizeAngle(atan2(sensorUpdate.getPostY(post) - robot.y, sensorUpdate.getPostX(post) - robot.x) - robot.rotation);
+		if(std::abs(bearing) < options.fieldOfView / 2)
+		{
+			sensorUpdate.posts[index].push_back(post);
+			sensorUpdate.bearings[index].push_back(bearing + randomGauss(options.bearingDeviation));
+		}
+	}
+}
+
+/**
+ * Runs the simulation with a number of threads. The simulation only depends on the
+ * seed, so the runs with different numbers of threads see the same motions and percepts.
+ */
+static void simulate(const Options &options, int numberOfThreads)
+{
+	srand(options.seed);
+	std::vector<RobotState> robots(options.robots);
+	for(int r = 0; r < options.robots; ++r)
+	{
+		robots[r].x = (randomFloat() - 0.5f) * fieldLength;
+		robots[r].y = (randomFloat() - 0.5f) * fieldWidth;
+		robots[r].rotation = (randomFloat() * 2.f - 1.f) * pi;
+	}
+
+	BatchedLocalization localization;
+	localization.init(options.robots, options.samples,
+			Vector2<>(-fieldLength / 2 - carpetBorder, -fieldWidth / 2 - carpetBorder),
+			Vector2<>(fieldLength / 2 + carpetBorder, fieldWidth / 2 + carpetBorder), numberOfThreads);
+	BearingSensorUpdate sensorUpdate(options.robots, options.modelDeviation);
+	std::vector<BatchedLocalization::Odometry> odometry(options.robots);
+
+	double duration = 0; //In ms
+	double positionError = 0;
+	double rotationError = 0;
+	int numberOfErrors = 0;
+	for(int step = 0; step < options.steps; ++step)
+	{
+		for(int r = 0; r < options.robots; ++r)
+		{
+			odometry[r] = walk(robots[r], options);
+			perceive(r, robots[r], options, sensorUpdate);
+		}
+
+		const double start = BenchmarkSupport::now();
+		localization.step(odometry, sensorUpdate);
+		duration += BenchmarkSupport::now() - start;
+
+		if(step >= options.steps / 2)
+			for(int r = 0; r < options.robots; ++r)
+			{
+				const Pose2D pose = localization.getPose(r);
+				const float dx = pose.translation.x - robots[r].x;
+				const float dy = pose.translation.y - robots[r].y;
+				positionError += sqrt(dx * dx + dy * dy);
+				rotationError += std::abs(normalizeAngle(pose.rotation - robots[r].rotation));
+				++numberOfErrors;
+			}
+	}
+
+	std::cout << std::setw(7) << numberOfThreads
+		<< std::setw(12) << std::fixed << std::setprecision(3) << duration / options.steps
+		<< std::setw(14) << std::setprecision(2) << duration * 1000. / options.steps / options.robots
+		<< std::setw(14) << std::setprecision(0) << positionError / std::max(1, numberOfErrors)
+		<< std::setw(14) << std::setprecision(3) << rotationError / std::max(1, numberOfErrors) << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if(!parseOptions(argc, argv, options))
+	{
+		help(argv[0]);
+		return 1;
+	}
+
+	std::cout << options.robots << " robots, " << options.samples << " samples each, " << options.steps << " steps" << std::endl
+		<< "threads     ms/step  us/robot/step  position (mm)  rotation (rad)" << std::endl;
+	for(size_t t = 0; t < options.threads.size(); ++t)
+		simulate(options, std::max(1, options.threads[t]));
+	return 0;
+}
@@ -0,0 +1,501 @@
+/**
+ * @file BriskBenchmark.cpp
+ * A standalone micro-benchmark of the BRISK detector, extractor and matcher in
+ * Tools/ImageProcessing. It does not need the robot runtime.
+ *
+ * Every stage is timed over a number of iterations on synthetic images and on the
+ * images of a directory, scaled to several resolutions, for several detection
+ * thresholds. Synthetic scene pairs with a known homography can be rendered at any
+ * size, e.g. to measure the throughput from 160x120 to 3840x2160 and the matching
+ * quality against the ground truth. The results are printed as a table and can be written as JSON for
+ * regression tracking. Optionally, the hardware performance counters of the stages are
+ * read in a separate pass, so reading them does not distort the timings.
+ */
+#include <opencv2/opencv.hpp>
+#include "Tools/ImageProcessing/include/brisk.h"
+#include "Tools/ImageProcessing/include/FrameLog.h"
+#include "Tools/ImageProcessing/include/SyntheticScene.h"
+#include "Tools/Debugging/PerfCounters.h"
+#include "Tools/Debugging/BenchmarkSupport.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+/** The statistics of the durations of a single stage */
+struct StageStatistics
+{
+	std::string name;
+	double min, mean, p50, p90, p99; //In ns
+	double items; //The number of items (keypoints or comparisons) processed per iteration
+	std::string itemName;
+
+	StageStatistics(const std::string &name, std::vector<double> &durations, double items, const std::string &itemName) :
+		name(name), items(items), itemName(itemName)
+	{
+		std::sort(durations.begin(), durations.end());
+		const size_t n = durations.size();
+		double sum = 0;
+		for(size_t i = 0; i < n; ++i)
+			sum += durations[i];
+		min = durations[0];
+		mean = sum / n;
+		p50 = durations[(n - 1) * 50 / 100];
+		p90 = durations[(n - 1) * 90 / 100];
+		p99 = durations[(n - 1) * 99 / 100];
+	}
+
+	/** The mean duration per item in ns */
+	double nsPerItem() const {return items > 0 ? mean / items : 0;}
+
+	/** The number of items processed per second */
+	double itemsPerSecond() const {return mean > 0 ? items * 1e9 / mean : 0;}
+};
+
+/** The mean hardware performance counters of a stage per iteration */
+struct StageCounters
+{
+	std::string name;
+	double values[PerfCounters::numOfEvents];
+	bool available[PerfCounters::numOfEvents];
+
+	double perInstruction(PerfCounters::Event event) const
+	{
+		return values[PerfCounters::instructions] > 0 ? values[event] / values[PerfCounters::instructions] : 0;
+	}
+};
+
+/** The results of one image at one resolution and threshold */
+struct Result
+{
+	std::string image;
+	int width, height, threshold, keypoints;
+	std::vector<StageStatistics> stages;
+	std::vector<StageCounters> counters;
+	bool hasGroundTruth;
+	MatchQuality quality; //Of the best radius matches, only if hasGroundTruth
+};
+
+/** The command line options */
+struct Options
+{
+	std::string imageDirectory;
+	std::string logFile;
+	std::string jsonFile;
+	std::vector<int> thresholds;
+	std::vector<int> widths;
+	std::vector<cv::Size> sizes; //Of the synthetic scenes
+	int scenes;
+	int iterations;
+	int octaves;
+	int radius;
+	bool perf;
+
+	Options() : scenes(0), iterations(50), octaves(3), radius(85), perf(false)
+	{
+		sizes.push_back(cv::Size(160, 120));
+		sizes.push_back(cv::Size(320, 240));
+		sizes.push_back(cv::Size(640, 480));
+		sizes.push_back(cv::Size(1280, 720));
+		sizes.push_back(cv::Size(1920, 1080));
+		sizes.push_back(cv::Size(3840, 2160));
+		thresholds.push_back(30);
+		thresholds.push_back(60);
+		thresholds.push_back(90);
+		widths.push_back(160);
+		widths.push_back(320);
+		widths.push_back(640);
+	}
+};
+
+/** Parses a comma separated list of integers */
+static std::vector<int> parseList(const char *text)
+{
+	std::vector<int> values;
+	std::stringstream stream(text);
+	std::string item;
+	while(std::getline(stream, item, ','))
+		values.push_back(atoi(item.c_str()));
+	return values;
+}
+
+/** Parses a comma separated list of sizes like 640x480 */
+static std::vector<cv::Size> parseSizes(const char *text)
+{
+	std::vector<cv::Size> sizes;
+	std::stringstream stream(text);
+	std::string item;
+	while(std::getline(stream, item, ','))
+	{
+		const size_t x = item.find('x');
+		if(x != std::string::npos)
+			sizes.push_back(cv::Size(atoi(item.substr(0, x).c_str()), atoi(item.substr(x + 1).c_str())));
+	}
+	return sizes;
+}
+
+static void help(const char *program)
+{
+	std::cout << "Usage: " << program << " [options]" << std::endl
+		<< "  --images <dir>          also benchmark all .jpg/.jpeg/.png images in <dir>" << std::endl
+		<< "  --log <file>            also benchmark all frames of a frame log (see frameLogConverter)" << std::endl
+		<< "  --thresholds <t1,t2,..> detection thresholds (default 30,60,90)" << std::endl
+		<< "  --widths <w1,w2,..>     image widths, the aspect ratio is 4:3 (default 160,320,640)" << std::endl
+		<< "  --scenes <n>            also benchmark n synthetic scene pairs with a known homography" << std::endl
+		<< "  --sizes <WxH,..>        sizes of the scenes (default 160x120,320x240,640x480," << std::endl
+		<< "                          1280x720,1920x1080,3840x2160)" << std::endl
+		<< "  --iterations <n>        iterations per stage (default 50)" << std::endl
+		<< "  --octaves <n>           number of octaves of the scale space (default 3)" << std::endl
+		<< "  --radius <d>            Hamming radius of the radius matching (default 85)" << std::endl
+		<< "  --perf                  also read the hardware performance counters of the stages" << std::endl
+		<< "  --json <file>           write the results as JSON to <file>" << std::endl;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--perf")
+		{
+			options.perf = true;
+			continue;
+		}
+		if(arg == "--help" || i + 1 >= argc)
+			return false;
+		const char *value = argv[++i];
+		if(arg == "--images")
+			options.imageDirectory = value;
+		else if(arg == "--log")
+			options.logFile = value;
+		else if(arg == "--json")
+			options.jsonFile = value;
+		else if(arg == "--thresholds")
+			options.thresholds = parseList(value);
+		else if(arg == "--widths")
+			options.widths = parseList(value);
+		else if(arg == "--scenes")
+			options.scenes = std::max(0, atoi(value));
+		else if(arg == "--sizes")
+			options.sizes = parseSizes(value);
+		else if(arg == "--iterations")
+			options.iterations = std::max(1, atoi(value));
+		else if(arg == "--octaves")
+			options.octaves = atoi(value);
+		else if(arg == "--radius")
+			options.radius = atoi(value);
+		else
+			return false;
+	}
+	return !options.thresholds.empty() && !options.widths.empty();
+}
+
+/** Loads all images of a directory as grayscale images */
+static void loadImages(const std::string &directory, std::vector<std::pair<std::string, cv::Mat> > &images)
+{
+	std::vector<std::string> names;
+	if(!BenchmarkSupport::listImages(directory, names))
+	{
+		std::cerr << "Cannot open " << directory << std::endl;
+		return;
+	}
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		cv::Mat image = cv::imread(directory + "/" + names[i], 0);
+		if(!image.empty())
+			images.push_back(std::make_pair(names[i], image));
+	}
+}
+
+/** Loads the luminance of all frames of a frame log without decoding any JPEG */
+static void loadFrames(const std::string &fileName, std::vector<std::pair<std::string, cv::Mat> > &images)
+{
+	FrameLogReader log;
+	if(!log.open(fileName))
+	{
+		std::cerr << "Cannot open " << fileName << std::endl;
+		return;
+	}
+	for(int i = 0; i < log.size(); ++i)
+	{
+		cv::Mat image;
+		if(log.getGrey(i, image))
+		{
+			std::stringstream name;
+			name << "frame" << i;
+			images.push_back(std::make_pair(name.str(), image.clone()));
+		}
+	}
+}
+
+/**
+ * Benchmarks all stages on one image
+ * @param second The second image of the matching. If 0, a slightly rotated and scaled copy of image is used.
+ * @param homography Maps image to second. The matches are checked against it if given.
+ */
+static Result benchmark(const std::string &name, const cv::Mat &image, int threshold, const Options &options,
+		const cv::Mat *second = 0, const cv::Mat *homography = 0)
+{
+	Result result;
+	result.image = name;
+	result.width = image.cols;
+	result.height = image.rows;
+	result.threshold = threshold;
+	result.hasGroundTruth = homography != 0;
+
+	cv::Mat image2;
+	if(second)
+		image2 = *second;
+	else
+		cv::warpAffine(image, image2, cv::getRotationMatrix2D(cv::Point2f(image.cols * 0.5f, image.rows * 0.5f), 10, 0.9),
+				image.size());
+
+	std::vector<double> pyramidTimes, keypointTimes, descriptorTimes, hammingTimes, matchingTimes;
+	std::vector<cv::KeyPoint> keypoints, keypoints2;
+	cv::Mat descriptors, descriptors2;
+	cv::BriskDescriptorExtractor extractor;
+
+	//The keypoints and descriptors of the second image are only computed once
+	{
+		cv::BriskScaleSpace scaleSpace(options.octaves);
+		scaleSpace.constructPyramid(image2);
+		scaleSpace.getKeypoints(threshold, keypoints2);
+		extractor.computeImpl(image2, keypoints2, descriptors2);
+	}
+
+	for(int i = 0; i < options.iterations; ++i)
+	{
+		cv::BriskScaleSpace scaleSpace(options.octaves);
+		double start = BenchmarkSupport::now();
+		scaleSpace.constructPyramid(image);
+		pyramidTimes.push_back((BenchmarkSupport::now() - start) * 1e6);
+
+		keypoints.clear();
+		start = BenchmarkSupport::now();
+		scaleSpace.getKeypoints(threshold, keypoints);
+		keypointTimes.push_back((BenchmarkSupport::now() - start) * 1e6);
+
+		start = BenchmarkSupport::now();
+		extractor.computeImpl(image, keypoints, descriptors);
+		descriptorTimes.push_back((BenchmarkSupport::now() - start) * 1e6);
+	}
+	result.keypoints = (int)keypoints.size();
+
+	//All pairs of descriptors of the two images
+	const double comparisons = (double)descriptors.rows * descriptors2.rows;
+	volatile unsigned sink = 0;
+	cv::HammingSse hamming;
+	for(int i = 0; i < options.iterations && comparisons > 0; ++i)
+	{
+		unsigned sum = 0;
+		const double start = BenchmarkSupport::now();
+		for(int r = 0; r < descriptors.rows; ++r)
+			for(int t = 0; t < descriptors2.rows; ++t)
+				sum += hamming(descriptors.ptr<unsigned char>(r), descriptors2.ptr<unsigned char>(t), descriptors.cols);
+		hammingTimes.push_back((BenchmarkSupport::now() - start) * 1e6);
+		sink += sum;
+	}
+
+	cv::BruteForceMatcher<cv::HammingSse> matcher;
+	std::vector<std::vector<cv::DMatch> > matches;
+	for(int i = 0; i < options.iterations && comparisons > 0; ++i)
+	{
+		matches.clear();
+		const double start = BenchmarkSupport::now();
+		matcher.radiusMatch(descriptors, descriptors2, matches, (float)options.radius);
+		matchingTimes.push_back((BenchmarkSupport::now() - start) * 1e6);
+	}
+
+	//The matches are sorted by distance, so the first one is the best
+	if(homography)
+	{
+		std::vector<cv::DMatch> best;
+		for(size_t i = 0; i < matches.size(); ++i)
+			if(!matches[i].empty())
+				best.push_back(matches[i][0]);
+		result.quality = SyntheticScene::evaluate(keypoints, keypoints2, best, *homography);
+	}
+
+	result.stages.push_back(StageStatistics("constructPyramid", pyramidTimes, (double)keypoints.size(), "keypoint"));
+	result.stages.push_back(StageStatistics("getKeypoints", keypointTimes, (double)keypoints.size(), "keypoint"));
+	result.stages.push_back(StageStatistics("computeImpl", descriptorTimes, (double)keypoints.size(), "keypoint"));
+	if(comparisons > 0)
+	{
+		result.stages.push_back(StageStatistics("hammingSse", hammingTimes, comparisons, "comparison"));
+		result.stages.push_back(StageStatistics("radiusMatch", matchingTimes, (double)keypoints.size(), "keypoint"));
+	}
+
+	//The counters are read by the PerfCounters::Scopes in brisk.cpp
+	if(options.perf)
+	{
+		PerfCounters counters;
+		counters.beginFrame();
+		for(int i = 0; i < options.iterations; ++i)
+		{
+			cv::BriskScaleSpace scaleSpace(options.octaves);
+			scaleSpace.constructPyramid(image);
+			keypoints.clear();
+			scaleSpace.getKeypoints(threshold, keypoints);
+			extractor.computeImpl(image, keypoints, descriptors);
+		}
+		for(int i = 0; i < counters.getNumberOfScopes(); ++i)
+		{
+			StageCounters stage;
+			stage.name = counters.getName(i);
+			for(int j = 0; j < PerfCounters::numOfEvents; ++j)
+			{
+				stage.values[j] = (double)counters.getDelta(i, (PerfCounters::Event)j) / options.iterations;
+				stage.available[j] = counters.isAvailable((PerfCounters::Event)j);
+			}
+			result.counters.push_back(stage);
+		}
+	}
+	return result;
+}
+
+static void print(const Result &result)
+{
+	std::cout << result.image << " " << result.width << "x" << result.height
+		<< " threshold " << result.threshold << ": " << result.keypoints << " keypoints";
+	if(result.hasGroundTruth)
+		std::cout << ", " << result.quality.correctMatches << " of " << result.quality.matches << " matches correct, "
+			<< std::fixed << std::setprecision(3) << "precision " << result.quality.precision()
+			<< " recall " << result.quality.recall() << " of " << result.quality.correspondences << " correspondences";
+	std::cout << std::endl;
+	for(size_t i = 0; i < result.stages.size(); ++i)
+	{
+		const StageStatistics &s = result.stages[i];
+		std::cout << "  " << std::left << std::setw(18) << s.name << std::right << std::fixed << std::setprecision(1)
+			<< " min " << std::setw(10) << s.min / 1e3 << " us"
+			<< " mean " << std::setw(10) << s.mean / 1e3 << " us"
+			<< " p50 " << std::setw(10) << s.p50 / 1e3 << " us"
+			<< " p99 " << std::setw(10) << s.p99 / 1e3 << " us"
+			<< std::setw(12) << s.nsPerItem() << " ns/" << s.itemName
+			<< std::setw(14) << std::setprecision(0) << s.itemsPerSecond() << " " << s.itemName << "s/s" << std::endl;
+	}
+	//Instructions per cycle and misses per 1000 instructions
+	for(size_t i = 0; i < result.counters.size(); ++i)
+	{
+		const StageCounters &c = result.counters[i];
+		std::cout << "  " << std::left << std::setw(18) << c.name << std::right << std::fixed << std::setprecision(0)
+			<< " cycles " << std::setw(12) << c.values[PerfCounters::cycles] << std::setprecision(2);
+		if(c.available[PerfCounters::cycles] && c.available[PerfCounters::instructions] && c.values[PerfCounters::cycles] > 0)
+			std::cout << " IPC " << std::setw(6) << c.values[PerfCounters::instructions] / c.values[PerfCounters::cycles];
+		else
+			std::cout << " IPC " << std::setw(6) << "n/a";
+		for(int j = PerfCounters::l1dMisses; j <= PerfCounters::branchMisses; ++j)
+		{
+			std::cout << " " << PerfCounters::getEventName((PerfCounters::Event)j) << "/kInstr " << std::setw(8);
+			if(c.available[j] && c.available[PerfCounters::instructions])
+				std::cout << c.perInstruction((PerfCounters::Event)j) * 1000;
+			else
+				std::cout << "n/a";
+		}
+		std::cout << std::endl;
+	}
+}
+
+static void writeJson(const std::string &fileName, const std::vector<Result> &results, const Options &options)
+{
+	std::ofstream out(fileName.c_str());
+	out << std::fixed << std::setprecision(1);
+	out << "{\n  \"iterations\": " << options.iterations << ",\n  \"octaves\": " << options.octaves
+		<< ",\n  \"radius\": " << options.radius << ",\n  \"results\": [\n";
+	for(size_t r = 0; r < results.size(); ++r)
+	{
+		const Result &result = results[r];
+		out << "    {\"image\": \"" << result.image << "\", \"width\": " << result.width << ", \"height\": " << result.height
+			<< ", \"threshold\": " << result.threshold << ", \"keypoints\": " << result.keypoints;
+		if(result.hasGroundTruth)
+			out << ", \"matches\": " << result.quality.matches << ", \"correctMatches\": " << result.quality.correctMatches
+				<< ", \"correspondences\": " << result.quality.correspondences
+				<< std::setprecision(4) << ", \"precision\": " << result.quality.precision()
+				<< ", \"recall\": " << result.quality.recall() << std::setprecision(1);
+		out << ", \"stages\": {\n";
+		for(size_t i = 0; i < result.stages.size(); ++i)
+		{
+			const StageStatistics &s = result.stages[i];
+			out << "      \"" << s.name << "\": {\"minNs\": " << s.min << ", \"meanNs\": " << s.mean
+				<< ", \"p50Ns\": " << s.p50 << ", \"p90Ns\": " << s.p90 << ", \"p99Ns\": " << s.p99
+				<< ", \"nsPer" << (s.itemName == "keypoint" ? "Keypoint" : "Comparison") << "\": " << s.nsPerItem()
+				<< ", \"" << s.itemName << "sPerSecond\": " << s.itemsPerSecond() << "}"
+				<< (i + 1 < result.stages.size() ? "," : "") << "\n";
+		}
+		out << "    }";
+		if(!result.counters.empty())
+		{
+			out << ", \"counters\": {\n";
+			for(size_t i = 0; i < result.counters.size(); ++i)
+			{
+				const StageCounters &c = result.counters[i];
+				out << "      \"" << c.name << "\": {";
+				for(int j = 0; j < PerfCounters::numOfEvents; ++j)
+				{
+					out << (j ? ", " : "") << "\"" << PerfCounters::getEventName((PerfCounters::Event)j) << "\": ";
+					if(c.available[j])
+						out << c.values[j];
+					else
+						out << "null";
+				}
+				out << "}" << (i + 1 < result.counters.size() ? "," : "") << "\n";
+			}
+			out << "    }";
+		}
+		out << "}" << (r + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if(!parseOptions(argc, argv, options))
+	{
+		help(argv[0]);
+		return 1;
+	}
+
+	std::vector<std::pair<std::string, cv::Mat> > images;
+	images.push_back(std::make_pair(std::string("synthetic"), SyntheticScene().render(0, 640, 480)));
+	if(!options.imageDirectory.empty())
+		loadImages(options.imageDirectory, images);
+	if(!options.logFile.empty())
+		loadFrames(options.logFile, images);
+
+	std::vector<Result> results;
+	for(size_t i = 0; i < images.size(); ++i)
+		for(size_t w = 0; w < options.widths.size(); ++w)
+		{
+			cv::Mat scaled;
+			cv::resize(images[i].second, scaled, cv::Size(options.widths[w], options.widths[w] * 3 / 4));
+			for(size_t t = 0; t < options.thresholds.size(); ++t)
+			{
+				results.push_back(benchmark(images[i].first, scaled, options.thresholds[t], options));
+				print(results.back());
+			}
+		}
+
+	const SyntheticScene scene;
+	for(size_t s = 0; s < options.sizes.size(); ++s)
+		for(int i = 0; i < options.scenes; ++i)
+		{
+			cv::Mat first, second, homography;
+			scene.generatePair(i, options.sizes[s].width, options.sizes[s].height, first, second, homography);
+			std::stringstream name;
+			name << "scene" << i;
+			for(size_t t = 0; t < options.thresholds.size(); ++t)
+			{
+				results.push_back(benchmark(name.str(), first, options.thresholds[t], options, &second, &homography));
+				print(results.back());
+			}
+		}
+
+	if(!options.jsonFile.empty())
+		writeJson(options.jsonFile, results, options);
+	return 0;
+}
@@ -0,0 +1,666 @@
+/**
+ * @file BriskEvaluation.cpp
+ * An offline batch evaluation of the BRISK pipeline on the overlapping image pairs
+ * of the image bank. It does not need the robot runtime.
+ *
+ * The left and right images of the PicsMG/PicsOG datasets are paired in the order of
+ * their file names. Every pair runs through the detection, description, radius matching,
+ * the validation of FeatureExtraction and the geometric verification for every
+ * configuration of a grid of detection thresholds, octaves, pattern scales, Hamming
+ * distances and KNN ratios. The pairs are distributed over several threads. The matching
+ * score, the counters of FeatureExtraction, the number of verified matches and the
+ * durations of the stages are written as CSV.
+ *
+ * The intermediate results are shared between the configurations: the pyramid of a pair
+ * is built once per number of octaves and only its scores are reset for every threshold,
+ * the descriptors are computed once per threshold and pattern scale, and the radius
+ * matching is done once with the largest Hamming distance, of which the smaller ones are
+ * subsets. The durations of a configuration are the ones of the shared stages it uses,
+ * i.e. what the configuration would cost on its own.
+ *
+ * For every configuration, the mean latency per pair, the precision (the fraction of the
+ * matches accepted by the validation) and the recall (the number of left keypoints with a
+ * valid match, relative to the best configuration of the same pair) are summarized, and
+ * the configurations on the Pareto front of latency vs. precision and recall are printed.
+ */
+#include <opencv2/opencv.hpp>
+#include "Tools/ImageProcessing/include/brisk.h"
+#include "Tools/ImageProcessing/include/FeatureExtraction.h"
+#include "Tools/ImageProcessing/include/RansacVerifier.h"
+#include "Tools/Debugging/BenchmarkSupport.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** The stages of the pipeline that are timed */
+enum Stage
+{
+	loading, //Reading and converting both images
+	pyramid, //Constructing the scale spaces
+	corners, //Detecting the AGAST corners in all layers
+	refinement, //Non-maximum suppression and subpixel/scale refinement
+	description, //Computing the descriptors of both images
+	matching, //Radius matching of the left against the right descriptors
+	validation, //FeatureExtraction::performMatchingValidation
+	verification, //The geometric verification of the valid matches
+	numOfStages
+};
+
+static const char *stageNames[numOfStages] =
+{
+	"loading", "pyramid", "agast", "refinement", "description", "matching", "validation", "verification"
+};
+
+/** A dataset of the image bank, i.e. a directory of left images and one of right images */
+struct Dataset
+{
+	std::string name;
+	std::string left, right; //Relative to the root of the image bank
+	std::vector<std::string> leftImages, rightImages; //The paired file names
+};
+
+/** The directories of DataAnalysis::getNumImagesInDirectory */
+static const char *datasetDirectories[][3] =
+{
+	{"MG", "PicsMG/Matching_Pics_Left_Overlapping", "PicsMG/Matching_Pics_Right_Overlapping"},
+	{"OG", "PicsOG/Matching_Pics_Left_Overlapping", "PicsOG/Matching_Pics_Right_Overlapping"},
+	{"MGOld", "PicsMGOld/Matching_MG_Left_old", "PicsMGOld/Matching_MG_Right_old"},
+	{"OGOld", "PicsOGOld/Matching_OG_Left_old", "PicsOGOld/Matching_OG_Right_old"}
+};
+
+/** A point of the parameter grid */
+struct Config
+{
+	int octaves;
+	int threshold;
+	float patternScale;
+	int hammingDistance;
+	float ratio;
+};
+
+/** The command line options */
+struct Options
+{
+	std::string root;
+	std::string csvFile;
+	std::string summaryFile;
+	std::vector<std::string> datasets;
+	std::vector<int> octaves;
+	std::vector<int> thresholds;
+	std::vector<float> patternScales;
+	std::vector<int> hammingDistances;
+	std::vector<float> ratios;
+	int threads;
+	float ransacThreshold;
+
+	Options() : root("../images"), ransacThreshold(3.0f)
+	{
+		for(size_t i = 0; i < sizeof(datasetDirectories) / sizeof(*datasetDirectories); ++i)
+			datasets.push_back(datasetDirectories[i][0]);
+		//The parameters of NaturalLandmarkPerceptorBrisk
+		octaves.push_back(0);
+		thresholds.push_back(100);
+		patternScales.push_back(1.0f);
+		hammingDistances.push_back(85);
+		ratios.push_back(0.7f);
+		threads = std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+	}
+
+	/** The configurations in the order in which evaluate() visits them */
+	std::vector<Config> getConfigs() const
+	{
+		std::vector<Config> configs;
+		Config config;
+		for(size_t o = 0; o < octaves.size(); ++o)
+			for(size_t t = 0; t < thresholds.size(); ++t)
+				for(size_t s = 0; s < patternScales.size(); ++s)
+					for(size_t h = 0; h < hammingDistances.size(); ++h)
+						for(size_t r = 0; r < ratios.size(); ++r)
+						{
+							config.octaves = octaves[o];
+							config.threshold = thresholds[t];
+							config.patternScale = patternScales[s];
+							config.hammingDistance = hammingDistances[h];
+							config.ratio = ratios[r];
+							configs.push_back(config);
+						}
+		return configs;
+	}
+};
+
+/** The result of one pair of images with one configuration */
+struct Result
+{
+	int keypointsLeft, keypointsRight;
+	int matches, validMatches, invalidMatches, bestMatches;
+	float matchingScore, matchingScoreBest;
+	int inliers;
+	double durations[numOfStages]; //In ms
+
+	/** The duration of the pipeline without loading the images in ms */
+	double getLatency() const
+	{
+		double latency = 0;
+		for(int s = loading + 1; s < numOfStages; ++s)
+			latency += durations[s];
+		return latency;
+	}
+};
+
+/** One pair of images evaluated with all configurations */
+struct Job
+{
+	const Dataset *dataset;
+	int pair;
+	bool loaded;
+	std::vector<Result> results; //One per configuration
+};
+
+/** Parses a comma separated list */
+static std::vector<std::string> parseList(const char *text)
+{
+	std::vector<std::string> values;
+	std::stringstream stream(text);
+	std::string item;
+	while(std::getline(stream, item, ','))
+		values.push_back(item);
+	return values;
+}
+
+/** Parses a comma separated list of integers */
+static std::vector<int> parseIntList(const char *text)
+{
+	const std::vector<std::string> items = parseList(text);
+	std::vector<int> values;
+	for(size_t i = 0; i < items.size(); ++i)
+		values.push_back(atoi(items[i].c_str()));
+	return values;
+}
+
+/** Parses a comma separated list of floats */
+static std::vector<float> parseFloatList(const char *text)
+{
+	const std::vector<std::string> items = parseList(text);
+	std::vector<float> values;
+	for(size_t i = 0; i < items.size(); ++i)
+		values.push_back((float)atof(items[i].c_str()));
+	return values;
+}
+
+static void help(const char *program)
+{
+	std::cout << "Usage: " << program << " [options]" << std::endl
+		<< "  --root <dir>                the image bank containing PicsMG, PicsOG, ... (default ../images)" << std::endl
+		<< "  --datasets <d1,d2,..>       datasets out of MG, OG, MGOld, OGOld (default all)" << std::endl
+		<< "  --octaves <o1,o2,..>        numbers of octaves of the scale space (default 0)" << std::endl
+		<< "  --thresholds <t1,t2,..>     AGAST detection thresholds (default 100)" << std::endl
+		<< "  --patternScales <s1,..>     scales of the BRISK sampling pattern (default 1)" << std::endl
+		<< "  --hammingDistances <h1,..>  radii of the Hamming radius matching (default 85)" << std::endl
+		<< "  --ratios <r1,r2,..>         KNN ratios of the validation (default 0.7)" << std::endl
+		<< "  --ransacThreshold <px>      maximum reprojection error of a verified match (default 3)" << std::endl
+		<< "  --threads <n>               number of threads (default number of cores)" << std::endl
+		<< "  --csv <file>                write the results per pair to <file> instead of stdout" << std::endl
+		<< "  --summary <file>            write the results per configuration to <file>" << std::endl
+		<< "The i-th left image of a dataset is matched against its i-th right image in the order of" << std::endl
+		<< "the file names. Every combination of the parameters is evaluated." << std::endl;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--help" || i + 1 >= argc)
+			return false;
+		const char *value = argv[++i];
+		if(arg == "--root")
+			options.root = value;
+		else if(arg == "--csv")
+			options.csvFile = value;
+		else if(arg == "--summary")
+			options.summaryFile = value;
+		else if(arg == "--datasets")
+			options.datasets = parseList(value);
+		else if(arg == "--octaves")
+			options.octaves = parseIntList(value);
+		else if(arg == "--thresholds")
+			options.thresholds = parseIntList(value);
+		else if(arg == "--patternScales")
+			options.patternScales = parseFloatList(value);
+		else if(arg == "--hammingDistances")
+			options.hammingDistances = parseIntList(value);
+		else if(arg == "--ratios")
+			options.ratios = parseFloatList(value);
+		else if(arg == "--ransacThreshold")
+			options.ransacThreshold = (float)atof(value);
+		else if(arg == "--threads")
+			options.threads = std::max(1, atoi(value));
+		else
+			return false;
+	}
+	return !options.datasets.empty() && !options.octaves.empty() && !options.thresholds.empty() &&
+		!options.patternScales.empty() && !options.hammingDistances.empty() && !options.ratios.empty();
+}
+
+/** Finds the datasets and pairs their images */
+static bool findDatasets(const Options &options, std::vector<Dataset> &datasets)
+{
+	const size_t numOfDirectories = sizeof(datasetDirectories) / sizeof(*datasetDirectories);
+	for(size_t d = 0; d < options.datasets.size(); ++d)
+	{
+		size_t i = 0;
+		while(i < numOfDirectories && options.datasets[d] != datasetDirectories[i][0])
+			++i;
+		if(i == numOfDirectories)
+		{
+			std::cerr << "Unknown dataset " << options.datasets[d] << std::endl;
+			return false;
+		}
+		Dataset dataset;
+		dataset.name = datasetDirectories[i][0];
+		dataset.left = datasetDirectories[i][1];
+		dataset.right = datasetDirectories[i][2];
+		const std::string leftDirectory = options.root + "/" + dataset.left;
+		const std::string rightDirectory = options.root + "/" + dataset.right;
+		if(!BenchmarkSupport::listImages(leftDirectory, dataset.leftImages))
+			std::cerr << "Cannot open " << leftDirectory << std::endl;
+		if(!BenchmarkSupport::listImages(rightDirectory, dataset.rightImages))
+			std::cerr << "Cannot open " << rightDirectory << std::endl;
+		if(dataset.leftImages.size() != dataset.rightImages.size())
+			std::cerr << dataset.name << ": " << dataset.leftImages.size() << " left but " << dataset.rightImages.size()
+				<< " right images, the surplus is ignored" << std::endl;
+		const size_t pairs = std::min(dataset.leftImages.size(), dataset.rightImages.size());
+		dataset.leftImages.resize(pairs);
+		dataset.rightImages.resize(pairs);
+		datasets.push_back(dataset);
+	}
+	return true;
+}
+
+/** The jobs that are shared by the worker threads */
+struct Evaluation
+{
+	const Options *options;
+	std::vector<Config> configs;
+	std::vector<Job> jobs;
+	size_t next; //The index of the next job to be processed
+	pthread_mutex_t mutex;
+};
+
+/** The objects a worker thread reuses for all of its jobs */
+struct Worker
+{
+	//The extractors build their sampling patterns on construction, so every thread
+	//has its own, one per pattern scale
+	std::vector<cv::Ptr<cv::BriskDescriptorExtractor> > extractors;
+	RansacVerifier verifier;
+	FeatureExtraction feature;
+
+	Worker(const Options &options) : verifier(RansacVerifier::AFFINE, options.ransacThreshold)
+	{
+		for(size_t s = 0; s < options.patternScales.size(); ++s)
+			extractors.push_back(new cv::BriskDescriptorExtractor(true, true, options.patternScales[s]));
+	}
+};
+
+/** Detects the keypoints in a scale space whose pyramid was already constructed */
+static void detect(cv::BriskScaleSpace &scaleSpace, int threshold, std::vector<cv::KeyPoint> &keypoints, double durations[numOfStages])
+{
+	std::vector<std::vector<CvPoint> > agastPoints;
+	double start = BenchmarkSupport::now();
+	//The scores cached by the previous threshold would change the non-maximum suppression
+	scaleSpace.resetScores();
+	scaleSpace.getAgastPoints(threshold, agastPoints);
+	durations[corners] += BenchmarkSupport::now() - start;
+
+	start = BenchmarkSupport::now();
+	scaleSpace.getKeypoints(agastPoints, keypoints);
+	durations[refinement] += BenchmarkSupport::now() - start;
+}
+
+/** Keeps the candidates closer than a Hamming distance. The candidates are sorted by distance */
+static void selectMatches(const std::vector<std::vector<cv::DMatch> > &allMatches, int hammingDistance,
+		std::vector<std::vector<cv::DMatch> > &matches)
+{
+	matches.resize(allMatches.size());
+	for(size_t i = 0; i < allMatches.size(); ++i)
+	{
+		matches[i].clear();
+		for(size_t j = 0; j < allMatches[i].size() && allMatches[i][j].distance < hammingDistance; ++j)
+			matches[i].push_back(allMatches[i][j]);
+	}
+}
+
+/** Runs the pipeline on one pair of images for all configurations */
+static void evaluate(Job &job, const Options &options, Worker &worker)
+{
+	const Dataset &dataset = *job.dataset;
+	double durations[numOfStages] = {0};
+
+	double start = BenchmarkSupport::now();
+	const cv::Mat left = cv::imread(options.root + "/" + dataset.left + "/" + dataset.leftImages[job.pair], 0);
+	const cv::Mat right = cv::imread(options.root + "/" + dataset.right + "/" + dataset.rightImages[job.pair], 0);
+	durations[loading] = BenchmarkSupport::now() - start;
+	job.loaded = !left.empty() && !right.empty();
+	if(!job.loaded)
+		return;
+
+	const int maxHammingDistance = *std::max_element(options.hammingDistances.begin(), options.hammingDistances.end());
+	std::vector<cv::KeyPoint> keypoints, keypoints2;
+	std::vector<cv::KeyPoint> describedKeypoints, describedKeypoints2;
+	cv::Mat descriptors, descriptors2;
+	std::vector<std::vector<cv::DMatch> > allMatches, matches;
+	std::vector<Result>::iterator result = job.results.begin();
+
+	for(size_t o = 0; o < options.octaves.size(); ++o)
+	{
+		cv::BriskScaleSpace scaleSpace(options.octaves[o]), scaleSpace2(options.octaves[o]);
+		start = BenchmarkSupport::now();
+		scaleSpace.constructPyramid(left);
+		scaleSpace2.constructPyramid(right);
+		durations[pyramid] = BenchmarkSupport::now() - start;
+
+		for(size_t t = 0; t < options.thresholds.size(); ++t)
+		{
+			durations[corners] = durations[refinement] = 0;
+			detect(scaleSpace, options.thresholds[t], keypoints, durations);
+			detect(scaleSpace2, options.thresholds[t], keypoints2, durations);
+
+			for(size_t s = 0; s < options.patternScales.size(); ++s)
+			{
+				//The extractor removes the keypoints too close to the border
+				describedKeypoints = keypoints;
+				describedKeypoints2 = keypoints2;
+				start = BenchmarkSupport::now();
+				worker.extractors[s]->compute(left, describedKeypoints, descriptors);
+				worker.extractors[s]->compute(right, describedKeypoints2, descriptors2);
+				durations[description] = BenchmarkSupport::now() - start;
+
+				//Every right descriptor within the Hamming distance is a candidate, so the KNN
+				//ratio test of the validation sees the second best candidates
+				allMatches.clear();
+				start = BenchmarkSupport::now();
+				if(descriptors.rows > 0 && descriptors2.rows > 0)
+				{
+					cv::BruteForceMatcher<cv::HammingSse> matcher;
+					matcher.radiusMatch(descriptors, descriptors2, allMatches, (float)maxHammingDistance);
+				}
+				durations[matching] = BenchmarkSupport::now() - start;
+
+				for(size_t h = 0; h < options.hammingDistances.size(); ++h)
+					for(size_t r = 0; r < options.ratios.size(); ++r, ++result)
+					{
+						selectMatches(allMatches, options.hammingDistances[h], matches);
+
+						FeatureExtraction &feature = worker.feature;
+						feature.knnRatio = options.ratios[r];
+						start = BenchmarkSupport::now();
+						feature.performMatchingValidation(left, describedKeypoints, describedKeypoints2, matches, true);
+						durations[validation] = BenchmarkSupport::now() - start;
+
+						start = BenchmarkSupport::now();
+						result->inliers = worker.verifier.verify(describedKeypoints, describedKeypoints2, matches);
+						durations[verification] = BenchmarkSupport::now() - start;
+
+						result->keypointsLeft = (int)describedKeypoints.size();
+						result->keypointsRight = (int)describedKeypoints2.size();
+						result->matches = feature.totalNumMatches;
+						result->validMatches = feature.totalNumValidMatches;
+						result->invalidMatches = feature.totalNumInvalidMatches;
+						result->bestMatches = feature.totalNumBestMatches;
+						result->matchingScore = feature.imageMatchingScore;
+						result->matchingScoreBest = feature.imageMatchingScoreBest;
+						std::copy(durations, durations + numOfStages, result->durations);
+					}
+			}
+		}
+	}
+}
+
+/** The main function of a worker thread. Takes jobs until all are done */
+static void *work(void *arg)
+{
+	Evaluation &evaluation = *(Evaluation *)arg;
+	Worker worker(*evaluation.options);
+	for(;;)
+	{
+		pthread_mutex_lock(&evaluation.mutex);
+		const size_t index = evaluation.next++;
+		pthread_mutex_unlock(&evaluation.mutex);
+		if(index >= evaluation.jobs.size())
+			return 0;
+		evaluate(evaluation.jobs[index], *evaluation.options, worker);
+	}
+}
+
+static void writeConfig(std::ostream &out, const Config &config)
+{
+	out << config.octaves << "," << config.threshold << "," << config.patternScale << ","
+		<< config.hammingDistance << "," << config.ratio;
+}
+
+static void writeCsv(std::ostream &out, const Evaluation &evaluation)
+{
+	out << "dataset,left,right,octaves,threshold,patternScale,hammingDistance,ratio,keypointsLeft,keypointsRight,"
+		<< "matches,validMatches,invalidMatches,bestMatches,matchingScore,matchingScoreBest,inliers";
+	for(int s = 0; s < numOfStages; ++s)
+		out << "," << stageNames[s] << "Ms";
+	out << "\n";
+	for(size_t i = 0; i < evaluation.jobs.size(); ++i)
+	{
+		const Job &job = evaluation.jobs[i];
+		if(!job.loaded)
+			continue;
+		for(size_t c = 0; c < evaluation.configs.size(); ++c)
+		{
+			const Result &result = job.results[c];
+			out << job.dataset->name << "," << job.dataset->leftImages[job.pair] << "," << job.dataset->rightImages[job.pair] << ",";
+			writeConfig(out, evaluation.configs[c]);
+			out << "," << result.keypointsLeft << "," << result.keypointsRight << "," << result.matches
+				<< "," << result.validMatches << "," << result.invalidMatches << "," << result.bestMatches
+				<< std::setprecision(6) << "," << result.matchingScore << "," << result.matchingScoreBest << "," << result.inliers
+				<< std::fixed << std::setprecision(3);
+			for(int s = 0; s < numOfStages; ++s)
+				out << "," << result.durations[s];
+			out.unsetf(std::ios::floatfield);
+			out << "\n";
+		}
+	}
+}
+
+/** The results of a configuration over all pairs */
+struct Summary
+{
+	int pairs;
+	int validMatches, invalidMatches, bestMatches, inliers;
+	int maxBestMatches; //The sum of the largest number of best matches of any configuration per pair
+	double latency; //The mean duration per pair in ms
+	double durations[numOfStages]; //The mean durations per pair in ms
+	bool pareto;
+
+	double getPrecision() const
+	{
+		return validMatches + invalidMatches > 0 ? double(validMatches) / (validMatches + invalidMatches) : 0;
+	}
+
+	double getRecall() const {return maxBestMatches > 0 ? double(bestMatches) / maxBestMatches : 0;}
+
+	/** Is this at least as good as the other summary in all objectives and better in one? */
+	bool dominates(const Summary &other) const
+	{
+		const double precision = getPrecision(), otherPrecision = other.getPrecision();
+		const double recall = getRecall(), otherRecall = other.getRecall();
+		return latency <= other.latency && precision >= otherPrecision && recall >= otherRecall &&
+			(latency < other.latency || precision > otherPrecision || recall > otherRecall);
+	}
+};
+
+/** Sums up the results of every configuration and determines the Pareto front */
+static std::vector<Summary> summarize(const Evaluation &evaluation)
+{
+	const size_t numOfConfigs = evaluation.configs.size();
+	std::vector<Summary> summaries(numOfConfigs);
+	for(size_t c = 0; c < numOfConfigs; ++c)
+	{
+		Summary &summary = summaries[c];
+		summary.pairs = summary.validMatches = summary.invalidMatches = summary.bestMatches = summary.inliers = 0;
+		summary.maxBestMatches = 0;
+		summary.latency = 0;
+		std::fill(summary.durations, summary.durations + numOfStages, 0.0);
+	}
+
+	for(size_t i = 0; i < evaluation.jobs.size(); ++i)
+	{
+		const Job &job = evaluation.jobs[i];
+		if(!job.loaded)
+			continue;
+		int maxBestMatches = 0;
+		for(size_t c = 0; c < numOfConfigs; ++c)
+			maxBestMatches = std::max(maxBestMatches, job.results[c].bestMatches);
+		for(size_t c = 0; c < numOfConfigs; ++c)
+		{
+			const Result &result = job.results[c];
+			Summary &summary = summaries[c];
+			++summary.pairs;
+			summary.validMatches += result.validMatches;
+			summary.invalidMatches += result.invalidMatches;
+			summary.bestMatches += result.bestMatches;
+			summary.inliers += result.inliers;
+			summary.maxBestMatches += maxBestMatches;
+			summary.latency += result.getLatency();
+			for(int s = 0; s < numOfStages; ++s)
+				summary.durations[s] += result.durations[s];
+		}
+	}
+
+	for(size_t c = 0; c < numOfConfigs; ++c)
+	{
+		Summary &summary = summaries[c];
+		if(summary.pairs)
+		{
+			summary.latency /= summary.pairs;
+			for(int s = 0; s < numOfStages; ++s)
+				summary.durations[s] /= summary.pairs;
+		}
+	}
+
+	for(size_t c = 0; c < numOfConfigs; ++c)
+	{
+		summaries[c].pareto = true;
+		for(size_t d = 0; d < numOfConfigs && summaries[c].pareto; ++d)
+			summaries[c].pareto = !summaries[d].dominates(summaries[c]);
+	}
+	return summaries;
+}
+
+static void writeSummary(std::ostream &out, const Evaluation &evaluation, const std::vector<Summary> &summaries)
+{
+	out << "octaves,threshold,patternScale,hammingDistance,ratio,pairs,validMatches,invalidMatches,bestMatches,"
+		<< "inliers,precision,recall,latencyMs";
+	for(int s = 0; s < numOfStages; ++s)
+		out << "," << stageNames[s] << "Ms";
+	out << ",pareto\n";
+	for(size_t c = 0; c < summaries.size(); ++c)
+	{
+		const Summary &summary = summaries[c];
+		writeConfig(out, evaluation.configs[c]);
+		out << "," << summary.pairs << "," << summary.validMatches << "," << summary.invalidMatches
+			<< "," << summary.bestMatches << "," << summary.inliers << std::fixed << std::setprecision(4)
+			<< "," << summary.getPrecision() << "," << summary.getRecall() << std::setprecision(3) << "," << summary.latency;
+		for(int s = 0; s < numOfStages; ++s)
+			out << "," << summary.durations[s];
+		out.unsetf(std::ios::floatfield);
+		out << "," << (summary.pareto ? 1 : 0) << "\n";
+	}
+}
+
+/** Prints the configurations on the Pareto front, the fastest first */
+static void printParetoFront(const Evaluation &evaluation, const std::vector<Summary> &summaries)
+{
+	std::vector<std::pair<double, size_t> > front;
+	for(size_t c = 0; c < summaries.size(); ++c)
+		if(summaries[c].pareto && summaries[c].pairs)
+			front.push_back(std::make_pair(summaries[c].latency, c));
+	std::sort(front.begin(), front.end());
+
+	std::cerr << "Pareto front of " << summaries.size() << " configurations:" << std::endl;
+	for(size_t i = 0; i < front.size(); ++i)
+	{
+		const Config &config = evaluation.configs[front[i].second];
+		const Summary &summary = summaries[front[i].second];
+		std::cerr << "  octaves " << config.octaves << " threshold " << config.threshold << " patternScale " << config.patternScale
+			<< " hammingDistance " << config.hammingDistance << " ratio " << config.ratio << std::fixed << std::setprecision(2)
+			<< ": " << summary.latency << " ms/pair, precision " << summary.getPrecision() << ", recall " << summary.getRecall()
+			<< ", " << summary.inliers << " verified matches" << std::endl;
+		std::cerr.unsetf(std::ios::floatfield);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	std::vector<Dataset> datasets;
+	if(!parseOptions(argc, argv, options))
+	{
+		help(argv[0]);
+		return 1;
+	}
+	if(!findDatasets(options, datasets))
+		return 1;
+
+	Evaluation evaluation;
+	evaluation.options = &options;
+	evaluation.configs = options.getConfigs();
+	evaluation.next = 0;
+	pthread_mutex_init(&evaluation.mutex, 0);
+	for(size_t d = 0; d < datasets.size(); ++d)
+		for(size_t p = 0; p < datasets[d].leftImages.size(); ++p)
+		{
+			Job job;
+			job.dataset = &datasets[d];
+			job.pair = (int)p;
+			job.loaded = false;
+			job.results.resize(evaluation.configs.size());
+			evaluation.jobs.push_back(job);
+		}
+	if(evaluation.jobs.empty())
+	{
+		std::cerr << "No image pairs found in " << options.root << std::endl;
+		return 1;
+	}
+
+	//The calling thread is one of the workers
+	const int numOfThreads = std::min(options.threads, (int)evaluation.jobs.size());
+	std::vector<pthread_t> threads(numOfThreads - 1);
+	for(size_t i = 0; i < threads.size(); ++i)
+		pthread_create(&threads[i], 0, work, &evaluation);
+	work(&evaluation);
+	for(size_t i = 0; i < threads.size(); ++i)
+		pthread_join(threads[i], 0);
+	pthread_mutex_destroy(&evaluation.mutex);
+
+	if(options.csvFile.empty())
+		writeCsv(std::cout, evaluation);
+	else
+	{
+		std::ofstream out(options.csvFile.c_str());
+		writeCsv(out, evaluation);
+	}
+
+	const std::vector<Summary> summaries = summarize(evaluation);
+	if(!options.summaryFile.empty())
+	{
+		std::ofstream out(options.summaryFile.c_str());
+		writeSummary(out, evaluation, summaries);
+	}
+	printParetoFront(evaluation, summaries);
+	return 0;
+}
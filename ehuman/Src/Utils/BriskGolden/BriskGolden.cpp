@@ -0,0 +1,394 @@
+/**
+ * @file BriskGolden.cpp
+ * A regression check of the determinism of the BRISK detector and extractor in
+ * Tools/ImageProcessing. It does not need the robot runtime.
+ *
+ * In the record mode, the keypoints (position, size, angle, score and octave) and the
+ * descriptors of a fixed set of images are written to a golden file. In the check mode,
+ * they are computed again and compared to the golden file. The keypoints must be equal
+ * exactly. The descriptors are computed for the golden keypoints, so they are compared
+ * bit by bit even if the detection changed, and their drift is reported per bit
+ * position of the descriptor.
+ * The images are synthetic scenes (Tools/ImageProcessing/SyntheticScene.h), which are
+ * generated reproducibly, and optionally the images of a directory. A hash of every image
+ * is stored, so a changed input is not mistaken for a changed result.
+ *
+ * The golden file is not part of the repository, because it depends on the OpenCV the
+ * tool is built with. It is recorded with the unchanged brisk.cpp before changing it or
+ * the AGAST kernels, and the changed version is checked against it with the same OpenCV.
+ */
+#include <opencv2/opencv.hpp>
+#include "Tools/ImageProcessing/include/brisk.h"
+#include "Tools/ImageProcessing/include/SyntheticScene.h"
+#include "Tools/Debugging/BenchmarkSupport.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+/** The results of one image */
+struct Golden
+{
+	std::string image;
+	int width, height;
+	unsigned hash; //FNV-1a hash of the pixels
+	std::vector<cv::KeyPoint> keypoints; //The detected keypoints
+	std::vector<cv::KeyPoint> describedKeypoints; //The keypoints the extractor kept
+	cv::Mat descriptors;
+};
+
+/** The command line options */
+struct Options
+{
+	std::string recordFile;
+	std::string checkFile;
+	std::string imageDirectory;
+	int threshold;
+	int octaves;
+
+	Options() : threshold(60), octaves(3) {}
+};
+
+static void help(const char *program)
+{
+	std::cout << "Usage: " << program << " --record <file> | --check <file> [options]" << std::endl
+		<< "  --record <file>   compute the keypoints and descriptors and write them to <file>" << std::endl
+		<< "  --check <file>    compare the keypoints and descriptors to the ones in <file>" << std::endl
+		<< "  --images <dir>    also use all .jpg/.jpeg/.png images in <dir>" << std::endl
+		<< "  --threshold <t>   detection threshold when recording (default 60)" << std::endl
+		<< "  --octaves <n>     number of octaves of the scale space when recording (default 3)" << std::endl
+		<< "The check exits with 1 if any keypoint or descriptor bit differs." << std::endl;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--help" || i + 1 >= argc)
+			return false;
+		const char *value = argv[++i];
+		if(arg == "--record")
+			options.recordFile = value;
+		else if(arg == "--check")
+			options.checkFile = value;
+		else if(arg == "--images")
+			options.imageDirectory = value;
+		else if(arg == "--threshold")
+			options.threshold = atoi(value);
+		else if(arg == "--octaves")
+			options.octaves = atoi(value);
+		else
+			return false;
+	}
+	return options.recordFile.empty() != options.checkFile.empty();
+}
+
+/** The fixed set of images */
+static void getImages(const Options &options, std::vector<std::pair<std::string, cv::Mat> > &images)
+{
+	//The third image is the first one seen from another pose (rotated, scaled and with
+	//perspective), with another lighting, blur and noise
+	const SyntheticScene scene;
+	cv::Mat first, warped, homography;
+	scene.generatePair(0, 640, 480, first, warped, homography);
+	images.push_back(std::make_pair(std::string("synthetic640"), scene.render(0, 640, 480)));
+	images.push_back(std::make_pair(std::string("synthetic320"), scene.render(1, 320, 240)));
+	images.push_back(std::make_pair(std::string("synthetic640warped"), warped));
+
+	if(options.imageDirectory.empty())
+		return;
+	std::vector<std::string> names;
+	if(!BenchmarkSupport::listImages(options.imageDirectory, names))
+	{
+		std::cerr << "Cannot open " << options.imageDirectory << std::endl;
+		return;
+	}
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		cv::Mat image = cv::imread(options.imageDirectory + "/" + names[i], 0);
+		if(!image.empty())
+			images.push_back(std::make_pair(names[i], image));
+	}
+}
+
+static unsigned hashImage(const cv::Mat &image)
+{
+	unsigned hash = 2166136261u;
+	for(int y = 0; y < image.rows; ++y)
+	{
+		const unsigned char *p = image.ptr<unsigned char>(y);
+		for(int x = 0; x < image.cols; ++x)
+			hash = (hash ^ p[x]) * 16777619u;
+	}
+	return hash;
+}
+
+static void detect(const cv::Mat &image, int threshold, int octaves, std::vector<cv::KeyPoint> &keypoints)
+{
+	cv::BriskScaleSpace scaleSpace(octaves);
+	scaleSpace.constructPyramid(image);
+	scaleSpace.getKeypoints(threshold, keypoints);
+}
+
+/** Computes the descriptors of a copy of the keypoints, since the extractor removes some */
+static void describe(const cv::BriskDescriptorExtractor &extractor, const cv::Mat &image, const std::vector<cv::KeyPoint> &keypoints,
+		std::vector<cv::KeyPoint> &describedKeypoints, cv::Mat &descriptors)
+{
+	describedKeypoints = keypoints;
+	extractor.compute(image, describedKeypoints, descriptors);
+}
+
+/** Writes the keypoints. The floats are written with enough digits to be read back exactly */
+static void writeKeypoints(std::ostream &out, const char *name, const std::vector<cv::KeyPoint> &keypoints)
+{
+	out << name << " " << keypoints.size() << "\n" << std::setprecision(9);
+	for(size_t i = 0; i < keypoints.size(); ++i)
+	{
+		const cv::KeyPoint &k = keypoints[i];
+		out << k.pt.x << " " << k.pt.y << " " << k.size << " " << k.angle << " " << k.response << " " << k.octave << "\n";
+	}
+}
+
+static void readKeypoints(std::istream &in, std::vector<cv::KeyPoint> &keypoints)
+{
+	std::string name;
+	size_t n = 0;
+	in >> name >> n;
+	keypoints.resize(n);
+	for(size_t i = 0; i < n && in; ++i)
+	{
+		cv::KeyPoint &k = keypoints[i];
+		in >> k.pt.x >> k.pt.y >> k.size >> k.angle >> k.response >> k.octave;
+	}
+}
+
+static void write(const std::string &fileName, const Options &options, const std::vector<Golden> &goldens)
+{
+	std::ofstream out(fileName.c_str());
+	out << "briskGolden 1 " << options.threshold << " " << options.octaves << " " << goldens.size() << "\n";
+	for(size_t g = 0; g < goldens.size(); ++g)
+	{
+		const Golden &golden = goldens[g];
+		out << "image " << golden.image << " " << golden.width << " " << golden.height << " " << golden.hash << "\n";
+		writeKeypoints(out, "keypoints", golden.keypoints);
+		writeKeypoints(out, "describedKeypoints", golden.describedKeypoints);
+		out << "descriptors " << golden.descriptors.rows << " " << golden.descriptors.cols << "\n" << std::hex << std::setfill('0');
+		for(int r = 0; r < golden.descriptors.rows; ++r)
+		{
+			const unsigned char *d = golden.descriptors.ptr<unsigned char>(r);
+			for(int c = 0; c < golden.descriptors.cols; ++c)
+				out << std::setw(2) << (int)d[c];
+			out << "\n";
+		}
+		out << std::dec << std::setfill(' ');
+	}
+}
+
+static bool read(const std::string &fileName, Options &options, std::vector<Golden> &goldens)
+{
+	std::ifstream in(fileName.c_str());
+	std::string magic;
+	int version = 0;
+	size_t n = 0;
+	in >> magic >> version >> options.threshold >> options.octaves >> n;
+	if(!in || magic != "briskGolden" || version != 1)
+	{
+		std::cerr << fileName << " is not a golden file" << std::endl;
+		return false;
+	}
+	goldens.resize(n);
+	for(size_t g = 0; g < n; ++g)
+	{
+		Golden &golden = goldens[g];
+		std::string tag;
+		in >> tag >> golden.image >> golden.width >> golden.height >> golden.hash;
+		readKeypoints(in, golden.keypoints);
+		readKeypoints(in, golden.describedKeypoints);
+		int rows = 0, cols = 0;
+		in >> tag >> rows >> cols;
+		golden.descriptors.create(rows, cols, CV_8U);
+		for(int r = 0; r < rows && in; ++r)
+		{
+			std::string line;
+			in >> line;
+			unsigned char *d = golden.descriptors.ptr<unsigned char>(r);
+			for(int c = 0; c < cols && 2 * c + 1 < (int)line.size(); ++c)
+				d[c] = (unsigned char)strtol(line.substr(2 * c, 2).c_str(), 0, 16);
+		}
+	}
+	if(!in)
+	{
+		std::cerr << fileName << " is truncated" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool equal(const cv::KeyPoint &a, const cv::KeyPoint &b)
+{
+	return a.pt.x == b.pt.x && a.pt.y == b.pt.y && a.size == b.size && a.angle == b.angle &&
+		a.response == b.response && a.octave == b.octave;
+}
+
+/** Compares two lists of keypoints and prints the differences. Returns whether they are equal */
+static bool compareKeypoints(const char *name, const std::vector<cv::KeyPoint> &golden, const std::vector<cv::KeyPoint> &current)
+{
+	int different = 0;
+	float maxShift = 0;
+	const size_t n = std::min(golden.size(), current.size());
+	for(size_t i = 0; i < n; ++i)
+		if(!equal(golden[i], current[i]))
+		{
+			if(!different)
+				std::cout << "  " << name << " " << i << " differs first: golden (" << golden[i].pt.x << ", " << golden[i].pt.y
+					<< ") octave " << golden[i].octave << " score " << golden[i].response << ", now (" << current[i].pt.x << ", "
+					<< current[i].pt.y << ") octave " << current[i].octave << " score " << current[i].response << std::endl;
+			++different;
+			maxShift = std::max(maxShift, std::max(fabs(golden[i].pt.x - current[i].pt.x), fabs(golden[i].pt.y - current[i].pt.y)));
+		}
+	if(golden.size() != current.size())
+		std::cout << "  " << golden.size() << " golden " << name << ", now " << current.size() << std::endl;
+	if(different)
+		std::cout << "  " << different << " of " << n << " " << name << " differ, the largest position difference is "
+			<< maxShift << " px" << std::endl;
+	return !different && golden.size() == current.size();
+}
+
+/**
+ * Compares the descriptors bit by bit and prints the drift. Returns whether they are equal.
+ * @param bitFlips The number of differences per bit position, accumulated over all images
+ */
+static bool compareDescriptors(const cv::Mat &golden, const cv::Mat &current, std::vector<int> &bitFlips)
+{
+	if(golden.rows != current.rows || golden.cols != current.cols)
+	{
+		std::cout << "  " << golden.rows << "x" << golden.cols << " golden descriptors, now " << current.rows << "x" << current.cols << std::endl;
+		return false;
+	}
+	bitFlips.resize(golden.cols * 8, 0);
+	int differentDescriptors = 0, totalDistance = 0, maxDistance = 0;
+	for(int r = 0; r < golden.rows; ++r)
+	{
+		const unsigned char *g = golden.ptr<unsigned char>(r);
+		const unsigned char *c = current.ptr<unsigned char>(r);
+		int distance = 0;
+		for(int b = 0; b < golden.cols; ++b)
+		{
+			const unsigned char x = g[b] ^ c[b];
+			for(int bit = 0; bit < 8; ++bit)
+				if(x & (1 << bit))
+				{
+					++bitFlips[b * 8 + bit];
+					++distance;
+				}
+		}
+		if(distance)
+			++differentDescriptors;
+		totalDistance += distance;
+		maxDistance = std::max(maxDistance, distance);
+	}
+	if(differentDescriptors)
+		std::cout << "  " << differentDescriptors << " of " << golden.rows << " descriptors differ, mean Hamming drift "
+			<< (golden.rows ? float(totalDistance) / golden.rows : 0.f) << " bits, max " << maxDistance << " bits" << std::endl;
+	return !differentDescriptors;
+}
+
+/** Prints the bit positions that changed */
+static void printBitFlips(const std::vector<int> &bitFlips)
+{
+	int changedBits = 0;
+	for(size_t i = 0; i < bitFlips.size(); ++i)
+		changedBits += bitFlips[i] ? 1 : 0;
+	if(!changedBits)
+		return;
+	std::cout << changedBits << " of " << bitFlips.size() << " descriptor bits drifted (bit: flips):";
+	for(size_t i = 0; i < bitFlips.size(); ++i)
+		if(bitFlips[i])
+			std::cout << " " << i << ": " << bitFlips[i];
+	std::cout << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if(!parseOptions(argc, argv, options))
+	{
+		help(argv[0]);
+		return 1;
+	}
+
+	std::vector<Golden> goldens;
+	if(!options.checkFile.empty() && !read(options.checkFile, options, goldens))
+		return 1;
+
+	std::vector<std::pair<std::string, cv::Mat> > images;
+	getImages(options, images);
+	cv::BriskDescriptorExtractor extractor;
+
+	if(!options.recordFile.empty())
+	{
+		goldens.resize(images.size());
+		for(size_t i = 0; i < images.size(); ++i)
+		{
+			Golden &golden = goldens[i];
+			const cv::Mat &image = images[i].second;
+			golden.image = images[i].first;
+			golden.width = image.cols;
+			golden.height = image.rows;
+			golden.hash = hashImage(image);
+			detect(image, options.threshold, options.octaves, golden.keypoints);
+			describe(extractor, image, golden.keypoints, golden.describedKeypoints, golden.descriptors);
+			std::cout << golden.image << ": " << golden.keypoints.size() << " keypoints, "
+				<< golden.descriptors.rows << " descriptors" << std::endl;
+		}
+		write(options.recordFile, options, goldens);
+		return 0;
+	}
+
+	bool passed = true;
+	std::vector<int> bitFlips;
+	for(size_t g = 0; g < goldens.size(); ++g)
+	{
+		const Golden &golden = goldens[g];
+		size_t i = 0;
+		while(i < images.size() && images[i].first != golden.image)
+			++i;
+		if(i == images.size())
+		{
+			std::cout << golden.image << ": missing, use the same --images directory as when recording" << std::endl;
+			passed = false;
+			continue;
+		}
+		const cv::Mat &image = images[i].second;
+		if(image.cols != golden.width || image.rows != golden.height || hashImage(image) != golden.hash)
+		{
+			std::cout << golden.image << ": the input image differs from the recorded one" << std::endl;
+			passed = false;
+			continue;
+		}
+
+		std::cout << golden.image << ":" << std::endl;
+		std::vector<cv::KeyPoint> keypoints, describedKeypoints;
+		cv::Mat descriptors;
+		detect(image, options.threshold, options.octaves, keypoints);
+		bool same = compareKeypoints("keypoints", golden.keypoints, keypoints);
+
+		//The golden keypoints are described, so the descriptors are comparable even if the detection changed
+		describe(extractor, image, golden.keypoints, describedKeypoints, descriptors);
+		same &= compareKeypoints("described keypoints", golden.describedKeypoints, describedKeypoints);
+		same &= compareDescriptors(golden.descriptors, descriptors, bitFlips);
+		if(same)
+			std::cout << "  equal" << std::endl;
+		passed &= same;
+	}
+	printBitFlips(bitFlips);
+	std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file FrameLogConverter.cpp
+ * Converts the images of a directory into a frame log (Tools/ImageProcessing/FrameLog.h),
+ * so benchmarks read raw frames through a memory mapping instead of decoding JPEG
+ * files, and prints the index of a frame log. It does not need the robot runtime.
+ *
+ * The images are stored as grey frames in the order of their names. Their timestamps
+ * are spaced by a fixed interval and the camera matrix and odometry are left at their
+ * defaults, because loose images do not have them.
+ */
+#include <opencv2/opencv.hpp>
+#include "Tools/ImageProcessing/include/FrameLog.h"
+#include "Tools/Debugging/BenchmarkSupport.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+/** The command line options */
+struct Options
+{
+	std::string imageDirectory;
+	std::string logFile;
+	std::string infoFile;
+	int framesPerChunk;
+	int interval;
+	bool compress;
+
+	Options() : framesPerChunk(16), interval(33), compress(false) {}
+};
+
+static void help(const char *program)
+{
+	std::cout << "Usage: " << program << " --images <dir> --log <file> [options] | --info <file>" << std::endl
+		<< "  --images <dir>    convert all .jpg/.jpeg/.png images in <dir>" << std::endl
+		<< "  --log <file>      write the frame log to <file>" << std::endl
+		<< "  --chunk <n>       frames per chunk (default 16)" << std::endl
+		<< "  --interval <ms>   time between two frames (default 33)" << std::endl
+		<< "  --lz4             compress the chunks" << std::endl
+		<< "  --info <file>     print the frames of a frame log" << std::endl;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--lz4")
+		{
+			options.compress = true;
+			continue;
+		}
+		if(arg == "--help" || i + 1 >= argc)
+			return false;
+		const char *value = argv[++i];
+		if(arg == "--images")
+			options.imageDirectory = value;
+		else if(arg == "--log")
+			options.logFile = value;
+		else if(arg == "--info")
+			options.infoFile = value;
+		else if(arg == "--chunk")
+			options.framesPerChunk = std::max(1, atoi(value));
+		else if(arg == "--interval")
+			options.interval = std::max(0, atoi(value));
+		else
+			return false;
+	}
+	return !options.infoFile.empty() || (!options.imageDirectory.empty() && !options.logFile.empty());
+}
+
+static int convert(const Options &options)
+{
+	std::vector<std::string> names;
+	BenchmarkSupport::listImages(options.imageDirectory, names);
+	if(names.empty())
+	{
+		std::cerr << "No images in " << options.imageDirectory << std::endl;
+		return 1;
+	}
+	FrameLogWriter log;
+	if(!log.open(options.logFile, options.framesPerChunk, options.compress))
+	{
+		std::cerr << "Cannot create " << options.logFile << std::endl;
+		return 1;
+	}
+	unsigned timestamp = 0;
+	int frames = 0;
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		const cv::Mat image = cv::imread(options.imageDirectory + "/" + names[i], 0);
+		if(image.empty())
+		{
+			std::cerr << "Cannot read " << names[i] << std::endl;
+			continue;
+		}
+		if(!log.addImage(image, timestamp))
+			break;
+		timestamp += options.interval;
+		++frames;
+	}
+	if(!log.close())
+	{
+		std::cerr << "Cannot write " << options.logFile << std::endl;
+		return 1;
+	}
+	std::cout << frames << " frames written to " << options.logFile << std::endl;
+	return 0;
+}
+
+static int info(const Options &options)
+{
+	FrameLogReader log;
+	if(!log.open(options.infoFile))
+	{
+		std::cerr << "Cannot open " << options.infoFile << std::endl;
+		return 1;
+	}
+	std::cout << log.size() << " frames" << std::endl;
+	for(int i = 0; i < log.size(); ++i)
+	{
+		const FrameHeader *frame = log.getFrame(i);
+		if(!frame)
+		{
+			std::cerr << "Frame " << i << " is corrupt" << std::endl;
+			return 1;
+		}
+		std::cout << std::setw(6) << i << std::setw(10) << frame->timestamp << " ms "
+			<< frame->width << "x" << frame->height << (frame->format == FrameHeader::GREY ? " grey" : " yuv422")
+			<< " odometry " << frame->odometry[0] << " " << frame->odometry[1] << " " << frame->odometry[2] << std::endl;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if(!parseOptions(argc, argv, options))
+	{
+		help(argv[0]);
+		return 1;
+	}
+	return options.infoFile.empty() ? convert(options) : info(options);
+}
@@ -0,0 +1,37 @@
+/**
+ * @file AllocationHook.cpp
+ * Counts all heap allocations of the log replay in the ScopeMeter.
+ *
+ * malloc, calloc and realloc are replaced by functions that count the allocation and
+ * forward to the implementations of glibc. operator new and cv::fastMalloc allocate
+ * through malloc, so the allocations of std::vectors and cv::Mats are counted as well.
+ * This file is only linked into the log replay, so the robot is not affected.
+ */
+#include "Tools/Debugging/ScopeMeter.h"
+#include <cstddef>
+
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* pointer, size_t size);
+
+	void* malloc(size_t size)
+	{
+		ScopeMeter::countAllocation(size);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size)
+	{
+		ScopeMeter::countAllocation(count * size);
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* pointer, size_t size)
+	{
+		if(size)
+			ScopeMeter::countAllocation(size);
+		return __libc_realloc(pointer, size);
+	}
+}
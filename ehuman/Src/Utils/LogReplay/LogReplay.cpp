@@ -0,0 +1,440 @@
+/**
+ * @file LogReplay.cpp
+ * Replays logs through the cognition modules on a workstation, without the robot
+ * and as fast as possible instead of in real time.
+ *
+ * A log is mapped into memory and streamed frame by frame. The messages of a frame
+ * (the image, CameraMatrix, OdometryData, FrameInfo, GameInfo, ...) are handled like in
+ * the Cognition process, i.e. by the CognitionLogDataProvider, and the modules are
+ * executed once per frame. As when replaying logs in the simulator, the module
+ * configuration has to select the CognitionLogDataProvider for the logged
+ * representations.
+ *
+ * The frames per second and the mean duration, allocations and allocated bytes per
+ * frame of the modules that are measured with a ScopeMeter::Scope
+ * (NaturalLandmarkPerceptorBrisk, SelfLocator) are reported per log. The allocations
+ * are counted by the AllocationHook. Optionally, the hardware performance counters of
+ * all PerfCounters::Scopes (e.g. the stages of BRISK and the SelfLocator) are reported
+ * per frame as well. Several logs can be replayed in parallel processes.
+ */
+#include "Tools/Process.h"
+#include "Tools/Module/ModuleManager.h"
+#include "Tools/MessageQueue/MessageQueue.h"
+#include "Tools/Debugging/ScopeMeter.h"
+#include "Tools/Debugging/PerfCounters.h"
+#include "Tools/Debugging/BenchmarkSupport.h"
+#include "Modules/Infrastructure/CognitionLogDataProvider.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @class MappedLog
+ * A log file mapped into memory. The file is a streamed MessageQueue: the number of
+ * bytes used by the messages and the number of messages (4 bytes each), followed by the
+ * messages. A message consists of its id (1 byte), the size of its data (3 bytes) and
+ * the data. The messages of a frame end with an idProcessFinished message.
+ */
+class MappedLog
+{
+public:
+	MappedLog(const std::string& fileName) : data(0), size(0), position(0), end(0), numberOfFrames(0), maxFrameSize(0)
+	{
+		const int fd = open(fileName.c_str(), O_RDONLY);
+		struct stat st;
+		if(fd < 0 || fstat(fd, &st) || st.st_size < 8)
+		{
+			if(fd >= 0)
+				close(fd);
+			return;
+		}
+		size = st.st_size;
+		void* memory = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if(memory == MAP_FAILED)
+		{
+			size = 0;
+			return;
+		}
+		data = (const unsigned char*) memory;
+		madvise(memory, size, MADV_SEQUENTIAL);
+
+		const unsigned usedSize = *(const unsigned*) data;
+		end = 8 + std::min<size_t>(usedSize, size - 8);
+		scanFrames();
+	}
+
+	~MappedLog()
+	{
+		if(data)
+			munmap((void*) data, size);
+	}
+
+	bool isOpen() const {return data != 0;}
+	int getNumberOfFrames() const {return numberOfFrames;}
+
+	/** The size of the largest frame in bytes, i.e. the size a queue needs to hold any frame */
+	unsigned getMaxFrameSize() const {return maxFrameSize;}
+
+	/**
+	 * Copies the messages of the next frame into a queue.
+	 * @return Was there another frame?
+	 */
+	bool readFrame(MessageQueue& queue)
+	{
+		if(position >= end)
+			return false;
+		while(position + 4 <= end)
+		{
+			const MessageID id = (MessageID) data[position];
+			const unsigned messageSize = getMessageSize(position);
+			if(position + 4 + messageSize > end)
+				break;
+			queue.out.bin.write(data + position + 4, messageSize);
+			queue.out.finishMessage(id);
+			position += 4 + messageSize;
+			if(id == idProcessFinished)
+				return true;
+		}
+		position = end; // the last frame is incomplete
+		return true;
+	}
+
+private:
+	const unsigned char* data; /**< The mapped file. */
+	size_t size; /**< The size of the file in bytes. */
+	size_t position; /**< The offset of the next message. */
+	size_t end; /**< The offset behind the last message. */
+	int numberOfFrames;
+	unsigned maxFrameSize;
+
+	unsigned getMessageSize(size_t offset) const
+	{
+		return data[offset + 1] | data[offset + 2] << 8 | data[offset + 3] << 16;
+	}
+
+	/** Counts the frames and determines the size of the largest one by only reading the headers */
+	void scanFrames()
+	{
+		unsigned frameSize = 0;
+		for(size_t offset = 8; offset + 4 <= end; offset += 4 + getMessageSize(offset))
+		{
+			frameSize += 4 + getMessageSize(offset);
+			if(data[offset] == idProcessFinished)
+			{
+				++numberOfFrames;
+				maxFrameSize = std::max(maxFrameSize, frameSize);
+				frameSize = 0;
+			}
+		}
+		maxFrameSize = std::max(maxFrameSize, frameSize);
+		position = 8;
+	}
+};
+
+/**
+ * @class ReplayProcess
+ * A process that executes the cognition modules on the messages of a log.
+ */
+class ReplayProcess : public Process
+{
+public:
+	ReplayProcess() : Process(debugIn, debugOut), moduleManager("Cognition") {}
+
+	/** Executes the modules on the data of the current frame. */
+	int main()
+	{
+		moduleManager.execute();
+		return 0;
+	}
+
+	bool handleMessage(InMessage& message)
+	{
+		return CognitionLogDataProvider::handleMessage(message) || Process::handleMessage(message);
+	}
+
+private:
+	MessageQueue debugIn;
+	MessageQueue debugOut;
+	ModuleManager moduleManager;
+};
+
+/** The statistics of a scope, summed up over all frames */
+struct ScopeStatistics
+{
+	std::string name;
+	double duration; // in ms
+	double allocations;
+	double allocatedBytes;
+	unsigned maxAllocations; // the most allocations in a frame except for the first one
+
+	ScopeStatistics() : duration(0), allocations(0), allocatedBytes(0), maxAllocations(0) {}
+};
+
+/** The hardware performance counters of a scope, summed up over all frames */
+struct CounterStatistics
+{
+	std::string name;
+	double calls;
+	double deltas[PerfCounters::numOfEvents];
+
+	CounterStatistics() : calls(0)
+	{
+		for(int i = 0; i < PerfCounters::numOfEvents; ++i)
+			deltas[i] = 0;
+	}
+};
+
+/** The statistics of a replayed log */
+struct Result
+{
+	std::string log;
+	int frames;
+	double duration; // in ms
+	double allocations;
+	std::vector<ScopeStatistics> scopes;
+	std::vector<CounterStatistics> counters; // only if the counters were read
+	bool countersAvailable[PerfCounters::numOfEvents];
+};
+
+static void replay(const std::string& fileName, int maxFrames, bool readCounters, Result& result)
+{
+	result.log = fileName;
+	result.frames = 0;
+	result.duration = 0;
+	result.allocations = 0;
+	for(int i = 0; i < PerfCounters::numOfEvents; ++i)
+		result.countersAvailable[i] = false;
+
+	MappedLog log(fileName);
+	if(!log.isOpen())
+	{
+		std::cerr << "Cannot open " << fileName << std::endl;
+		return;
+	}
+
+	ScopeMeter meter;
+	PerfCounters* counters = readCounters ? new PerfCounters : 0;
+	if(counters)
+		for(int i = 0; i < PerfCounters::numOfEvents; ++i)
+			result.countersAvailable[i] = counters->isAvailable((PerfCounters::Event) i);
+	ReplayProcess process;
+	MessageQueue frame;
+	frame.setSize(log.getMaxFrameSize() + 1024);
+
+	while((maxFrames <= 0 || result.frames < maxFrames) && log.readFrame(frame))
+	{
+		meter.beginFrame();
+		if(counters)
+			counters->beginFrame();
+		const unsigned allocations = ScopeMeter::getTotalAllocations();
+		const double start = BenchmarkSupport::now();
+		frame.handleAllMessages(process);
+		frame.clear();
+		process.main();
+		result.duration += BenchmarkSupport::now() - start;
+		result.allocations += ScopeMeter::getTotalAllocations() - allocations;
+
+		result.scopes.resize(meter.getNumberOfScopes());
+		for(int i = 0; i < meter.getNumberOfScopes(); ++i)
+		{
+			ScopeStatistics& scope = result.scopes[i];
+			scope.name = meter.getName(i);
+			scope.duration += meter.getDuration(i);
+			scope.allocations += meter.getAllocations(i);
+			scope.allocatedBytes += meter.getAllocatedBytes(i);
+			if(result.frames > 0) // the first frame initializes the modules
+				scope.maxAllocations = std::max(scope.maxAllocations, meter.getAllocations(i));
+		}
+		if(counters)
+		{
+			result.counters.resize(counters->getNumberOfScopes());
+			for(int i = 0; i < counters->getNumberOfScopes(); ++i)
+			{
+				CounterStatistics& scope = result.counters[i];
+				scope.name = counters->getName(i);
+				scope.calls += counters->getCalls(i);
+				for(int j = 0; j < PerfCounters::numOfEvents; ++j)
+					scope.deltas[j] += counters->getDelta(i, (PerfCounters::Event) j);
+			}
+		}
+		++result.frames;
+	}
+	delete counters;
+}
+
+/**
+ * Formats the statistics of a log as a single line, followed by one line per scope
+ * with the counter deltas per frame if the counters were read.
+ */
+static std::string format(const Result& result)
+{
+	std::stringstream stream;
+	stream << result.log << ": " << result.frames << " frames";
+	if(result.frames > 0 && result.duration > 0)
+	{
+		stream << std::fixed << std::setprecision(1) << ", " << result.frames * 1000. / result.duration << " frames/s, "
+					 << std::setprecision(3) << result.duration / result.frames << " ms/frame, "
+					 << std::setprecision(1) << result.allocations / result.frames << " allocations/frame";
+		for(size_t i = 0; i < result.scopes.size(); ++i)
+		{
+			const ScopeStatistics& scope = result.scopes[i];
+			stream << ", " << scope.name << " " << std::setprecision(3) << scope.duration / result.frames << " ms "
+						 << std::setprecision(1) << scope.allocations / result.frames << " allocations "
+						 << std::setprecision(0) << scope.allocatedBytes / result.frames << " bytes (max " << scope.maxAllocations << ")";
+		}
+	}
+	stream << "\n";
+	for(size_t i = 0; i < result.counters.size() && result.frames > 0; ++i)
+	{
+		const CounterStatistics& scope = result.counters[i];
+		const double instructions = scope.deltas[PerfCounters::instructions];
+		stream << "  " << scope.name << ": " << std::setprecision(1) << scope.calls / result.frames << " calls";
+		for(int j = 0; j < PerfCounters::numOfEvents; ++j)
+		{
+			stream << ", " << PerfCounters::getEventName((PerfCounters::Event) j) << " ";
+			if(result.countersAvailable[j])
+				stream << std::setprecision(0) << scope.deltas[j] / result.frames;
+			else
+				stream << "n/a";
+		}
+		// instructions per cycle and misses per 1000 instructions
+		if(result.countersAvailable[PerfCounters::instructions] && instructions > 0)
+		{
+			if(result.countersAvailable[PerfCounters::cycles] && scope.deltas[PerfCounters::cycles] > 0)
+				stream << ", IPC " << std::setprecision(2) << instructions / scope.deltas[PerfCounters::cycles];
+			for(int j = PerfCounters::l1dMisses; j <= PerfCounters::branchMisses; ++j)
+				if(result.countersAvailable[j])
+					stream << ", " << PerfCounters::getEventName((PerfCounters::Event) j) << "/kInstr "
+								 << std::setprecision(2) << scope.deltas[j] * 1000. / instructions;
+		}
+		stream << "\n";
+	}
+	return stream.str();
+}
+
+/**
+ * Checks that no scope allocated more than limit times in a frame after the first one.
+ * A negative limit is not checked.
+ */
+static bool withinAllocationLimit(const Result& result, int limit)
+{
+	bool within = result.frames > 0;
+	for(size_t i = 0; i < result.scopes.size(); ++i)
+		if(limit >= 0 && result.scopes[i].maxAllocations > (unsigned) limit)
+		{
+			std::cerr << result.log << ": " << result.scopes[i].name << " allocated " << result.scopes[i].maxAllocations
+								<< " times in a frame, the limit is " << limit << std::endl;
+			within = false;
+		}
+	return within;
+}
+
+static void help(const char* program)
+{
+	std::cout << "Usage: " << program << " [options] <log> [<log> ...]" << std::endl
+						<< "  --jobs <n>     replay up to n logs in parallel processes (default 1)" << std::endl
+						<< "  --frames <n>   replay at most n frames per log (default all)" << std::endl
+						<< "  --perf         also report the hardware performance counters per frame" << std::endl
+						<< "  --allocation-limit <n>" << std::endl
+						<< "                 fail if a module allocates more than n times in a frame after" << std::endl
+						<< "                 the first one, e.g. 0 for an allocation-free steady state" << std::endl
+						<< "The module configuration must select the CognitionLogDataProvider for the logged" << std::endl
+						<< "representations, as for replaying logs in the simulator." << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int jobs = 1;
+	int maxFrames = 0;
+	int allocationLimit = -1;
+	bool readCounters = false;
+	std::vector<std::string> logs;
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--jobs" && i + 1 < argc)
+			jobs = std::max(1, atoi(argv[++i]));
+		else if(arg == "--frames" && i + 1 < argc)
+			maxFrames = atoi(argv[++i]);
+		else if(arg == "--perf")
+			readCounters = true;
+		else if(arg == "--allocation-limit" && i + 1 < argc)
+			allocationLimit = atoi(argv[++i]);
+		else if(arg.compare(0, 2, "--"))
+			logs.push_back(arg);
+		else
+		{
+			help(argv[0]);
+			return 1;
+		}
+	}
+	if(logs.empty())
+	{
+		help(argv[0]);
+		return 1;
+	}
+
+	if(jobs == 1)
+	{
+		bool succeeded = true;
+		for(size_t i = 0; i < logs.size(); ++i)
+		{
+			Result result;
+			replay(logs[i], maxFrames, readCounters, result);
+			std::cout << format(result) << std::flush;
+			succeeded &= withinAllocationLimit(result, allocationLimit);
+		}
+		return succeeded ? 0 : 1;
+	}
+
+	// one process per log, at most jobs at a time
+	int running = 0;
+	int failed = 0;
+	for(size_t i = 0; i < logs.size() || running > 0;)
+	{
+		if(i < logs.size() && running < jobs)
+		{
+			const pid_t pid = fork();
+			if(pid == 0)
+			{
+				Result result;
+				replay(logs[i], maxFrames, readCounters, result);
+				// a single write, so the lines of the processes are not interleaved
+				const std::string line = format(result);
+				const ssize_t written = write(STDOUT_FILENO, line.c_str(), line.size());
+				_exit(withinAllocationLimit(result, allocationLimit) && written == (ssize_t) line.size() ? 0 : 1);
+			}
+			else if(pid < 0)
+			{
+				std::cerr << "Cannot start a process for " << logs[i] << std::endl;
+				++failed;
+			}
+			else
+				++running;
+			++i;
+		}
+		else
+		{
+			int status;
+			if(wait(&status) > 0)
+			{
+				--running;
+				if(!WIFEXITED(status) || WEXITSTATUS(status))
+					++failed;
+			}
+			else
+				running = 0;
+		}
+	}
+	return failed ? 1 : 0;
+}
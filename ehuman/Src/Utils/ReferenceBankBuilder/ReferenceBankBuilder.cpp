@@ -0,0 +1,122 @@
+/**
+ * @file ReferenceBankBuilder.cpp
+ * Generates the reference bank of a reference image offline. It does not need the robot
+ * runtime.
+ *
+ * The image is detected and described with the BRISK detector and extractor of
+ * Tools/ImageProcessing and the result is written in the format of ReferenceBank. The
+ * hash of the image and the parameters are stored in the bank, so the
+ * NaturalLandmarkPerceptorBrisk only uses the bank if it was built from its reference
+ * image with its parameters. The defaults are the parameters of the perceptor, e.g. from
+ * Make/Linux:
+ *   ../../Build/ReferenceBankBuilder/Linux/Release/referenceBankBuilder ../../Src/Tools/ImageProcessing/imageBank/1.jpg ../../Src/Tools/ImageProcessing/imageBank/1.bank
+ */
+#include <opencv2/opencv.hpp>
+#include "Tools/ImageProcessing/include/brisk.h"
+#include "Tools/ImageProcessing/include/ReferenceBank.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+/** The command line options */
+struct Options
+{
+	std::string image;
+	std::string bank;
+	ReferenceBankParameters parameters;
+
+	Options()
+	{
+		parameters.threshold = 100;
+		parameters.octaves = 0;
+	}
+};
+
+static void help(const char *program)
+{
+	std::cout << "Usage: " << program << " <image> <bank> [options]" << std::endl
+		<< "  --threshold <t>       detection threshold (default 100)" << std::endl
+		<< "  --octaves <n>         number of octaves of the scale space (default 0)" << std::endl
+		<< "  --patternScale <s>    scale of the sampling pattern of the extractor (default 1.0)" << std::endl
+		<< "  --noRotation          do not normalize the orientation of the descriptors" << std::endl
+		<< "  --noScale             do not normalize the scale of the descriptors" << std::endl
+		<< "  --noSelection         do not select the bits of the coarse matching stage" << std::endl
+		<< "The defaults are the parameters of the NaturalLandmarkPerceptorBrisk." << std::endl;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+	std::vector<std::string> files;
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--help")
+			return false;
+		else if(arg == "--noRotation")
+			options.parameters.rotationInvariant = false;
+		else if(arg == "--noScale")
+			options.parameters.scaleInvariant = false;
+		else if(arg == "--noSelection")
+			options.parameters.withSelection = false;
+		else if(arg.compare(0, 2, "--") == 0)
+		{
+			if(i + 1 >= argc)
+				return false;
+			const char *value = argv[++i];
+			if(arg == "--threshold")
+				options.parameters.threshold = atoi(value);
+			else if(arg == "--octaves")
+				options.parameters.octaves = atoi(value);
+			else if(arg == "--patternScale")
+				options.parameters.patternScale = (float) atof(value);
+			else
+				return false;
+		}
+		else
+			files.push_back(arg);
+	}
+	if(files.size() != 2)
+		return false;
+	options.image = files[0];
+	options.bank = files[1];
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if(!parseOptions(argc, argv, options))
+	{
+		help(argv[0]);
+		return 1;
+	}
+
+	//The image is read like the perceptor reads it
+	cv::Mat image = cvLoadImage(options.image.c_str(), CV_LOAD_IMAGE_GRAYSCALE);
+	if(image.empty())
+	{
+		std::cerr << "Cannot read " << options.image << std::endl;
+		return 1;
+	}
+	options.parameters.imageHash = ReferenceBankParameters::hashImage(image);
+
+	cv::BriskFeatureDetector detector(options.parameters.threshold, options.parameters.octaves);
+	cv::BriskDescriptorExtractor extractor(options.parameters.rotationInvariant,
+			options.parameters.scaleInvariant, options.parameters.patternScale);
+	std::vector<cv::KeyPoint> keypoints;
+	cv::Mat descriptors;
+	detector.detect(image, keypoints);
+	extractor.compute(image, keypoints, descriptors);
+
+	ReferenceBank bank;
+	bank.build(keypoints, descriptors, options.parameters);
+	if(!bank.save(options.bank))
+	{
+		std::cerr << "Cannot write " << options.bank << std::endl;
+		return 1;
+	}
+	std::cout << options.bank << ": " << bank.size() << " keypoints"
+		<< (bank.hasSelection() ? ", with selected bits" : "") << std::endl;
+	return 0;
+}